@@ -2,14 +2,35 @@
 #include "allegro_project.h"
 #include "imgui.h"
 #include "imgui_impl_allegro5.h"
+#include <cstring>
 
 
 ALLEGRO_FONT* allegro_project::m_system_font = nullptr;
 
+#ifdef VV_TRACK_ALLOCATIONS
+// Allegro and ImGui allocate with malloc, their hooks route them through the tracker too
+static void* tracked_al_malloc(size_t n, int, const char*, const char*) {return vv_mem::tracked_malloc(n);}
+static void tracked_al_free(void* ptr, int, const char*, const char*) {vv_mem::tracked_free(ptr);}
+static void* tracked_al_realloc(void* ptr, size_t n, int, const char*, const char*) {return vv_mem::tracked_realloc(ptr, n);}
+static void* tracked_al_calloc(size_t count, size_t n, int, const char*, const char*)
+{
+    void* ptr = vv_mem::tracked_malloc(count * n);
+    if (ptr)
+        std::memset(ptr, 0, count * n);
+    return ptr;
+}
+static ALLEGRO_MEMORY_INTERFACE g_tracked_memory = {tracked_al_malloc, tracked_al_free, tracked_al_realloc, tracked_al_calloc};
+
+static void* tracked_imgui_alloc(size_t n, void*) {return vv_mem::tracked_malloc(n);}
+static void tracked_imgui_free(void* ptr, void*) {vv_mem::tracked_free(ptr);}
+#endif
+
 allegro_project::allegro_project() {}
 
 allegro_project::~allegro_project()
 {
+    if (!m_trace_file.empty())
+        dump_trace();
     if (m_imgui_enabled)
     {
         ImGui_ImplAllegro5_Shutdown();
@@ -17,6 +38,7 @@ allegro_project::~allegro_project()
     }
     if (m_display)
     {
+        m_programs.release_gl();
         al_destroy_display(m_display);
         m_display = nullptr;
     }
@@ -44,8 +66,14 @@ void allegro_project::init(int display_flags, bool enable_imgui)
     BEGIN_EXCEPTION_CATCH()
     // Basic initialization
     m_imgui_enabled = enable_imgui;
+    vv_trace::set_thread_name("main");
+#ifdef VV_TRACK_ALLOCATIONS
+    al_set_memory_interface(&g_tracked_memory);
+    ImGui::SetAllocatorFunctions(tracked_imgui_alloc, tracked_imgui_free);
+#endif
     if (!al_init())
         throw "couldn't init allegro!";
+    m_jobs.start();
 
     m_event_queue = al_create_event_queue();
     if (!m_event_queue)
@@ -72,8 +100,11 @@ void allegro_project::init(int display_flags, bool enable_imgui)
     al_set_new_display_option(ALLEGRO_DEPTH_SIZE, 16, ALLEGRO_SUGGEST);
 
     // Enable antialiasing
-    al_set_new_display_option(ALLEGRO_SAMPLE_BUFFERS, 2, ALLEGRO_SUGGEST);
-    al_set_new_display_option(ALLEGRO_SAMPLES, 8, ALLEGRO_SUGGEST);
+    if (m_back_buffer_samples > 0)
+    {
+        al_set_new_display_option(ALLEGRO_SAMPLE_BUFFERS, 1, ALLEGRO_SUGGEST);
+        al_set_new_display_option(ALLEGRO_SAMPLES, m_back_buffer_samples, ALLEGRO_SUGGEST);
+    }
 
     // Init Addons
     if (!al_init_primitives_addon())
@@ -115,6 +146,8 @@ void allegro_project::create_display(int w, int h)
 
     al_register_event_source(m_event_queue, al_get_display_event_source(m_display));
     display_resize(w, h);
+    if (al_get_display_flags(m_display) & ALLEGRO_OPENGL)
+        m_programs.open(m_shader_cache_dir);
 
     if (m_imgui_enabled)
         ImGui_ImplAllegro5_Init(m_display);
@@ -122,6 +155,14 @@ void allegro_project::create_display(int w, int h)
     END_EXCEPTION_CATCH()
 }
 
+void allegro_project::pre_frame()
+{
+}
+
+void allegro_project::post_flip()
+{
+}
+
 void allegro_project::pre_render()
 {
     if (m_imgui_enabled)
@@ -136,7 +177,7 @@ void allegro_project::render()
     if (m_imgui_enabled)
         imgui_render();
     else
-        al_clear_to_color(al_map_rgb(0, 148, 204));
+        al_clear_to_color(m_clear_color);
 }
 
 void allegro_project::post_render()
@@ -145,7 +186,32 @@ void allegro_project::post_render()
     {
         ImGui::End();
         ImGui::Render();
-        ImGui_ImplAllegro5_RenderDrawData(ImGui::GetDrawData());
+        ImDrawData* data = ImGui::GetDrawData();
+        ImGui_ImplAllegro5_RenderDrawData(data);
+
+        // the backend converts every list into allegro vertices and draws each command with al_draw_*
+        vv_gl::pass_stats& s = m_render_stats.pass(vv_gl::render_stats::imgui);
+        for (int i = 0; i < data->CmdListsCount; i++)
+        {
+            const ImDrawList* list = data->CmdLists[i];
+            ImTextureID texture = nullptr;
+            for (const ImDrawCmd& cmd : list->CmdBuffer)
+            {
+                if (cmd.UserCallback)
+                    continue;
+                s.m_draw_calls++;
+                s.m_al_draw_calls++;
+                s.m_triangles += cmd.ElemCount / 3;
+                s.m_vertices += cmd.ElemCount;
+                s.m_state_changes++;  // clipping rectangle
+                if (cmd.TextureId != texture)
+                {
+                    s.m_texture_binds++;
+                    texture = cmd.TextureId;
+                }
+            }
+            s.m_buffer_bytes += list->VtxBuffer.Size * sizeof(ALLEGRO_VERTEX) + list->IdxBuffer.Size * sizeof(int);
+        }
     }
 }
 
@@ -176,6 +242,20 @@ void allegro_project::keyboard_event_handler(const ALLEGRO_EVENT& ev)
         throw "ESC pressed!";
         return;
     }
+    if (ev.keyboard.keycode == ALLEGRO_KEY_F10)
+        dump_trace();
+}
+
+bool allegro_project::dump_trace()
+{
+    const std::string path = m_trace_file.empty() ? "trace.json" : m_trace_file;
+    if (!vv_trace::write_chrome_trace(path))
+    {
+        std::cout << "couldn't write trace " << path << std::endl;
+        return false;
+    }
+    std::cout << "trace written to " << path << std::endl;
+    return true;
 }
 
 void allegro_project::check_input_state()
@@ -192,6 +272,22 @@ void allegro_project::display_resize(int w, int h)
     m_h = h;
 }
 
+static bool is_input_event(ALLEGRO_EVENT_TYPE type)
+{
+    switch (type)
+    {
+    case ALLEGRO_EVENT_KEY_DOWN:
+    case ALLEGRO_EVENT_KEY_UP:
+    case ALLEGRO_EVENT_KEY_CHAR:
+    case ALLEGRO_EVENT_MOUSE_AXES:
+    case ALLEGRO_EVENT_MOUSE_BUTTON_DOWN:
+    case ALLEGRO_EVENT_MOUSE_BUTTON_UP:
+        return true;
+    default:
+        return false;
+    }
+}
+
 void allegro_project::main_loop()
 {
     BEGIN_EXCEPTION_CATCH()
@@ -206,12 +302,17 @@ void allegro_project::main_loop()
         al_wait_for_event(m_event_queue, &ev);
         if (m_imgui_enabled)
             ImGui_ImplAllegro5_ProcessEvent(&ev);
+        if (m_input_timestamp == 0 && is_input_event(ev.type))
+            m_input_timestamp = ev.any.timestamp;
         switch (ev.type)
         {
         case ALLEGRO_EVENT_TIMER:
+        {
+            VV_TRACE_SCOPE("event", "timer");
             if (m_display)
                 drawing_enabled = true;
             break;
+        }
         case ALLEGRO_EVENT_DISPLAY_CLOSE:
         {
             return;
@@ -219,11 +320,13 @@ void allegro_project::main_loop()
         }
         case ALLEGRO_EVENT_KEY_DOWN:
         {
+            VV_TRACE_SCOPE("event", "key down");
             keyboard_event_handler(ev);
             break;
         }
         case ALLEGRO_EVENT_DISPLAY_RESIZE:
         {
+            VV_TRACE_SCOPE("event", "display resize");
             al_acknowledge_resize(ev.display.source);
             display_resize(ev.display.width, ev.display.height);
             if (m_imgui_enabled)
@@ -240,16 +343,51 @@ void allegro_project::main_loop()
         if (drawing_enabled && al_event_queue_is_empty(m_event_queue))
         {
             drawing_enabled = false;
-            check_input_state();
-            pre_render();
-            render();
-            post_render();
-            al_flip_display();
+            draw_frame();
         }
     }
     END_EXCEPTION_CATCH()
 }
 
+void allegro_project::draw_frame()
+{
+    m_alloc_monitor.begin_frame();
+    VV_TRACE_SCOPE("frame", "frame");
+    {
+        VV_TRACE_SCOPE("frame", "pre_frame");
+        pre_frame();
+    }
+    // everything queued until now is what this frame shows
+    m_frame_input_timestamp = m_input_timestamp;
+    m_input_timestamp = 0;
+    m_frame_arena.begin_frame();
+    m_jobs.begin_frame();
+    m_render_stats.begin_frame();
+    {
+        VV_TRACE_SCOPE("frame", "check_input_state");
+        check_input_state();
+    }
+    {
+        VV_TRACE_SCOPE("frame", "pre_render");
+        pre_render();
+    }
+    {
+        VV_TRACE_SCOPE("frame", "render");
+        render();
+    }
+    {
+        VV_TRACE_SCOPE("frame", "post_render");
+        post_render();
+    }
+    m_render_stats.end_frame();
+    {
+        VV_TRACE_SCOPE("frame", "flip");
+        al_flip_display();
+    }
+    post_flip();
+    m_alloc_monitor.end_frame();
+}
+
 const ALLEGRO_FONT* allegro_project::get_system_font()
 {
     return m_system_font;
@@ -273,20 +411,565 @@ bool allegro_opengl_project::draw_state_flags::m_shaded    = false;
 bool allegro_opengl_project::draw_state_flags::m_wireframe = false;
 bool allegro_opengl_project::draw_state_flags::m_compas    = false;
 bool allegro_opengl_project::draw_state_flags::m_coord_sys = false;
+bool allegro_opengl_project::draw_state_flags::m_occlusion = false;
+bool allegro_opengl_project::draw_state_flags::m_single_pass_wire = true;
+float allegro_opengl_project::draw_state_flags::m_wire_width = 3;
+allegro_opengl_project::debug_view allegro_opengl_project::draw_state_flags::m_debug_view = debug_view::none;
+bool allegro_opengl_project::draw_state_flags::m_overdraw_depth_test = true;
+bool allegro_opengl_project::draw_state_flags::m_textured = true;
+bool allegro_opengl_project::draw_state_flags::m_gpu_driven = false;
+
+allegro_opengl_project::~allegro_opengl_project()
+{
+    if (m_display)
+    {
+        m_capture.stop_sequence();
+        m_capture.flush();
+        m_capture.release_gl();
+        m_point_cloud.release_gl();
+        m_stream.release_gl();
+        m_box.release_gl();
+        m_dynres.release_gl();
+        m_pacer.release_gl();
+        m_heatmap.release_gl();
+        m_textures.release_gl();
+        m_indirect.release_gl();
+        for (view& v : m_views)
+            v.m_occlusion.release_gl();
+    }
+}
 
 void allegro_opengl_project::create_display(int w, int h)
 {
+    // the offscreen scene brings its own samples, a multisampled back buffer would only hold the HUD
+    if (m_dynres.is_enabled())
+    {
+        al_set_new_display_option(ALLEGRO_SAMPLE_BUFFERS, 0, ALLEGRO_SUGGEST);
+        al_set_new_display_option(ALLEGRO_SAMPLES, 0, ALLEGRO_SUGGEST);
+    }
     allegro_project::create_display(w, h);
     display_resize(w, h);
-    m_camera.translate(0, 0, -10);
-    //m_camera.rotate(180, 0, 0);
+    m_stream.create(4 << 20);
+    m_box.set_program_cache(&m_programs);
+    m_heatmap.set_program_cache(&m_programs);
+    m_indirect.set_program_cache(&m_programs);
+    upload_object_mesh();
+    if (m_scene.size() == 0)
+        m_scene.add_box(0, 0, 0, 1);
 }
 
 void allegro_opengl_project::display_resize(int w, int h)
 {
     allegro_project::display_resize(w, h);
     glViewport(0, 0, m_w, m_h);
-    m_camera.init_projection(45, 1, 100, static_cast<double>(m_w) / m_h);
+    update_views_layout();
+}
+
+void allegro_opengl_project::upload_object_mesh()
+{
+    if (!m_display)
+        return;
+    if (m_mesh_file.is_open())
+        m_box.upload(m_mesh_file);
+    else if (m_object_mesh.vertex_count())
+        m_box.upload(m_object_mesh);
+    else  // the face diagonals of the default box aren't wanted in its wireframe
+        m_box.upload(vv_mesh::make_box(1.f), vv_mesh::flat_crease_cos);
+}
+
+void allegro_opengl_project::set_object_mesh(const vv_mesh::mesh& m, bool optimize)
+{
+    m_object_mesh = m;
+    m_object_report = vv_mesh::optimize_report();
+    if (optimize)
+    {
+        vv_mesh::optimize_mesh(m_object_mesh, &m_object_report);
+        std::cout << "mesh optimized in " << m_object_report.m_ms << " ms, ACMR " << m_object_report.m_before.m_acmr
+                  << " -> " << m_object_report.m_after.m_acmr << ", overdraw " << m_object_report.m_overdraw_before
+                  << " -> " << m_object_report.m_overdraw_after << std::endl;
+    }
+    m_mesh_file.close();
+    upload_object_mesh();
+    const float identity[4] = {0, 0, 0, 1};
+    std::copy(identity, identity + 4, m_object_fit);
+}
+
+bool allegro_opengl_project::open_mesh(const std::string& path)
+{
+    VV_TRACE_SCOPE("load", "open_mesh");
+    const double start = al_get_time();
+    // the renderer may point into the old mapping until it is replaced
+    if (m_display)
+        m_box.release_gl();
+    if (!m_mesh_file.open(path))
+    {
+        std::cout << "couldn't open mesh " << path << std::endl;
+        upload_object_mesh();
+        const float identity[4] = {0, 0, 0, 1};
+        std::copy(identity, identity + 4, m_object_fit);
+        return false;
+    }
+    upload_object_mesh();
+
+    const vv_mesh::file_header* header = m_mesh_file.header();
+    const float extent = std::max(header->m_max[0] - header->m_min[0],
+                         std::max(header->m_max[1] - header->m_min[1],
+                                  header->m_max[2] - header->m_min[2]));
+    for (int k = 0; k < 3; k++)
+        m_object_fit[k] = (header->m_min[k] + header->m_max[k]) / 2;
+    m_object_fit[3] = extent > 0 ? 2 / extent : 1;
+    std::cout << path << ": " << header->m_vertex_count << " vertices, " << header->m_lod_count << " LODs, "
+              << (al_get_time() - start) * 1000 << " ms" << std::endl;
+    return true;
+}
+
+void allegro_opengl_project::set_view_layout(view_layout layout)
+{
+    m_view_layout = layout;
+    update_views_layout();
+}
+
+void allegro_opengl_project::update_views_layout()
+{
+    const std::size_t count = m_view_layout == view_layout::single ? 1 : 3;
+    const std::size_t old_count = m_views.size();
+    if (old_count != count)
+    {
+        for (view& v : m_views)
+            v.m_occlusion.release_gl();
+        m_views.resize(count);
+    }
+    if (m_active_view >= count)
+        m_active_view = 0;
+
+    // top, front and iso presets for the split layout
+    const double presets[3][2] = {{M_PI / 2, 0}, {0, 0}, {std::atan(1 / std::sqrt(2.)), -M_PI / 4}};
+    for (std::size_t i = 0; i < count; i++)
+    {
+        view& v = m_views[i];
+        v.m_x = static_cast<int>(m_w * i / count);
+        v.m_y = 0;
+        v.m_w = static_cast<int>(m_w * (i + 1) / count) - v.m_x;
+        v.m_h = m_h;
+        v.m_preset_xa = count > 1 ? presets[i][0] : 0;
+        v.m_preset_ya = count > 1 ? presets[i][1] : 0;
+        v.m_camera.init_projection(45, 1, 100, static_cast<double>(v.m_w) / std::max(v.m_h, 1));
+        if (old_count != count)
+            reset_view_camera(v);
+    }
+}
+
+void allegro_opengl_project::reset_view_camera(view& v)
+{
+    set_orbit_camera(v, 10, 0, 0);
+}
+
+void allegro_opengl_project::set_orbit_camera(view& v, double distance, double pitch, double yaw)
+{
+    v.m_camera.reset();
+    v.m_camera.translate(0, 0, -distance);
+    v.m_camera.apply_rotation(vv_geom::quat::from_axis_angle({1.0, 0.0, 0.0}, v.m_preset_xa + pitch));
+    v.m_camera.apply_rotation(vv_geom::quat::from_axis_angle({0.0, 1.0, 0.0}, v.m_preset_ya + yaw));
+}
+
+bool allegro_opengl_project::gpu_driven()
+{
+    // edges, textures, occlusion queries and the debug views go object by object
+    return draw_state_flags::m_gpu_driven && draw_state_flags::m_shaded && !draw_state_flags::m_wireframe &&
+           !draw_state_flags::m_occlusion && draw_state_flags::m_debug_view == debug_view::none &&
+           !(draw_state_flags::m_textured && m_textures.size()) &&
+           m_box.get_vertex_format() == vv_gl::mesh_renderer::vertex_format::float32 && m_indirect.is_supported();
+}
+
+void allegro_opengl_project::update_scene()
+{
+    // the compute pass culls on the GPU, the views only need their frustums
+    const bool gpu_culled = gpu_driven();
+    auto cull_view = [this, gpu_culled](view& v)
+    {
+        VV_TRACE_SCOPE("job", "cull view");
+        v.m_camera.get_view_projection(v.m_view_projection);
+        v.m_frustum.from_matrix(v.m_view_projection);
+        if (gpu_culled)
+            v.m_visible.clear();
+        else
+            m_scene.cull(v.m_frustum, v.m_visible);
+    };
+    // fixed step, the same frame count gives the same scene
+    const float dt = m_fps ? static_cast<float>(al_get_timer_speed(m_fps)) : 1.f / 60;
+    const float limit = m_motion_limit;
+    const bool moving = m_scene.has_motion();
+
+    // scheduling pays off only for big scenes
+    const std::size_t parallel_threshold = 4096;
+    if (m_jobs.worker_count() < 2 || m_scene.size() < parallel_threshold)
+    {
+        if (moving)
+        {
+            m_scene.integrate(0, m_scene.size(), dt, limit);
+            m_scene.update_bounds(0, m_scene.size());
+        }
+        for (view& v : m_views)
+            cull_view(v);
+        return;
+    }
+
+    // integrate -> bounds -> one cull job per view, chained by continuations
+    const std::size_t grain = 2048;
+    vv_scene::scene* scene = &m_scene;
+    const auto* cull = &cull_view;
+    vv_jobs::job* root = m_jobs.create(nullptr, [] {}, "update_scene");
+    vv_jobs::job* bounds = nullptr;
+    vv_jobs::job* first = nullptr;
+    if (moving)
+    {
+        first = m_jobs.parallel_for(root, scene->size(), grain,
+                                    [scene, dt, limit](std::size_t b, std::size_t e) {scene->integrate(b, e, dt, limit);},
+                                    "integrate");
+        bounds = m_jobs.parallel_for(root, scene->size(), grain,
+                                     [scene](std::size_t b, std::size_t e) {scene->update_bounds(b, e);}, "bounds");
+        m_jobs.add_continuation(first, bounds);
+    }
+    for (view& v : m_views)
+    {
+        view* pv = &v;
+        vv_jobs::job* j = m_jobs.create(root, [cull, pv] {(*cull)(*pv);}, "cull view");
+        if (bounds)
+            m_jobs.add_continuation(bounds, j);
+        else
+            m_jobs.run(j);
+    }
+    if (first)
+        m_jobs.run(first);
+    m_jobs.run(root);
+    m_jobs.wait(root);
+}
+
+bool allegro_opengl_project::open_point_cloud(const std::string& path)
+{
+    VV_TRACE_SCOPE("load", "open_point_cloud");
+    if (!m_point_cloud.open(path))
+    {
+        std::cout << "couldn't open point cloud " << path << std::endl;
+        return false;
+    }
+    // look at the whole cloud: move it into the unit box of the default camera
+    const vv_cloud::file_header* header = m_point_cloud.header();
+    const double extent = std::max(header->m_max[0] - header->m_min[0],
+                          std::max(header->m_max[1] - header->m_min[1],
+                                   header->m_max[2] - header->m_min[2]));
+    m_cloud_scale = extent > 0 ? 2.0 / extent : 1.0;
+    for (int k = 0; k < 3; k++)
+        m_cloud_center[k] = (header->m_min[k] + header->m_max[k]) / 2;
+    return true;
+}
+
+void allegro_opengl_project::draw_point_cloud(view& v)
+{
+    if (!m_point_cloud.is_open())
+        return;
+    VV_TRACE_SCOPE("render", "draw_point_cloud");
+
+    // cloud space -> world space: scale around the cloud center
+    double model[16] = {m_cloud_scale, 0, 0, 0,
+                        0, m_cloud_scale, 0, 0,
+                        0, 0, m_cloud_scale, 0,
+                        -m_cloud_center[0] * m_cloud_scale,
+                        -m_cloud_center[1] * m_cloud_scale,
+                        -m_cloud_center[2] * m_cloud_scale, 1};
+    double mvp[16];
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+        {
+            double sum = 0;
+            for (int k = 0; k < 4; k++)
+                sum += v.m_view_projection[4 * k + r] * model[4 * c + k];
+            mvp[4 * c + r] = sum;
+        }
+    vv_scene::frustum f;
+    f.from_matrix(mvp);
+
+    const double pixel_scale = v.m_h / (2 * std::tan(v.m_camera.get_fov() * M_PI / 360));
+    m_point_cloud.select(f, mvp, m_cloud_scale, pixel_scale, v.m_cloud_nodes);
+
+    glPushMatrix();
+    glMultMatrixd(model);
+    m_point_cloud.draw(v.m_cloud_nodes);
+    glPopMatrix();
+}
+
+void allegro_opengl_project::draw_object(uint32_t id, const view& v, bool occluder)
+{
+    const float s = m_scene.m_half_size[id];
+    const uint32_t texture = draw_state_flags::m_textured ? m_scene.m_texture[id] : 0;
+    std::size_t lod = 0;
+    float texture_pixels = 0;  // on screen across the texture, the unit box of the object
+    if (m_box.lod_count() > 1 || texture)
+    {
+        // clip w is the view depth of the object center
+        const double* vp = v.m_view_projection;
+        const double w = vp[3] * m_scene.m_x[id] + vp[7] * m_scene.m_y[id] + vp[11] * m_scene.m_z[id] + vp[15];
+        const double pixel_scale = v.m_h / (2 * std::tan(v.m_camera.get_fov() * M_PI / 360));
+        const double units = s * m_object_fit[3];
+        const bool in_front = w > v.m_camera.get_znear();
+        if (m_box.lod_count() > 1 && in_front)
+            lod = m_box.select_lod(static_cast<float>(units * pixel_scale / w), m_lod_pixels);
+        // around the camera it wants the finest level
+        texture_pixels = in_front ? static_cast<float>(2 * s * pixel_scale / w) : 1e6f;
+    }
+    // mesh space -> world space, the frustum goes the other way for the meshlets
+    const bool fit = m_mesh_file.is_open();
+    const double k = fit ? s * m_object_fit[3] : s;
+    double model[16] = {k, 0, 0, 0,
+                        0, k, 0, 0,
+                        0, 0, k, 0,
+                        m_scene.m_x[id], m_scene.m_y[id], m_scene.m_z[id], 1};
+    if (fit)
+        for (int i = 0; i < 3; i++)
+            model[12 + i] -= k * m_object_fit[i];
+    double mvp[16];
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+        {
+            double sum = 0;
+            for (int i = 0; i < 4; i++)
+                sum += v.m_view_projection[4 * i + r] * model[4 * c + i];
+            mvp[4 * c + r] = sum;
+        }
+    vv_scene::frustum f;
+    f.from_matrix(mvp);
+
+    GLfloat color[4];
+    const bool tinted = debug_color(id, lod, occluder, color);
+    const uint64_t start = tinted ? vv_trace::now_ns() : 0;
+    vv_gl::pass_stats& stats = m_render_stats.pass(vv_gl::render_stats::scene);
+    const unsigned triangles = stats.m_triangles;
+
+    // a texture that isn't in yet leaves the object white; debug colors and counts go without
+    bool textured = false;
+    if (texture && draw_state_flags::m_shaded && !tinted && draw_state_flags::m_debug_view != debug_view::overdraw)
+    {
+        m_textures.request(texture, texture_pixels);
+        textured = m_textures.bind(texture);
+        stats.m_texture_binds += textured;
+    }
+
+    glPushMatrix();
+    glMultMatrixd(model);
+    stats.m_objects++;
+    draw_box(lod, &f, tinted ? color : nullptr, textured);
+    glPopMatrix();
+    if (textured)
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (tinted)
+    {
+        m_object_triangles[id] = stats.m_triangles - triangles;
+        m_object_cost[id] = static_cast<float>((vv_trace::now_ns() - start) / 1e3 +
+                                               m_object_triangles[id] * m_ms_per_triangle * 1e3);
+        m_cost_frame_max = std::max(m_cost_frame_max, m_object_cost[id]);
+    }
+}
+
+bool allegro_opengl_project::debug_color(uint32_t id, std::size_t lod, bool occluder, GLfloat color[4]) const
+{
+    const debug_view debug = draw_state_flags::m_debug_view;
+    if ((debug != debug_view::draw_cost && debug != debug_view::lod_culling) || id >= m_object_cost.size())
+        return false;
+    color[3] = 1;
+    if (debug == debug_view::draw_cost)
+    {
+        // green, yellow, red against the most expensive object of the last frame
+        const float t = m_cost_max > 0 ? std::min(1.f, m_object_cost[id] / m_cost_max) : 0;
+        color[0] = std::min(1.f, 2 * t);
+        color[1] = std::min(1.f, 2 - 2 * t);
+        color[2] = 0;
+        return true;
+    }
+    static const GLfloat lod_colors[5][3] =
+    {
+        {0.2f, 0.8f, 0.2f}, {0.9f, 0.9f, 0.2f}, {1.f, 0.55f, 0.1f}, {0.9f, 0.2f, 0.2f}, {0.7f, 0.3f, 0.9f}
+    };
+    static const GLfloat occluder_color[3] = {0.3f, 0.5f, 1.f};
+    const GLfloat* c = occluder ? occluder_color : lod_colors[std::min<std::size_t>(lod, 4)];
+    // darker the more of it the meshlets culled last time
+    const unsigned total = m_box.lod_triangles(lod);
+    const float drawn = total && m_object_triangles[id] ? std::min(1.f, float(m_object_triangles[id]) / total) : 1;
+    for (int k = 0; k < 3; k++)
+        color[k] = c[k] * (0.4f + 0.6f * drawn);
+    return true;
+}
+
+void allegro_opengl_project::draw_hidden_bounds(const vv_mem::frame_vector<uint32_t>& hidden)
+{
+    // the 12 edges of a box as corner bit masks, x = 1, y = 2, z = 4
+    static const int edges[24] = {0, 1, 2, 3, 4, 5, 6, 7, 0, 2, 1, 3, 4, 6, 5, 7, 0, 4, 1, 5, 2, 6, 3, 7};
+    // what the stream buffer can take in one go, a few thousand boxes tell enough
+    const std::size_t count = std::min<std::size_t>(hidden.size(), 4096);
+    vv_mem::frame_vector<GLfloat> lines{vv_mem::frame_allocator<GLfloat>(&m_frame_arena)};
+    lines.reserve(count * 24 * 6);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const vv_scene::aabb& box = m_scene.m_bounds[hidden[i]];
+        for (int corner : edges)
+        {
+            const GLfloat vertex[6] = {(corner & 1) ? box.m_max[0] : box.m_min[0],
+                                       (corner & 2) ? box.m_max[1] : box.m_min[1],
+                                       (corner & 4) ? box.m_max[2] : box.m_min[2], 1, 0, 1};
+            lines.insert(lines.end(), vertex, vertex + 6);
+        }
+    }
+    if (lines.empty())
+        return;
+    glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT);
+    disable_global_lighting();
+    glDisable(GL_DEPTH_TEST);
+    glLineWidth(1);
+    draw_stream_lines(lines.data(), static_cast<int>(lines.size() / 6));
+    glPopAttrib();
+}
+
+// true if some corner of the box is in front of the near plane, a query on it would lie
+static bool crosses_near_plane(const vv_scene::aabb& box, const double vp[16], double znear)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        const double x = (i & 1) ? box.m_max[0] : box.m_min[0];
+        const double y = (i & 2) ? box.m_max[1] : box.m_min[1];
+        const double z = (i & 4) ? box.m_max[2] : box.m_min[2];
+        if (vp[3] * x + vp[7] * y + vp[11] * z + vp[15] <= znear * 1.01)
+            return true;
+    }
+    return false;
+}
+
+void allegro_opengl_project::draw_scene(view& v)
+{
+    VV_TRACE_SCOPE("render", "draw_scene");
+    if (!draw_state_flags::m_occlusion)
+    {
+        for (uint32_t id : v.m_visible)
+            draw_object(id, v);
+        return;
+    }
+
+    vv_gl::occlusion_culler& oc = v.m_occlusion;
+    oc.begin_frame(m_scene.size());
+
+    // the largest objects in view are drawn first and fill the depth buffer
+    vv_mem::frame_vector<uint32_t> order(v.m_visible.begin(), v.m_visible.end(),
+                                         vv_mem::frame_allocator<uint32_t>(&m_frame_arena));
+    const std::size_t occluders = std::min<std::size_t>(m_occluder_count, order.size());
+    std::partial_sort(order.begin(), order.begin() + occluders, order.end(),
+                      [this](uint32_t a, uint32_t b) {return m_scene.m_half_size[a] > m_scene.m_half_size[b];});
+    for (std::size_t i = 0; i < occluders; i++)
+        draw_object(order[i], v, true);
+    oc.stats().m_occluders = occluders;
+
+    // visible last frame: draw, and let the real geometry answer the next query
+    for (std::size_t i = occluders; i < order.size(); i++)
+    {
+        const uint32_t id = order[i];
+        if (!oc.was_visible(id) && !crosses_near_plane(m_scene.m_bounds[id], v.m_view_projection,
+                                                       v.m_camera.get_znear()))
+            continue;
+        const bool query = oc.begin_query(id);
+        draw_object(id, v);
+        if (query)
+            oc.end_query();
+    }
+
+    // hidden last frame: test the bounds only, without touching color or depth
+    const unsigned triangles_per_box = draw_state_flags::m_shaded ? m_box.stats().m_triangles : 0;
+    const bool show_hidden = draw_state_flags::m_debug_view == debug_view::lod_culling;
+    vv_mem::frame_vector<uint32_t> hidden{vv_mem::frame_allocator<uint32_t>(&m_frame_arena)};
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    for (std::size_t i = occluders; i < order.size(); i++)
+    {
+        const uint32_t id = order[i];
+        if (oc.was_visible(id) || crosses_near_plane(m_scene.m_bounds[id], v.m_view_projection,
+                                                     v.m_camera.get_znear()))
+            continue;
+        if (oc.begin_query(id))
+        {
+            oc.draw_bounds(m_scene.m_bounds[id]);
+            oc.end_query();
+            vv_gl::pass_stats& stats = m_render_stats.pass(vv_gl::render_stats::scene);
+            stats.m_draw_calls++;
+            stats.m_triangles += 12;
+            stats.m_vertices += 36;
+        }
+        oc.stats().m_occluded++;
+        oc.stats().m_saved_triangles += triangles_per_box;
+        if (show_hidden)
+            hidden.push_back(id);
+    }
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    draw_hidden_bounds(hidden);
+}
+
+void allegro_opengl_project::draw_scene_indirect(view& v, std::size_t index)
+{
+    VV_TRACE_SCOPE("render", "draw_scene_indirect");
+    // the material of draw_box(), for all objects at once
+    const GLfloat red_dif[] = {0.9, 0.0, 0.0, 1.0};
+    const GLfloat red_amb[] = {0.4, 0.0, 0.0, 1.0};
+    const GLfloat red_spe[] = {0.0, 0.0, 0.0, 1.0};
+    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, red_dif);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, red_amb);
+    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, red_spe);
+
+    vv_gl::indirect_renderer::view_params params;
+    params.m_frustum = &v.m_frustum;
+    params.m_view_projection = v.m_view_projection;
+    params.m_znear = static_cast<float>(v.m_camera.get_znear());
+    params.m_pixel_scale = static_cast<float>(v.m_h / (2 * std::tan(v.m_camera.get_fov() * M_PI / 360)));
+    params.m_lod_pixels = m_lod_pixels;
+    if (!m_indirect.draw(m_box, index, params))
+    {
+        // nothing uploaded to draw from yet, cull here as update_scene() would have
+        m_scene.cull(v.m_frustum, v.m_visible);
+        draw_scene(v);
+        return;
+    }
+    vv_gl::pass_stats& stats = m_render_stats.pass(vv_gl::render_stats::scene);
+    stats.m_draw_calls++;
+    stats.m_state_changes += 3;  // material and the two programs
+}
+
+void allegro_opengl_project::keyboard_event_handler(const ALLEGRO_EVENT& ev)
+{
+    switch (ev.keyboard.keycode)
+    {
+    case ALLEGRO_KEY_F12:
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "screenshot_%03u.png", m_screenshot_index++);
+        m_capture.screenshot(name);
+        break;
+    }
+    case ALLEGRO_KEY_F11:
+    {
+        if (m_capture.recording())
+        {
+            m_capture.stop_sequence();
+            break;
+        }
+        const int fps = static_cast<int>(1.0 / al_get_timer_speed(m_fps) + 0.5);
+        if (m_capture_format == vv_gl::frame_capture::format::png)
+            m_capture.start_sequence("capture", m_capture_format, fps);
+        else if (m_capture_format == vv_gl::frame_capture::format::raw)
+            m_capture.start_sequence("capture.rgba", m_capture_format, fps);
+        else
+            m_capture.start_sequence("capture.y4m", m_capture_format, fps);
+        break;
+    }
+    default:
+        break;
+    }
+    allegro_project::keyboard_event_handler(ev);
 }
 
 void allegro_opengl_project::check_input_state()
@@ -301,14 +984,24 @@ void allegro_opengl_project::check_input_state()
     double dy = m_prev_mouse_state.y - m_mouse_state.y;
     double dz = m_prev_mouse_state.z - m_mouse_state.z;
 
-    m_camera.translate(0, 0, -dz * zoom_scale);
-
-    if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_R))
+    // input goes to the view under the mouse cursor, unless a drag is in progress
+    if (!m_mouse_state.buttons)
     {
-        m_camera.reset();
-        m_camera.translate(0, 0, -10);
-        //m_camera.rotate(180, 0, 0);
+        const int gl_y = m_h - m_mouse_state.y;
+        for (std::size_t i = 0; i < m_views.size(); i++)
+        {
+            const view& v = m_views[i];
+            if (m_mouse_state.x >= v.m_x && m_mouse_state.x < v.m_x + v.m_w &&
+                    gl_y >= v.m_y && gl_y < v.m_y + v.m_h)
+                m_active_view = i;
+        }
     }
+    camera_frame& camera = active_camera();
+
+    camera.translate(0, 0, -dz * zoom_scale);
+
+    if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_R))
+        reset_view_camera(m_views[m_active_view]);
 
     if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_RCTRL) ||
             al_key_down(&m_keyboard_state, ALLEGRO_KEY_LCTRL))
@@ -320,27 +1013,27 @@ void allegro_opengl_project::check_input_state()
     }
 
     if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_UP))
-        m_camera.apply_rotation(vv_geom::quat::from_axis_angle({1.0, 0.0, 0.0}, -M_PI / 180 * rot_scale));
+        camera.apply_rotation(vv_geom::quat::from_axis_angle({1.0, 0.0, 0.0}, -M_PI / 180 * rot_scale));
     if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_DOWN))
-        m_camera.apply_rotation(vv_geom::quat::from_axis_angle({1.0, 0.0, 0.0}, M_PI / 180 * rot_scale));
+        camera.apply_rotation(vv_geom::quat::from_axis_angle({1.0, 0.0, 0.0}, M_PI / 180 * rot_scale));
     if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_LEFT))
-        m_camera.apply_rotation(vv_geom::quat::from_axis_angle({0.0, 1.0, 0.0}, -M_PI / 180 * rot_scale));
+        camera.apply_rotation(vv_geom::quat::from_axis_angle({0.0, 1.0, 0.0}, -M_PI / 180 * rot_scale));
     if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_RIGHT))
-        m_camera.apply_rotation(vv_geom::quat::from_axis_angle({0.0, 1.0, 0.0}, M_PI / 180 * rot_scale));
+        camera.apply_rotation(vv_geom::quat::from_axis_angle({0.0, 1.0, 0.0}, M_PI / 180 * rot_scale));
 
     if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_RSHIFT) ||
             al_key_down(&m_keyboard_state, ALLEGRO_KEY_LSHIFT))
     {
         if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_UP))
-            m_camera.translate(0, +0.2, 0);
+            camera.translate(0, +0.2, 0);
         if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_DOWN))
-            m_camera.translate(0, -0.2, 0);
+            camera.translate(0, -0.2, 0);
         if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_LEFT))
-            m_camera.translate(-0.2, 0, 0);
+            camera.translate(-0.2, 0, 0);
         if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_RIGHT))
-            m_camera.translate(+0.2, 0, 0);
+            camera.translate(+0.2, 0, 0);
         if (al_mouse_button_down(&m_prev_mouse_state, 3) && al_mouse_button_down(&m_mouse_state, 3))
-            m_camera.translate(-dx * pan_scale, dy * pan_scale, 0);
+            camera.translate(-dx * pan_scale, dy * pan_scale, 0);
     }
     else if (al_mouse_button_down(&m_prev_mouse_state, 3)  && al_mouse_button_down(&m_mouse_state, 3))
     {
@@ -351,13 +1044,27 @@ void allegro_opengl_project::check_input_state()
         astate.m_y2 = m_mouse_state.y;
 
         vv_geom::quat q = get_arcball_quaternion(astate);
-        m_camera.apply_rotation(q);
+        camera.apply_rotation(q);
     }
 
     if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_MINUS))
-        m_camera.translate(0, 0, -0.2);
+        camera.translate(0, 0, -0.2);
     if (al_key_down(&m_keyboard_state, ALLEGRO_KEY_EQUALS))
-        m_camera.translate(0, 0, +0.2);
+        camera.translate(0, 0, +0.2);
+}
+
+void allegro_opengl_project::pre_frame()
+{
+    allegro_project::pre_frame();
+    if (m_display)
+        m_pacer.begin_frame();
+}
+
+void allegro_opengl_project::post_flip()
+{
+    if (m_display)
+        m_pacer.end_frame(m_frame_input_timestamp);
+    allegro_project::post_flip();
 }
 
 void allegro_opengl_project::pre_render()
@@ -365,6 +1072,11 @@ void allegro_opengl_project::pre_render()
     allegro_project::pre_render();
 
     glPushMatrix(); // save 2d world matrix
+    // the GPU time of the scene spread over what the last frame drew, for debug_view::draw_cost
+    const unsigned last_triangles = m_render_stats.last().m_passes[vv_gl::render_stats::scene].m_triangles;
+    m_ms_per_triangle = m_dynres.is_enabled() && last_triangles ? m_dynres.stats().m_scene_ms / last_triangles : 0;
+    m_cost_max = m_cost_frame_max;
+    m_cost_frame_max = 0;
 
     //glClearColor(0.0, 0.0, 0.2, 1);
     glEnable(GL_DEPTH_TEST);
@@ -373,97 +1085,221 @@ void allegro_opengl_project::pre_render()
     glEnable(GL_ALPHA_TEST);
 
     enable_global_lighting();
-
-    m_camera.update();
 }
 
 void allegro_opengl_project::render()
 {
     allegro_project::render();
-    draw_box();
-    draw_coord_system();
+
+    {
+        VV_TRACE_SCOPE("render", "update_scene");
+        update_scene();
+    }
+    if (m_point_cloud.is_open())
+        m_point_cloud.begin_frame();
+    if (m_textures.size())
+    {
+        VV_TRACE_SCOPE("render", "texture streaming");
+        m_textures.update();
+        m_render_stats.pass(vv_gl::render_stats::scene).m_buffer_bytes += m_textures.stats().m_uploaded_bytes;
+        // mesh space onto the texture: the fitted unit box spans it once, seen along z
+        const bool fit = m_mesh_file.is_open();
+        const GLfloat k = fit ? m_object_fit[3] / 2 : 0.5f;
+        const GLfloat s_plane[4] = {k, 0, 0, 0.5f - (fit ? k * m_object_fit[0] : 0)};
+        const GLfloat t_plane[4] = {0, k, 0, 0.5f - (fit ? k * m_object_fit[1] : 0)};
+        glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+        glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+        glTexGenfv(GL_S, GL_OBJECT_PLANE, s_plane);
+        glTexGenfv(GL_T, GL_OBJECT_PLANE, t_plane);
+    }
+    const bool indirect = gpu_driven();
+    if (indirect)
+    {
+        VV_TRACE_SCOPE("render", "object upload");
+        m_indirect.set_fit(m_object_fit, m_mesh_file.is_open());
+        m_indirect.begin_frame(m_scene, m_views.size());
+        m_render_stats.pass(vv_gl::render_stats::scene).m_buffer_bytes += m_indirect.stats().m_uploaded_bytes;
+    }
+    const debug_view debug = draw_state_flags::m_debug_view;
+    if ((debug == debug_view::draw_cost || debug == debug_view::lod_culling) && m_object_cost.size() != m_scene.size())
+    {
+        m_object_triangles.assign(m_scene.size(), 0);
+        m_object_cost.assign(m_scene.size(), 0.f);
+    }
+    // the counters start from black, the offscreen target takes the clear color too
+    const bool heatmap = debug == debug_view::overdraw;
+    if (heatmap)
+    {
+        glClearColor(0, 0, 0, 1);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    // view rectangles stay in window pixels, they are mapped onto the offscreen target
+    const bool offscreen = m_dynres.begin_scene(m_w, m_h);
+    if (heatmap)
+        m_heatmap.begin(draw_state_flags::m_overdraw_depth_test);
+    const float sx = offscreen ? float(m_dynres.stats().m_width) / m_w : 1.f;
+    const float sy = offscreen ? float(m_dynres.stats().m_height) / m_h : 1.f;
+    if (m_views.size() > 1)
+        glEnable(GL_SCISSOR_TEST);
+    for (std::size_t i = 0; i < m_views.size(); i++)
+    {
+        view& v = m_views[i];
+        const GLint x = GLint(v.m_x * sx), y = GLint(v.m_y * sy);
+        const GLsizei w = std::max(1, GLint((v.m_x + v.m_w) * sx) - x);
+        const GLsizei h = std::max(1, GLint((v.m_y + v.m_h) * sy) - y);
+        glViewport(x, y, w, h);
+        glScissor(x, y, w, h);
+        v.m_camera.update();
+        if (indirect)
+            draw_scene_indirect(v, i);
+        else
+            draw_scene(v);
+        if (heatmap)
+            continue;  // their colors aren't counts
+        draw_point_cloud(v);
+        draw_coord_system();
+    }
+    glDisable(GL_SCISSOR_TEST);
+    vv_gl::pass_stats& stats = m_render_stats.pass(vv_gl::render_stats::scene);
+    if (indirect)
+    {
+        // counted on the GPU, they arrive a frame late
+        const vv_gl::indirect_renderer::statistics& is = m_indirect.stats();
+        stats.m_objects += is.m_visible;
+        stats.m_triangles += is.m_triangles;
+        stats.m_vertices += 3 * is.m_triangles;
+    }
+    if (m_point_cloud.is_open())
+    {
+        const vv_cloud::point_cloud_renderer::statistics& ps = m_point_cloud.stats();
+        stats.m_draw_calls += ps.m_draw_calls;
+        stats.m_vertices += ps.m_drawn_points;
+        stats.m_buffer_bytes += ps.m_uploaded_bytes;
+    }
+    if (heatmap)
+        m_heatmap.end();
+    if (offscreen)
+    {
+        VV_TRACE_SCOPE("render", "upscale");
+        m_dynres.end_scene();
+        stats.m_draw_calls++;
+        stats.m_triangles += 2;
+        stats.m_vertices += 4;
+        stats.m_texture_binds++;
+    }
+    glViewport(0, 0, m_w, m_h);
+    if (heatmap)
+    {
+        VV_TRACE_SCOPE("render", "overdraw_heatmap");
+        m_heatmap.resolve(m_w, m_h);
+        stats.m_draw_calls++;
+        stats.m_triangles += 2;
+        stats.m_vertices += 4;
+        stats.m_texture_binds++;
+        stats.m_state_changes++;
+    }
 }
 
 void allegro_opengl_project::draw_help_message()
 {
     const auto text_color = al_map_rgb(0, 100, 100);
 
-    al_draw_textf(m_system_font, text_color, 10, m_h - 45, ALLEGRO_ALIGN_LEFT,
-                  "%s", "use arrow keys or middle mouse button to rotate model");
-    al_draw_textf(m_system_font, text_color, 10, m_h - 35, ALLEGRO_ALIGN_LEFT,
-                  "%s", "hold shift and middle mouse button to pan");
-    al_draw_textf(m_system_font, text_color, 10, m_h - 25, ALLEGRO_ALIGN_LEFT,
-                  "%s", "\"+/-\" or mouse wheel to zoom in/out");
-    al_draw_textf(m_system_font, text_color, 10, m_h - 15, ALLEGRO_ALIGN_LEFT,
-                  "%s", "\"r\" to reset");
+    m_overlay.text(m_system_font, text_color, 10, m_h - 55, ALLEGRO_ALIGN_LEFT,
+                   "F12 screenshot, F11 start/stop recording, F10 dump trace");
+    m_overlay.text(m_system_font, text_color, 10, m_h - 45, ALLEGRO_ALIGN_LEFT,
+                   "use arrow keys or middle mouse button to rotate model");
+    m_overlay.text(m_system_font, text_color, 10, m_h - 35, ALLEGRO_ALIGN_LEFT,
+                   "hold shift and middle mouse button to pan");
+    m_overlay.text(m_system_font, text_color, 10, m_h - 25, ALLEGRO_ALIGN_LEFT,
+                   "\"+/-\" or mouse wheel to zoom in/out");
+    m_overlay.text(m_system_font, text_color, 10, m_h - 15, ALLEGRO_ALIGN_LEFT,
+                   "\"r\" to reset");
 }
 
 void allegro_opengl_project::draw_debug_info()
 {
-    m_camera.debug_info(m_w - 15, m_h -40);
+    active_camera().debug_info(m_overlay, m_w - 15, m_h -40);
 }
 
-void allegro_opengl_project::draw_box()
+void allegro_opengl_project::draw_box(std::size_t lod, const vv_scene::frustum* f, const GLfloat* color,
+                                      bool textured)
 {
-    double len = 1.;
-
-    GLfloat n[6][3] =      // normals for the 6 faces of a cube
-    {
-        {-1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
-        {0.0, -1.0, 0.0}, {0.0, 0.0, 1.0}, {0.0, 0.0, -1.0}
-    };
-
-    GLint faces[6][4] =    // vertex indices for the 6 faces of a cube
-    {
-        {0, 1, 2, 3}, {3, 2, 6, 7}, {7, 6, 5, 4},
-        {4, 5, 1, 0}, {5, 6, 2, 1}, {7, 4, 0, 3}
-    };
-    GLfloat v[8][3];
-
-    v[0][0] = v[1][0] = v[2][0] = v[3][0] = -len;
-    v[4][0] = v[5][0] = v[6][0] = v[7][0] = len;
-    v[0][1] = v[1][1] = v[4][1] = v[5][1] = -len;
-    v[2][1] = v[3][1] = v[6][1] = v[7][1] = len;
-    v[0][2] = v[3][2] = v[4][2] = v[7][2] = len;
-    v[1][2] = v[2][2] = v[5][2] = v[6][2] = -len;
-
-    if(draw_state_flags::m_shaded)
+    static const GLfloat wire_color[4] = {0.0, 1.0, 1.0, 1.0};
+    // the heatmap counts the faces, one step of ambient each and nothing else
+    const bool counting = draw_state_flags::m_debug_view == debug_view::overdraw;
+    const bool wireframe = draw_state_flags::m_wireframe && !counting;
+    vv_gl::pass_stats& stats = m_render_stats.pass(vv_gl::render_stats::scene);
+    const unsigned program = m_box.get_vertex_format() != vv_gl::mesh_renderer::vertex_format::float32 ? 1 : 0;
+
+    if (draw_state_flags::m_shaded || counting)
     {
         GLfloat red_dif[]= {0.9,  0.0, 0.0, 1.0};
         GLfloat red_amb[]= {0.4,  0.0, 0.0, 1.0};
         GLfloat red_spe[]= {0.0,  0.0, 0.0, 1.0};
+        if (counting)
+        {
+            const GLfloat step = vv_gl::overdraw_heatmap::count_step();
+            const GLfloat count_amb[] = {step, step, step, 1.0};
+            std::fill(red_dif, red_dif + 3, 0.f);
+            std::copy(count_amb, count_amb + 4, red_amb);
+        }
+        else if (color || textured)
+            for (int k = 0; k < 3; k++)
+            {
+                red_dif[k] = color ? color[k] : 0.9f;
+                red_amb[k] = red_dif[k] * 0.45f;
+            }
 
         glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, red_dif);
         glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, red_amb);
         glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, red_spe);
-        for (int i = 0; i < 6; i++)
+        stats.m_state_changes++;
+
+        if (wireframe && draw_state_flags::m_single_pass_wire &&
+            m_box.draw_shaded_wireframe(draw_state_flags::m_wire_width, wire_color))
+        {
+            stats.m_draw_calls++;
+            stats.m_triangles += m_box.stats().m_triangles;
+            stats.m_vertices += 3 * m_box.stats().m_triangles;
+            stats.m_state_changes++;  // the edge program
+            return;
+        }
+
+        // the edges go on top in a second pass, push the faces back a little
+        glPushAttrib(GL_ENABLE_BIT | GL_POLYGON_BIT);
+        if (wireframe)
         {
-            glBegin(GL_QUADS);
-            glNormal3fv(&n[i][0]);
-            glVertex3fv(&v[faces[i][0]][0]);
-            glVertex3fv(&v[faces[i][1]][0]);
-            glVertex3fv(&v[faces[i][2]][0]);
-            glVertex3fv(&v[faces[i][3]][0]);
-            glEnd();
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(1.0, 1.0);
         }
+        if (textured)
+        {
+            // GL_MODULATE by default, the lit color times the texel
+            glEnable(GL_TEXTURE_2D);
+            glEnable(GL_TEXTURE_GEN_S);
+            glEnable(GL_TEXTURE_GEN_T);
+        }
+        const unsigned triangles = m_box.draw_shaded(lod, f, textured);
+        glPopAttrib();
+        stats.m_draw_calls++;
+        stats.m_triangles += triangles;
+        stats.m_vertices += 3 * triangles;
+        stats.m_state_changes += program + (wireframe ? 1 : 0) + (textured ? 1 : 0);
     }
 
-    if(draw_state_flags::m_wireframe)
+    if (wireframe)
     {
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LINE_BIT);
         disable_global_lighting();
-        glColor3f(0.0, 1.0, 1.0);
-        glLineWidth(3);
-        glEnable(GL_POLYGON_OFFSET_FILL);
-        glPolygonOffset(1.0, 1.0);
-        for (int i = 0; i < 6; i++)
-        {
-            glBegin(GL_LINE_LOOP);
-            glVertex3fv(&v[faces[i][0]][0]);
-            glVertex3fv(&v[faces[i][1]][0]);
-            glVertex3fv(&v[faces[i][2]][0]);
-            glVertex3fv(&v[faces[i][3]][0]);
-            glEnd();
-        }
+        glColor4fv(wire_color);
+        glLineWidth(draw_state_flags::m_wire_width);
+        m_box.draw_edges();
+        glPopAttrib();
+        stats.m_draw_calls++;
+        stats.m_lines += m_box.stats().m_edges;
+        stats.m_vertices += 2 * m_box.stats().m_edges;
+        stats.m_state_changes += 2 + program;  // lighting and line width
     }
 }
 
@@ -474,10 +1310,29 @@ void allegro_opengl_project::post_render()
     glDisable(GL_DEPTH_TEST);
     glPopMatrix(); // come back to 2d allegro world
 
+    // the whole HUD goes out in one batch
+    m_overlay.begin(m_w, m_h);
     draw_compas();
     draw_help_message();
     draw_debug_info();
+    m_overlay.build_widgets();
+    m_overlay.flush();
+    {
+        const vv_ui::overlay::statistics& os = m_overlay.stats();
+        vv_gl::pass_stats& hud = m_render_stats.pass(vv_gl::render_stats::hud);
+        hud.m_draw_calls += os.m_al_draw_calls;
+        hud.m_al_draw_calls += os.m_al_draw_calls;
+        hud.m_triangles += os.m_vertices / 3;
+        hud.m_vertices += os.m_vertices;
+        hud.m_texture_binds += os.m_labels ? 1 : 0;  // held drawing keeps one font page
+        hud.m_state_changes += os.m_vertices || os.m_labels ? 2 : 0;  // projection and view transforms
+        hud.m_buffer_bytes += os.m_vertices * sizeof(ALLEGRO_VERTEX);
+    }
     allegro_project::post_render();
+
+    m_stream.end_frame();
+    VV_TRACE_SCOPE("render", "capture");
+    m_capture.capture(m_w, m_h);
 }
 
 void allegro_opengl_project::imgui_render()
@@ -500,10 +1355,117 @@ void allegro_opengl_project::imgui_render()
 
     ImGui::Checkbox("shaded", &draw_state_flags::m_shaded);
     ImGui::Checkbox("wireframe", &draw_state_flags::m_wireframe);
+    if (draw_state_flags::m_wireframe)
+    {
+        ImGui::Checkbox("single pass with shading", &draw_state_flags::m_single_pass_wire);
+        ImGui::SliderFloat("wire width", &draw_state_flags::m_wire_width, 1.f, 8.f);
+        const vv_gl::mesh_renderer::statistics& ms = m_box.stats();
+        ImGui::Text("box: %u triangles, %u edges (%u as triangle outlines)",
+                    ms.m_triangles, ms.m_edges, ms.m_face_loop_lines);
+    }
+    static const char* vertex_formats[] = {"float vertices", "16-bit + oct8 normals", "16-bit + oct16 normals"};
+    int vertex_format = static_cast<int>(m_box.get_vertex_format());
+    if (ImGui::Combo("vertex format", &vertex_format, vertex_formats, 3))
+    {
+        m_box.set_vertex_format(static_cast<vv_gl::mesh_renderer::vertex_format>(vertex_format));
+        upload_object_mesh();
+    }
+    {
+        const vv_gl::mesh_renderer::statistics& ms = m_box.stats();
+        ImGui::Text("vertices %.1f KiB, upload %.2f ms, error %.2g units / %.2f deg", ms.m_vertex_bytes / 1024.0,
+                    ms.m_upload_ms, ms.m_position_error, ms.m_normal_error);
+        bool meshlets = m_box.get_meshlet_culling();
+        if (ImGui::Checkbox("meshlet culling", &meshlets))
+            m_box.set_meshlet_culling(meshlets);
+        ImGui::SameLine();
+        ImGui::Text("%u meshlets, ACMR %.3f", ms.m_meshlets, ms.m_acmr);
+        const vv_mesh::optimize_report& r = m_object_report;
+        if (!m_mesh_file.is_open() && r.m_after.m_acmr > 0)
+            ImGui::Text("optimized: ACMR %.3f -> %.3f, overdraw %.3f -> %.3f", r.m_before.m_acmr, r.m_after.m_acmr,
+                        r.m_overdraw_before, r.m_overdraw_after);
+    }
+    if (m_box.lod_count() > 1)
+    {
+        ImGui::SliderFloat("LOD error px", &m_lod_pixels, 0.25f, 8.f);
+        ImGui::Text("LOD triangles:");
+        for (std::size_t i = 0; i < m_box.lod_count(); i++)
+        {
+            ImGui::SameLine();
+            ImGui::Text("%u", m_box.lod_triangles(i));
+        }
+    }
     ImGui::Checkbox("compas", &draw_state_flags::m_compas);
     ImGui::Checkbox("coord system", &draw_state_flags::m_coord_sys);
+    ImGui::Checkbox("occlusion culling", &draw_state_flags::m_occlusion);
+    if (draw_state_flags::m_occlusion)
+    {
+        const vv_gl::occlusion_culler::statistics& os = m_views[m_active_view].m_occlusion.stats();
+        ImGui::Text("occluders %u, queries %u, occluded %u (%u triangles saved)",
+                    os.m_occluders, os.m_queries, os.m_occluded, os.m_saved_triangles);
+    }
+    ImGui::Checkbox("GPU-driven drawing", &draw_state_flags::m_gpu_driven);
+    if (draw_state_flags::m_gpu_driven)
+    {
+        const vv_gl::indirect_renderer::statistics& is = m_indirect.stats();
+        if (gpu_driven())
+            ImGui::Text("GPU: %u of %u objects visible, %u triangles, %.1f KiB up", is.m_visible, is.m_objects,
+                        is.m_triangles, is.m_uploaded_bytes / 1024.0);
+        else if (!m_indirect.failure().empty())
+            ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "GPU-driven drawing: %s", m_indirect.failure().c_str());
+        else
+            ImGui::Text("CPU path: textures, wireframe, occlusion, debug views and quantized vertices need it");
+    }
+    static const char* debug_views[] = {"no debug view", "overdraw heatmap", "draw cost", "LOD and culling"};
+    int debug = static_cast<int>(draw_state_flags::m_debug_view);
+    if (ImGui::Combo("debug view", &debug, debug_views, 4))
+        draw_state_flags::m_debug_view = static_cast<debug_view>(debug);
+    switch (draw_state_flags::m_debug_view)
+    {
+    case debug_view::overdraw:
+    {
+        ImGui::Checkbox("depth test", &draw_state_flags::m_overdraw_depth_test);
+        const vv_gl::overdraw_heatmap::statistics& hs = m_heatmap.stats();
+        ImGui::Text("%.2f fragments per covered pixel, max %u, %.0f%% covered",
+                    hs.m_average, hs.m_max, hs.m_covered * 100);
+        ImGui::TextColored(ImVec4(0.f, 0.f, 1.f, 1.f), "1");
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(0.f, 1.f, 1.f, 1.f), "3");
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1.f, 1.f, 0.f, 1.f), "6");
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1.f, 0.f, 0.f, 1.f), "8+ layers");
+        break;
+    }
+    case debug_view::draw_cost:
+        ImGui::Text("red: %.1f us per object (CPU submission%s)", m_cost_max,
+                    m_ms_per_triangle > 0 ? " + GPU share by triangles" : ", dynamic resolution adds GPU time");
+        break;
+    case debug_view::lod_culling:
+        ImGui::Text("LOD");
+        for (int i = 0; i < 5; i++)
+        {
+            static const ImVec4 colors[5] = {ImVec4(0.2f, 0.8f, 0.2f, 1.f), ImVec4(0.9f, 0.9f, 0.2f, 1.f),
+                                             ImVec4(1.f, 0.55f, 0.1f, 1.f), ImVec4(0.9f, 0.2f, 0.2f, 1.f),
+                                             ImVec4(0.7f, 0.3f, 0.9f, 1.f)};
+            ImGui::SameLine();
+            ImGui::TextColored(colors[i], i < 4 ? "%d" : "%d+", i);
+        }
+        ImGui::TextColored(ImVec4(0.3f, 0.5f, 1.f, 1.f), "occluder");
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1.f, 0.f, 1.f, 1.f), "occluded bounds");
+        ImGui::SameLine();
+        ImGui::Text("darker: meshlets culled");
+        break;
+    default:
+        break;
+    }
 
-    auto quat = m_camera.get_quat() ? * m_camera.get_quat() : vv_geom::quat();
+    const char* layouts[] = {"single view", "top / front / iso"};
+    int layout = static_cast<int>(m_view_layout);
+    if (ImGui::Combo("views", &layout, layouts, 2))
+        set_view_layout(static_cast<view_layout>(layout));
+
+    auto quat = active_camera().get_quat() ? * active_camera().get_quat() : vv_geom::quat();
     float fx = (float)quat.x;
     float fy = (float)quat.y;
     float fz = (float)quat.z;
@@ -518,6 +1480,191 @@ void allegro_opengl_project::imgui_render()
 
     ImGui::ColorEdit3("bkgnd color", (float *)&clear_color);
 
+    const char* capture_formats[] = {"png sequence", "raw rgba", "y4m"};
+    int capture_format = static_cast<int>(m_capture_format);
+    if (ImGui::Combo("capture", &capture_format, capture_formats, 3))
+        m_capture_format = static_cast<vv_gl::frame_capture::format>(capture_format);
+    if (m_capture.recording())
+        ImGui::Text("recording (F11 to stop): %u written, %u dropped, %u failed",
+                    m_capture.frames_written(), m_capture.frames_dropped(), m_capture.frames_failed());
+
+    if (m_point_cloud.is_open())
+    {
+        const vv_cloud::point_cloud_renderer::statistics& cs = m_point_cloud.stats();
+        float spacing = m_point_cloud.get_pixel_spacing();
+        if (ImGui::SliderFloat("point spacing px", &spacing, 0.5f, 16.f))
+            m_point_cloud.set_pixel_spacing(spacing);
+        ImGui::Text("cloud: %u resident (%.1f MiB), %u selected, %u pending", cs.m_resident_nodes,
+                    cs.m_gpu_bytes / 1048576.0, cs.m_selected_nodes, cs.m_missing_nodes);
+        ImGui::Text("cloud: %u uploads (%.1f KiB), %u evicted, %u points drawn", cs.m_uploaded_nodes,
+                    cs.m_uploaded_bytes / 1024.0, cs.m_evicted_nodes, cs.m_drawn_points);
+    }
+
+    if (m_textures.size())
+    {
+        const vv_gl::texture_streamer::statistics& ts = m_textures.stats();
+        ImGui::Checkbox("textures", &draw_state_flags::m_textured);
+        int limit_mib = static_cast<int>(m_textures.get_memory_limit() >> 20);
+        if (ImGui::SliderInt("texture memory MiB", &limit_mib, 16, 4096))
+            m_textures.set_memory_limit(std::size_t(limit_mib) << 20);
+        int budget_kib = static_cast<int>(m_textures.get_upload_budget() >> 10);
+        if (ImGui::SliderInt("texture upload KiB/frame", &budget_kib, 64, 16384))
+            m_textures.set_upload_budget(std::size_t(budget_kib) << 10);
+        ImGui::Text("textures: %u in view, %u sharp, %u resident of %u, %u decoding, %u failed", ts.m_in_view,
+                    ts.m_sharp, ts.m_resident, ts.m_textures, ts.m_decoding, ts.m_failed);
+        ImGui::Text("textures: %.1f MiB GPU, %.1f MiB decoded, %.1f KiB up (%u levels), %u evicted, %.2f ms",
+                    ts.m_gpu_bytes / 1048576.0, ts.m_cpu_bytes / 1048576.0, ts.m_uploaded_bytes / 1024.0,
+                    ts.m_uploaded_levels, ts.m_evicted_levels, ts.m_update_ms);
+    }
+
+    const vv_gl::stream_buffer::statistics& ss = m_stream.stats();
+    ImGui::Text("stream buffer (%s): %.1f KiB/frame, %u wraps",
+                m_stream.persistent() ? "persistent" : "mapped ranges",
+                ss.m_frame_bytes / 1024.0, ss.m_wraps);
+    if (ss.m_stalls > 0)
+        ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "stream buffer stalls: %u, %.2f ms total",
+                           ss.m_stalls, ss.m_stall_seconds * 1000);
+
+    bool dynres = m_dynres.is_enabled();
+    if (ImGui::Checkbox("dynamic resolution", &dynres))
+        m_dynres.set_enabled(dynres);
+    if (dynres)
+    {
+        vv_gl::dynamic_resolution::settings& ds = m_dynres.get_settings();
+        float target_ms = static_cast<float>(ds.m_target_ms);
+        if (ImGui::SliderFloat("target ms", &target_ms, 4.f, 100.f))
+            ds.m_target_ms = target_ms;
+        ImGui::SliderFloat("min scale", &ds.m_min_scale, 0.1f, 1.f);
+        ImGui::SliderInt("max samples", &ds.m_max_samples, 0, 8);
+        const vv_gl::dynamic_resolution::statistics& rs = m_dynres.stats();
+        ImGui::Text("scene %dx%d (%.0f%%), %d samples, %.2f ms %s, %u changes", rs.m_width, rs.m_height,
+                    m_dynres.scale() * 100, m_dynres.samples(), rs.m_scene_ms,
+                    rs.m_gpu_timer ? "gpu" : "cpu", rs.m_changes);
+    }
+
+    int frames_in_flight = m_pacer.frames_in_flight();
+    if (ImGui::SliderInt("frames in flight", &frames_in_flight, 1, vv_gl::frame_pacer::max_frames_in_flight))
+    {
+        m_pacer.set_frames_in_flight(frames_in_flight);
+        m_pacer.reset_latency();
+    }
+    const vv_gl::frame_pacer::statistics& ps = m_pacer.stats();
+    ImGui::Text("input latency %.1f ms (avg %.1f, max %.1f), gpu wait %.2f ms", ps.m_latency_ms,
+                ps.m_latency_avg_ms, ps.m_latency_max_ms, ps.m_wait_ms);
+
+    if (ImGui::CollapsingHeader("jobs"))
+    {
+        for (unsigned i = 0; i < m_jobs.worker_count(); i++)
+        {
+            const vv_jobs::job_system::worker_stats& js = m_jobs.stats(i);
+            char label[64];
+            std::snprintf(label, sizeof(label), "%u: %.2f ms, %u jobs, %u stolen", i, js.m_busy_ms, js.m_jobs, js.m_steals);
+            ImGui::ProgressBar(static_cast<float>(js.m_utilization), ImVec2(-FLT_MIN, 0), label);
+        }
+    }
+
+    if (ImGui::CollapsingHeader("render statistics"))
+    {
+        typedef vv_gl::render_stats rs;
+        const rs::frame& last = m_render_stats.last();
+        const vv_gl::pass_stats total = last.total();
+        if (ImGui::BeginTable("render stats", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("counter");
+            for (int p = 0; p <= rs::pass_count; p++)
+                ImGui::TableSetupColumn(rs::name(static_cast<rs::pass_id>(p)));
+            ImGui::TableSetupColumn("mean");
+            ImGui::TableSetupColumn("max");
+            ImGui::TableHeadersRow();
+            for (int c = 0; c < rs::counter_count; c++)
+            {
+                const rs::counter counter = static_cast<rs::counter>(c);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", rs::name(counter));
+                for (int p = 0; p < rs::pass_count; p++)
+                {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.0f", rs::value(last.m_passes[p], counter));
+                }
+                ImGui::TableNextColumn();
+                ImGui::Text("%.0f", rs::value(total, counter));
+                const rs::summary sum = m_render_stats.summarize(counter);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", sum.m_mean);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.0f", sum.m_max);
+            }
+            ImGui::EndTable();
+        }
+
+        const char* names[rs::counter_count];
+        for (int c = 0; c < rs::counter_count; c++)
+            names[c] = rs::name(static_cast<rs::counter>(c));
+        ImGui::Combo("plotted", &m_plotted_counter, names, rs::counter_count);
+        // oldest frame first, totals of all passes
+        struct plot_source
+        {
+            const rs* m_stats;
+            rs::counter m_counter;
+        } source = {&m_render_stats, static_cast<rs::counter>(m_plotted_counter)};
+        const int frames = static_cast<int>(m_render_stats.history_size());
+        ImGui::PlotLines("##render stats history", [](void* data, int i)
+                         {
+                             const plot_source* ps = static_cast<const plot_source*>(data);
+                             const std::size_t ago = ps->m_stats->history_size() - 1 - i;
+                             return static_cast<float>(rs::value(ps->m_stats->history(ago).total(), ps->m_counter));
+                         }, &source, frames, 0, nullptr, 0.f, FLT_MAX, ImVec2(0, 60));
+    }
+
+    const vv_gl::program_cache::statistics& pcs = m_programs.stats();
+    ImGui::Text("shader cache%s: %u hits, %u misses, %u rejected, %.1f ms saved",
+                m_programs.binaries_supported() ? "" : " (no binaries)", pcs.m_hits, pcs.m_misses,
+                pcs.m_rejected, pcs.m_saved_ms);
+
+    const vv_ui::overlay::statistics& hs = m_overlay.stats();
+    ImGui::Text("overlay: %u vertices, %u labels, %u widgets", hs.m_vertices, hs.m_labels, hs.m_widgets);
+
+    ImGui::Text("frame arena: %.1f / %.1f KiB, peak %.1f KiB",
+                m_frame_arena.used() / 1024.0,
+                m_frame_arena.capacity() / 1024.0,
+                m_frame_arena.high_water_mark() / 1024.0);
+    if (m_frame_arena.overflow_bytes() > 0)
+        ImGui::Text("frame arena overflow: %.1f KiB, grown %u times",
+                    m_frame_arena.overflow_bytes() / 1024.0,
+                    m_frame_arena.grow_count());
+
+    if (vv_mem::allocation_tracking_enabled() && ImGui::CollapsingHeader("heap allocations"))
+    {
+        const vv_mem::alloc_counters& ac = m_alloc_monitor.last_frame();
+        ImGui::Text("frame: %u allocs, %u frees, %.1f KiB", unsigned(ac.m_allocs), unsigned(ac.m_frees), ac.m_bytes / 1024.0);
+        ImGui::Text("live %.1f KiB, frame peak %.1f KiB", ac.m_live_bytes / 1024.0, ac.m_peak_bytes / 1024.0);
+        if (m_alloc_monitor.violations() > 0)
+            ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "steady state violated in %u frames, first at %u (%s)",
+                               m_alloc_monitor.violations(), m_alloc_monitor.first_violation_frame(),
+                               m_alloc_monitor.first_violation_zone() ? m_alloc_monitor.first_violation_zone() : "no zone");
+        if (m_alloc_monitor.last_frame_zone_count() > 0 &&
+            ImGui::BeginTable("alloc zones", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("zone");
+            ImGui::TableSetupColumn("allocs");
+            ImGui::TableSetupColumn("KiB");
+            ImGui::TableHeadersRow();
+            for (std::size_t i = 0; i < m_alloc_monitor.last_frame_zone_count(); i++)
+            {
+                const vv_mem::allocation_monitor::zone_stats& z = m_alloc_monitor.last_frame_zones()[i];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", z.m_name ? z.m_name : "(no zone)");
+                ImGui::TableNextColumn();
+                ImGui::Text("%u", unsigned(z.m_allocs));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", z.m_bytes / 1024.0);
+            }
+            ImGui::EndTable();
+        }
+    }
+
     ImGui::PopItemWidth();
 
     al_clear_to_color(al_map_rgb(clear_color.x * 255,
@@ -536,93 +1683,42 @@ void allegro_opengl_project::enable_global_lighting()
 
     glEnable(GL_LIGHT0);
     glEnable(GL_LIGHTING);
+    // objects are drawn scaled, keep their normals unit length
+    glEnable(GL_RESCALE_NORMAL);
 }
 
 void allegro_opengl_project::disable_global_lighting()
 {
     glDisable(GL_LIGHT0);
     glDisable(GL_LIGHTING);
+    glDisable(GL_RESCALE_NORMAL);
 }
 
 void allegro_opengl_project::draw_compas()
 {
     if (!draw_state_flags::m_compas)
         return;
-    int compas_size = 60;
-    int axis_length = 35;
-    int text_offset = 12;
-
-    glPushMatrix();
-
-    //glDisable(GL_DEPTH_TEST);
-    //glDisable(GL_CULL_FACE);
-    //glDisable(GL_TEXTURE_2D);
-    //glDisable(GL_LIGHTING);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    //glOrtho(0, m_w, m_h, 0, -compas_size, compas_size);
-    glOrtho(0, m_w, 0, m_h, -compas_size, compas_size);
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
-    glTranslated(m_w - compas_size, m_h - compas_size, 0);
-
-    auto quat = m_camera.get_quat() ? * m_camera.get_quat() : vv_geom::quat();
-    double rotation_matrix[16];
-    quat.to_rotation_matrix(rotation_matrix);
-    glMultMatrixd(rotation_matrix);
-
-    glScaled(1, 1, 1);
-
-    glLineWidth(3);
-
-    glColor3f(1.0, 0.0, 0.0);
-    glBegin(GL_LINES);   // x-axis
-    glVertex3f(0.0, 0.0, 0.0);
-    glVertex3f(axis_length, 0, 0);
-    glEnd();
-
-    glColor3f(0.0, 1.0, 0.0);
-    glBegin(GL_LINES);  // y-axis
-    glVertex3f(0.0, 0.0, 0.0);
-    glVertex3f(0, axis_length, 0);
-    glEnd();
-
-    glColor3f(0.0, 0.0, 1.0);
-    glBegin(GL_LINES);  // z-axis
-    glVertex3f(0.0, 0.0, 0.0);
-    glVertex3f(0, 0, axis_length);
-    glEnd();
-
-    glDisable(GL_DEPTH_TEST);
-    glPopMatrix();
-
-    // Draw axes labels
-    vv_geom::vec3 x_axis = vv_geom::rotate_vector(vv_geom::vec3(axis_length + text_offset, 0, 0), quat);
-    vv_geom::vec3 y_axis = vv_geom::rotate_vector(vv_geom::vec3(0, axis_length + text_offset, 0), quat);
-    vv_geom::vec3 z_axis = vv_geom::rotate_vector(vv_geom::vec3(0, 0, axis_length + text_offset), quat);
-
-    al_draw_textf(m_system_font,
-		  al_map_rgb(100, 0, 100),
-		  m_w - compas_size + x_axis.x,  // x coord
-		  compas_size - x_axis.y,       // y coord
-		  ALLEGRO_ALIGN_LEFT,
-		  "%s", "X");
-
-    al_draw_textf(m_system_font,
-		  al_map_rgb(100, 100, 0),
-		  m_w - compas_size + y_axis.x,  // x coord
-		  compas_size - y_axis.y,       // y coord
-		  ALLEGRO_ALIGN_LEFT,
-		  "%s", "Y");
-
-    al_draw_textf(m_system_font,
-		  al_map_rgb(0, 100, 100),
-		  m_w - compas_size + z_axis.x,  // x coord
-		  compas_size - z_axis.y,       // y coord
-		  ALLEGRO_ALIGN_LEFT,
-		  "%s", "Z");
+    const int compas_size = 60;
+    const int axis_length = 35;
+    const int text_offset = 12;
+
+    // the axes are rotated on the CPU and projected orthographically, y flips to screen space
+    const float cx = m_w - compas_size;
+    const float cy = compas_size;
+    auto quat = active_camera().get_quat() ? * active_camera().get_quat() : vv_geom::quat();
+    const double dirs[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    const ALLEGRO_COLOR axis_colors[3] = {al_map_rgb(255, 0, 0), al_map_rgb(0, 255, 0), al_map_rgb(0, 0, 255)};
+    const ALLEGRO_COLOR label_colors[3] = {al_map_rgb(100, 0, 100), al_map_rgb(100, 100, 0), al_map_rgb(0, 100, 100)};
+    const char* labels[3] = {"X", "Y", "Z"};
+    for (int i = 0; i < 3; i++)
+    {
+        const double* d = dirs[i];
+        const double l = axis_length + text_offset;
+        const vv_geom::vec3 axis = vv_geom::rotate_vector(vv_geom::vec3(d[0] * axis_length, d[1] * axis_length, d[2] * axis_length), quat);
+        const vv_geom::vec3 label = vv_geom::rotate_vector(vv_geom::vec3(d[0] * l, d[1] * l, d[2] * l), quat);
+        m_overlay.line(cx, cy, cx + axis.x, cy - axis.y, axis_colors[i], 3);
+        m_overlay.text(m_system_font, label_colors[i], cx + label.x, cy - label.y, ALLEGRO_ALIGN_LEFT, labels[i]);
+    }
 }
 
 void allegro_opengl_project::draw_coord_system()
@@ -630,33 +1726,48 @@ void allegro_opengl_project::draw_coord_system()
     if (!draw_state_flags::m_coord_sys)
         return;
 
-    int axis_length = 1;
+    const GLfloat axis_length = 1;
+    const GLfloat axes[] =
+    {
+        0, 0, 0,  1, 0, 0,  axis_length, 0, 0, 1, 0, 0,  // x-axis
+        0, 0, 0,  0, 1, 0,  0, axis_length, 0, 0, 1, 0,  // y-axis
+        0, 0, 0,  0, 0, 1,  0, 0, axis_length, 0, 0, 1   // z-axis
+    };
+
     glPushMatrix();
     glScaled(0.3, 0.3, 0.3);
     glLineWidth(3);
 
     disable_global_lighting();
-    glColor3f(1.0, 0.0, 0.0);
-    glBegin(GL_LINES);   // x-axis
-    glVertex3f(0.0, 0.0, 0.0);
-    glVertex3f(axis_length, 0, 0);
-    glEnd();
-
-    glColor3f(0.0, 1.0, 0.0);
-    glBegin(GL_LINES);  // y-axis
-    glVertex3f(0.0, 0.0, 0.0);
-    glVertex3f(0, axis_length, 0);
-    glEnd();
-
-    glColor3f(0.0, 0.0, 1.0);
-    glBegin(GL_LINES);  // z-axis
-    glVertex3f(0.0, 0.0, 0.0);
-    glVertex3f(0, 0, axis_length);
-    glEnd();
+    draw_stream_lines(axes, 6);
 
     glPopMatrix();
 }
 
+void allegro_opengl_project::draw_stream_lines(const GLfloat* vertices, int count)
+{
+    // interleaved x, y, z, r, g, b per vertex
+    const GLsizei stride = 6 * sizeof(GLfloat);
+    const std::size_t offset = m_stream.push(vertices, count * stride);
+    if (offset == vv_gl::stream_buffer::npos)
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_stream.buffer());
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, reinterpret_cast<const void*>(offset));
+    glColorPointer(3, GL_FLOAT, stride, reinterpret_cast<const void*>(offset + 3 * sizeof(GLfloat)));
+    glDrawArrays(GL_LINES, 0, count);
+    vv_gl::pass_stats& stats = m_render_stats.pass(vv_gl::render_stats::scene);
+    stats.m_draw_calls++;
+    stats.m_lines += count / 2;
+    stats.m_vertices += count;
+    stats.m_buffer_bytes += count * stride;
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 vv_geom::quat allegro_opengl_project::get_arcball_quaternion(const arcball_state_struct &astate)
 {
  if (astate.m_x1 > m_w || astate.m_x2 > m_w ||
@@ -705,6 +1816,50 @@ vv_geom::quat allegro_opengl_project::get_arcball_quaternion(const arcball_state
 
 //  allegro_opengl_project::transformation implementation ///////////////////////////
 
+allegro_opengl_project::camera_frame::camera_frame(const camera_frame& other)
+{
+    *this = other;
+}
+
+allegro_opengl_project::camera_frame& allegro_opengl_project::camera_frame::operator=(const camera_frame& other)
+{
+    if (this == &other)
+        return *this;
+    vv_geom::quat* rotation = m_rotation;
+    if (other.m_rotation)
+    {
+        if (!rotation)
+            rotation = new vv_geom::quat();
+        *rotation = *other.m_rotation;
+    }
+    else
+    {
+        delete rotation;
+        rotation = nullptr;
+    }
+    m_init = other.m_init;
+    m_x = other.m_x;
+    m_y = other.m_y;
+    m_z = other.m_z;
+    m_xs = other.m_xs;
+    m_ys = other.m_ys;
+    m_zs = other.m_zs;
+    m_rotation = rotation;
+    m_changed_translation = other.m_changed_translation;
+    m_changed_rotation = other.m_changed_rotation;
+    m_changed_scale = other.m_changed_scale;
+    m_fov = other.m_fov;
+    m_znear = other.m_znear;
+    m_zfar = other.m_zfar;
+    m_aspect = other.m_aspect;
+    return *this;
+}
+
+allegro_opengl_project::camera_frame::~camera_frame()
+{
+    delete m_rotation;
+}
+
 void allegro_opengl_project::camera_frame::init_projection(double fov, double znear, double zfar, double aspect)
 {
     m_fov = fov;
@@ -773,7 +1928,24 @@ void allegro_opengl_project::camera_frame::apply_rotation(const vv_geom::quat& q
     m_changed_rotation = true;
 }
 
-void allegro_opengl_project::camera_frame::debug_info(int x, int y)
+void allegro_opengl_project::camera_frame::set_rotation(double xa, double ya, double za)
+{
+    if (nullptr == m_rotation)
+        m_rotation = new vv_geom::quat();
+    m_rotation->from_euler(xa, ya, za);
+    m_changed_rotation = true;
+}
+
+void allegro_opengl_project::camera_frame::set_rotation(double w, double x, double y, double z)
+{
+    if (nullptr == m_rotation)
+        m_rotation = new vv_geom::quat();
+    *m_rotation = vv_geom::quat(w, x, y, z);
+    m_rotation->normalize();
+    m_changed_rotation = true;
+}
+
+void allegro_opengl_project::camera_frame::debug_info(vv_ui::overlay& o, int x, int y)
 {
     const auto font  = allegro_opengl_project::get_system_font();
     const auto color = al_map_rgb(0, 200, 0);
@@ -781,9 +1953,9 @@ void allegro_opengl_project::camera_frame::debug_info(int x, int y)
     double xa = 0, ya = 0, za = 0;
     if (nullptr != m_rotation)
         m_rotation->convert_to_euler(xa, ya, za);
-    al_draw_textf(font, color, x, y, ALLEGRO_ALIGN_RIGHT, "%f", xa);
-    al_draw_textf(font, color, x, y + 10, ALLEGRO_ALIGN_RIGHT, "%f", ya);
-    al_draw_textf(font, color, x, y + 20, ALLEGRO_ALIGN_RIGHT, "%f", za);
+    o.textf(font, color, x, y, ALLEGRO_ALIGN_RIGHT, "%f", xa);
+    o.textf(font, color, x, y + 10, ALLEGRO_ALIGN_RIGHT, "%f", ya);
+    o.textf(font, color, x, y + 20, ALLEGRO_ALIGN_RIGHT, "%f", za);
 }
 
 void allegro_opengl_project::camera_frame::update()
@@ -808,6 +1980,43 @@ void allegro_opengl_project::camera_frame::update()
     m_changed_translation = false;
 }
 
+// same transformation as update() builds on the GL matrix stacks: P * T * R * S
+void allegro_opengl_project::camera_frame::get_view_projection(double matrix[16]) const
+{
+    const double pi = std::acos(-1);
+    const double h = 2 * m_znear * std::tan(m_fov*pi/(2*180));
+    const double w = h * m_aspect;
+
+    double projection[16] = {0};
+    projection[0]  = 2 * m_znear / w;
+    projection[5]  = 2 * m_znear / h;
+    projection[10] = -(m_zfar + m_znear) / (m_zfar - m_znear);
+    projection[11] = -1;
+    projection[14] = -2 * m_zfar * m_znear / (m_zfar - m_znear);
+
+    double model_view[16];
+    vv_geom::quat rotation = m_rotation ? *m_rotation : vv_geom::quat();
+    rotation.to_rotation_matrix(model_view);
+    for (int i = 0; i < 3; i++)
+    {
+        model_view[i]     *= m_xs;
+        model_view[4 + i] *= m_ys;
+        model_view[8 + i] *= m_zs;
+    }
+    model_view[12] = m_x;
+    model_view[13] = m_y;
+    model_view[14] = m_z;
+
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+        {
+            double sum = 0;
+            for (int k = 0; k < 4; k++)
+                sum += projection[4 * k + r] * model_view[4 * c + k];
+            matrix[4 * c + r] = sum;
+        }
+}
+
 double allegro_opengl_project::camera_frame::get_x()
 {
     return m_x;
@@ -1,5 +1,8 @@
+#ifndef allegro_project_h
+#define allegro_project_h
 #include <iostream>
 #include <algorithm>
+#include <vector>
 
 #include <allegro5/allegro5.h>
 #include <allegro5/allegro_opengl.h>
@@ -8,6 +11,14 @@
 #include <allegro5/allegro_image.h>
 #include <allegro5/allegro_ttf.h>
 
+#include "vv_alloc_tracker.h"
+#include "vv_frame_arena.h"
+#include "vv_jobs.h"
+#include "vv_program_cache.h"
+#include "vv_render_stats.h"
+#include "vv_scene.h"
+#include "vv_trace.h"
+
 
 class allegro_project
 {
@@ -17,16 +28,40 @@ public:
     virtual void init(int display_flags, bool enable_imgui = true);
     virtual void create_display(int w, int h);
     virtual void display_resize(int w, int h);
+    virtual void pre_frame();
     virtual void pre_render();
     virtual void render();
     virtual void post_render();
+    virtual void post_flip();
     virtual void imgui_render();
     virtual bool init_fps_timer(double speed_sec = 1.0/24.0);
     virtual void keyboard_event_handler(const ALLEGRO_EVENT& ev);
     virtual void check_input_state();
     virtual void main_loop();
+    // one frame from input to flip, main_loop() calls it on the fps timer
+    void draw_frame();
     static const ALLEGRO_FONT* get_system_font();
     static void allegro_check_version();
+    vv_mem::frame_arena& get_frame_arena() {return m_frame_arena;}
+    // work-stealing scheduler, one worker per hardware thread, started by init()
+    vv_jobs::job_system& get_jobs() {return m_jobs;}
+    // counts heap use per frame, only when built with VV_TRACK_ALLOCATIONS
+    vv_mem::allocation_monitor& get_allocation_monitor() {return m_alloc_monitor;}
+    // trace written by F10 and on exit, empty disables the dump at exit
+    void set_trace_file(const std::string& path) {m_trace_file = path;}
+    bool dump_trace();
+    // MSAA samples asked for the window back buffer, call before init(), 0 disables it;
+    // allegro_opengl_project asks for none when dynamic resolution is on at create_display()
+    void set_back_buffer_samples(int samples) {m_back_buffer_samples = samples;}
+    // linked GLSL programs, opened by create_display() on an OpenGL display
+    vv_gl::program_cache& get_program_cache() {return m_programs;}
+    // where program binaries are kept, call before create_display(), empty disables the files
+    void set_shader_cache_dir(const std::string& path) {m_shader_cache_dir = path;}
+    // what every frame submitted by pass, last() is the frame draw_frame() just finished
+    vv_gl::render_stats& get_render_stats() {return m_render_stats;}
+    const vv_gl::render_stats& get_render_stats() const {return m_render_stats;}
+    // background of frames without ImGui, which keeps its own
+    void set_clear_color(ALLEGRO_COLOR color) {m_clear_color = color;}
 
 protected:
     static ALLEGRO_FONT*   m_system_font;
@@ -41,25 +76,96 @@ protected:
     ALLEGRO_TIMER*         m_fps           = nullptr;
     int                    m_w             = 0;
     int                    m_h             = 0;
+    vv_mem::frame_arena    m_frame_arena;  // transient per-frame data, reset before each draw
+    std::string            m_trace_file;
+    int                    m_back_buffer_samples = 8;
+    double                 m_input_timestamp = 0;        // oldest input event no frame has read yet
+    double                 m_frame_input_timestamp = 0;  // the one the current frame reflects, 0 if none
+    vv_mem::allocation_monitor m_alloc_monitor;
+    vv_jobs::job_system    m_jobs;
+    vv_gl::program_cache   m_programs;
+    vv_gl::render_stats    m_render_stats;
+    std::string            m_shader_cache_dir = "shader_cache";
+    ALLEGRO_COLOR          m_clear_color = {0, 148 / 255.f, 204 / 255.f, 1};
 };
 
 #ifdef ALLEGRO_PROJECT_OPENGL
+#include "vv_dynamic_resolution.h"
+#include "vv_frame_capture.h"
+#include "vv_frame_pacer.h"
+#include "vv_point_cloud.h"
+#include "vv_stream_buffer.h"
+#include "vv_occlusion.h"
+#include "vv_overdraw.h"
+#include "vv_mesh_renderer.h"
+#include "vv_indirect_draw.h"
+#include "vv_texture_stream.h"
+#include "vv_overlay.h"
+
 namespace vv_geom{ struct quat;}
 class allegro_opengl_project : public allegro_project
 {
 public:
+    // viewports layout of the main window
+    enum class view_layout
+    {
+        single,        // one perspective view
+        top_front_iso  // three views side by side
+    };
+
+    // what the scene objects are colored by, for finding out why a scene is slow
+    enum class debug_view
+    {
+        none,
+        overdraw,     // fragments per pixel as a heatmap, point cloud and axes left out
+        draw_cost,    // green to red by triangles drawn and submission time
+        lod_culling   // LOD level, occluders in blue, occluded bounds in magenta
+    };
+
+    virtual ~allegro_opengl_project();
     virtual void create_display(int w, int h);
     virtual void display_resize(int w, int h);
+    virtual void pre_frame() override;
     virtual void pre_render();
     virtual void render();
     virtual void post_render();
+    virtual void post_flip() override;
     virtual void imgui_render() override;
+    virtual void keyboard_event_handler(const ALLEGRO_EVENT& ev) override;
     virtual void check_input_state() override;
     virtual void draw_compas();
     virtual void draw_coord_system();
     virtual void draw_help_message();
     virtual void draw_debug_info();
-    void draw_box();
+    // f in mesh space culls the meshlets of LOD 0, color replaces the red material;
+    // textured: the texture is bound and the texgen planes are set, the material turns white
+    void draw_box(std::size_t lod = 0, const vv_scene::frustum* f = nullptr, const GLfloat* color = nullptr,
+                  bool textured = false);
+    void set_view_layout(view_layout layout);
+    view_layout get_view_layout() const {return m_view_layout;}
+    vv_scene::scene& get_scene() {return m_scene;}
+    vv_gl::frame_capture& get_frame_capture() {return m_capture;}
+    vv_gl::stream_buffer& get_stream_buffer() {return m_stream;}
+    bool open_point_cloud(const std::string& path);
+    vv_cloud::point_cloud_renderer& get_point_cloud() {return m_point_cloud;}
+    // 2D HUD of the frame, add an overlay_widget to draw custom elements
+    vv_ui::overlay& get_overlay() {return m_overlay;}
+    // offscreen 3D scene following a frame-time budget, the HUD stays at window resolution;
+    // enable it before create_display() to get a single-sampled back buffer
+    vv_gl::dynamic_resolution& get_dynamic_resolution() {return m_dynres;}
+    // frames queued ahead of the GPU (1..3) and input-to-present latency
+    vv_gl::frame_pacer& get_frame_pacer() {return m_pacer;}
+    // mesh drawn for every scene object, the unit box by default;
+    // triangles and vertices are reordered for the GPU unless optimize is false
+    void set_object_mesh(const vv_mesh::mesh& m, bool optimize = true);
+    const vv_mesh::optimize_report& get_object_mesh_report() const {return m_object_report;}
+    // mapped .vvmesh for every scene object, fitted into the unit box; LODs follow the screen size
+    bool open_mesh(const std::string& path);
+    // image files streamed in as the objects need them, scene::set_texture() assigns them;
+    // the texture spans the unit box of an object once, projected along z
+    vv_gl::texture_streamer& get_textures() {return m_textures;}
+    // moving objects bounce inside the cube |x|,|y|,|z| <= limit
+    void set_motion_limit(float limit) {m_motion_limit = limit;}
 
     struct draw_state_flags
     {
@@ -67,6 +173,13 @@ public:
         static bool m_wireframe;
         static bool m_compas;
         static bool m_coord_sys;
+        static bool m_occlusion;
+        static bool m_single_pass_wire;  // shaded + wireframe through the edge shader
+        static float m_wire_width;       // pixels
+        static debug_view m_debug_view;
+        static bool m_overdraw_depth_test;  // false counts the hidden fragments too
+        static bool m_textured;
+        static bool m_gpu_driven;  // compute culling and one indirect draw per view when the GL allows
     };
 
     struct arcball_state_struct
@@ -82,18 +195,29 @@ public:
     class camera_frame
     {
     public:
+        camera_frame() = default;
+        camera_frame(const camera_frame& other);
+        camera_frame& operator=(const camera_frame& other);
+        ~camera_frame();
+
         void init_projection(double fov = 45, double znear = 1, double zfar = 10, double aspect = 1);
         void reset();
         void reset_projection();
         void scale(double dxs, double dxy, double dxz, bool absolute = false);
         void translate(double dx, double dy, double dz, bool absolute = false);
         void apply_rotation(const vv_geom::quat& q);
+        // replace the rotation, angles in radians as quat::from_euler takes them
+        void set_rotation(double xa, double ya, double za);
+        void set_rotation(double w, double x, double y, double z);
         void update();
-        void debug_info(int x, int y);
+        void debug_info(vv_ui::overlay& o, int x, int y);
         double get_x();
         double get_y();
         double get_z();
 	const vv_geom::quat* get_quat() {return m_rotation;}
+        void get_view_projection(double matrix[16]) const;
+        double get_fov() const {return m_fov;}
+        double get_znear() const {return m_znear;}
 
     protected:
         bool m_init = false;
@@ -115,8 +239,76 @@ public:
         double m_aspect = 1;
     };
 
+    // Independent view of the shared scene: own viewport, camera and visible set
+    struct view
+    {
+        int m_x = 0;  // viewport in window pixels, bottom-left origin
+        int m_y = 0;
+        int m_w = 0;
+        int m_h = 0;
+        double m_preset_xa = 0; // initial camera orientation, radians
+        double m_preset_ya = 0;
+        camera_frame          m_camera;
+        double                m_view_projection[16];
+        vv_scene::frustum     m_frustum;
+        std::vector<uint32_t> m_visible;
+        std::vector<uint32_t> m_cloud_nodes; // point cloud octree nodes to draw
+        vv_gl::occlusion_culler m_occlusion;
+    };
+
 protected:
-    camera_frame m_camera;
+    std::vector<view> m_views;
+    std::size_t       m_active_view = 0;
+    view_layout       m_view_layout = view_layout::single;
+    vv_scene::scene   m_scene;
+    unsigned          m_occluder_count = 8;  // largest objects drawn first without queries
+    float             m_motion_limit = 25;
+
+    vv_gl::frame_capture         m_capture;
+    vv_gl::frame_capture::format m_capture_format = vv_gl::frame_capture::format::png;
+    unsigned                     m_screenshot_index = 0;
+
+    vv_gl::stream_buffer           m_stream;  // per-frame dynamic geometry
+    vv_cloud::point_cloud_renderer m_point_cloud;
+    double                         m_cloud_scale = 1;
+    double                         m_cloud_center[3] = {0, 0, 0};
+    vv_gl::mesh_renderer           m_box;  // drawn for every scene object, the unit box by default
+    vv_mesh::mesh                  m_object_mesh;
+    vv_mesh::mesh_file             m_mesh_file;  // m_object_mesh when open
+    vv_mesh::optimize_report       m_object_report;  // of the last set_object_mesh
+    float                          m_object_fit[4] = {0, 0, 0, 1};  // center and scale into the unit box
+    float                          m_lod_pixels = 1;  // LOD error allowed on screen
+    int                            m_plotted_counter = vv_gl::render_stats::draw_calls;  // in the statistics window
+    vv_ui::overlay                 m_overlay;
+    vv_gl::dynamic_resolution      m_dynres;
+    vv_gl::frame_pacer             m_pacer;
+    vv_gl::overdraw_heatmap        m_heatmap;
+    vv_gl::texture_streamer        m_textures;
+    vv_gl::indirect_renderer       m_indirect;
+    // debug_view::draw_cost and lod_culling: per object, last time it was drawn
+    std::vector<unsigned>          m_object_triangles;
+    std::vector<float>             m_object_cost;    // microseconds, CPU submission + share of the GPU time
+    float                          m_cost_max = 0;   // of the previous frame, the top of the color ramp
+    float                          m_cost_frame_max = 0;
+    double                         m_ms_per_triangle = 0;  // GPU scene time over triangles, with dynamic resolution
+
+    camera_frame& active_camera() {return m_views[m_active_view].m_camera;}
+    void update_views_layout();
+    void reset_view_camera(view& v);
+    void upload_object_mesh();  // m_mesh_file, m_object_mesh or the unit box, in that order
+    // looks at the origin from distance, pitch and yaw in radians on top of the view preset
+    void set_orbit_camera(view& v, double distance, double pitch, double yaw);
+    // m_indirect draws the scene this frame, the CPU path stays for what it can't do
+    bool gpu_driven();
+    void update_scene();  // moves the objects and culls every view
+    void draw_scene(view& v);
+    void draw_scene_indirect(view& v, std::size_t index);
+    void draw_object(uint32_t id, const view& v, bool occluder = false);
+    // color of the object under the debug view, false when it keeps the material
+    bool debug_color(uint32_t id, std::size_t lod, bool occluder, GLfloat color[4]) const;
+    void draw_hidden_bounds(const vv_mem::frame_vector<uint32_t>& hidden);
+    void draw_point_cloud(view& v);
+    void draw_stream_lines(const GLfloat* vertices, int count);
 
     virtual void enable_global_lighting();
     virtual void disable_global_lighting();
@@ -129,3 +321,4 @@ protected:
 
 #define END_EXCEPTION_CATCH() } catch(const char* ex)			\
 				{ std::cout << "exception: " << ex << std::endl; }
+#endif
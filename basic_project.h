@@ -0,0 +1,274 @@
+#ifndef basic_project_h
+#define basic_project_h
+#include <type_traits>
+#include "allegro_project.h"
+#include "imgui.h"
+#include "imgui_impl_allegro5.h"
+
+// Static-dispatch variant of allegro_project. The frame loop calls the hooks
+// of Derived directly, so they can be inlined:
+//
+//   class viewer : public basic_project<viewer>
+//   {
+//   public:
+//       static constexpr bool use_imgui = false;   // compiled out entirely
+//       void render() { ... }
+//   };
+//
+// A hook that Derived does not declare falls back to the default below.
+// use_imgui and use_opengl are read at compile time, stages switched off
+// there leave no code and no ImGui / GL references behind.
+template <class Derived>
+class basic_project
+{
+public:
+    static constexpr bool use_imgui  = true;
+    static constexpr bool use_opengl = false;
+
+    basic_project() {}
+    ~basic_project()
+    {
+        shutdown_imgui(imgui_tag());
+        if (m_display)
+            al_destroy_display(m_display);
+        if (m_event_queue)
+            al_destroy_event_queue(m_event_queue);
+        if (m_fps)
+            al_destroy_timer(m_fps);
+        if (m_font)
+            al_destroy_font(m_font);
+    }
+    basic_project(const basic_project&) = delete;
+    basic_project& operator=(const basic_project&) = delete;
+
+    void init(int display_flags, double fps_timer_sec = 1.0 / 24.0)
+    {
+        BEGIN_EXCEPTION_CATCH()
+        if (!al_init())
+            throw "couldn't init allegro!";
+        m_event_queue = al_create_event_queue();
+        if (!m_event_queue)
+            throw "couldn't start event queue!";
+        m_fps = al_create_timer(fps_timer_sec);
+        if (!m_fps)
+            throw "couldn't init timer!";
+        al_register_event_source(m_event_queue, al_get_timer_event_source(m_fps));
+        al_start_timer(m_fps);
+
+        if (!al_install_keyboard())
+            throw "couldn't install keyboard!";
+        al_register_event_source(m_event_queue, al_get_keyboard_event_source());
+        al_get_keyboard_state(&m_keyboard_state);
+        if (!al_install_mouse())
+            throw "could't install mouse!";
+        al_register_event_source(m_event_queue, al_get_mouse_event_source());
+        al_get_mouse_state(&m_mouse_state);
+        m_prev_mouse_state = m_mouse_state;
+
+        if (Derived::use_opengl)
+        {
+            display_flags |= ALLEGRO_OPENGL;
+            al_set_new_display_option(ALLEGRO_DEPTH_SIZE, 16, ALLEGRO_SUGGEST);
+        }
+        al_set_new_display_flags(display_flags);
+
+        if (!al_init_primitives_addon())
+            throw "couldn't init primitives addon!";
+        if (!al_init_image_addon())
+            throw "couldn't init image addon!";
+        al_init_font_addon();
+        al_init_ttf_addon();
+        m_font = al_load_ttf_font("basis33.ttf", 16, 0);
+        if (!m_font)
+            throw "system font is not initialized!";
+
+        init_imgui(imgui_tag());
+        m_init = true;
+        END_EXCEPTION_CATCH()
+    }
+
+    void create_display(int w, int h)
+    {
+        BEGIN_EXCEPTION_CATCH()
+        if (!m_init)
+            throw "Allegro project is not initialized!";
+        if (m_display)
+            throw "display is already created!";
+        m_display = al_create_display(w, h);
+        if (!m_display)
+            throw "couldn't create display!";
+        al_register_event_source(m_event_queue, al_get_display_event_source(m_display));
+        resize(w, h);
+        attach_imgui(imgui_tag());
+        END_EXCEPTION_CATCH()
+    }
+
+    void main_loop()
+    {
+        BEGIN_EXCEPTION_CATCH()
+        if (!m_init)
+            throw "Allegro project is not initialized!";
+        ALLEGRO_EVENT ev;
+        bool drawing_enabled = false;
+        while (true)
+        {
+            al_wait_for_event(m_event_queue, &ev);
+            process_imgui_event(ev, imgui_tag());
+            switch (ev.type)
+            {
+            case ALLEGRO_EVENT_TIMER:
+                if (m_display)
+                    drawing_enabled = true;
+                break;
+            case ALLEGRO_EVENT_DISPLAY_CLOSE:
+                return;
+            case ALLEGRO_EVENT_KEY_DOWN:
+                self().keyboard_event_handler(ev);
+                break;
+            case ALLEGRO_EVENT_DISPLAY_RESIZE:
+                al_acknowledge_resize(ev.display.source);
+                resize(ev.display.width, ev.display.height);
+                recreate_imgui_objects(imgui_tag());
+                break;
+            default:
+                break;
+            }
+
+            if (drawing_enabled && al_event_queue_is_empty(m_event_queue))
+            {
+                drawing_enabled = false;
+                draw_frame();
+            }
+        }
+        END_EXCEPTION_CATCH()
+    }
+
+    // one full frame: input, the render stages and the flip
+    void draw_frame()
+    {
+        m_frame_arena.begin_frame();
+        self().check_input_state();
+        imgui_new_frame(imgui_tag());
+        gl_pre_render(opengl_tag());
+        self().pre_render();
+        self().render();
+        gl_post_render(opengl_tag());
+        self().post_render();
+        imgui_end_frame(imgui_tag());
+        al_flip_display();
+    }
+
+    // default hooks, Derived hides the ones it needs
+    void display_resize(int, int) {}
+    void check_input_state()
+    {
+        m_prev_mouse_state = m_mouse_state;
+        m_prev_keyboard_state = m_keyboard_state;
+        al_get_mouse_state(&m_mouse_state);
+        al_get_keyboard_state(&m_keyboard_state);
+    }
+    void pre_render() {}
+    void render() {al_clear_to_color(al_map_rgb(0, 148, 204));}
+    void post_render() {}
+    void imgui_render() {}
+    void keyboard_event_handler(const ALLEGRO_EVENT& ev)
+    {
+        if (ev.keyboard.keycode == ALLEGRO_KEY_ESCAPE)
+            throw "ESC pressed!";
+    }
+
+    const ALLEGRO_FONT* get_system_font() const {return m_font;}
+    vv_mem::frame_arena& get_frame_arena() {return m_frame_arena;}
+
+protected:
+    // Derived is incomplete while this class is instantiated,
+    // the defaulted parameter delays the lookup until the first call
+    template <class D = Derived>
+    static std::integral_constant<bool, D::use_imgui> imgui_tag() {return {};}
+    template <class D = Derived>
+    static std::integral_constant<bool, D::use_opengl> opengl_tag() {return {};}
+
+    Derived& self() {return static_cast<Derived&>(*this);}
+
+    void resize(int w, int h)
+    {
+        m_w = w;
+        m_h = h;
+        gl_resize(opengl_tag());
+        self().display_resize(w, h);
+    }
+
+    // ImGui stages
+    void init_imgui(std::true_type)
+    {
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO();
+        io.Fonts->AddFontFromFileTTF("basis33.ttf", 16, nullptr, io.Fonts->GetGlyphRangesCyrillic());
+        ImGui::StyleColorsDark();
+    }
+    void attach_imgui(std::true_type) {ImGui_ImplAllegro5_Init(m_display);}
+    void shutdown_imgui(std::true_type)
+    {
+        if (!m_init)
+            return;
+        if (m_display)
+            ImGui_ImplAllegro5_Shutdown();
+        ImGui::DestroyContext();
+    }
+    void process_imgui_event(ALLEGRO_EVENT& ev, std::true_type) {ImGui_ImplAllegro5_ProcessEvent(&ev);}
+    void recreate_imgui_objects(std::true_type)
+    {
+        ImGui_ImplAllegro5_InvalidateDeviceObjects();
+        ImGui_ImplAllegro5_CreateDeviceObjects();
+    }
+    void imgui_new_frame(std::true_type)
+    {
+        ImGui_ImplAllegro5_NewFrame();
+        ImGui::NewFrame();
+    }
+    void imgui_end_frame(std::true_type)
+    {
+        self().imgui_render();
+        ImGui::Render();
+        ImGui_ImplAllegro5_RenderDrawData(ImGui::GetDrawData());
+    }
+    void init_imgui(std::false_type) {}
+    void attach_imgui(std::false_type) {}
+    void shutdown_imgui(std::false_type) {}
+    void process_imgui_event(ALLEGRO_EVENT&, std::false_type) {}
+    void recreate_imgui_objects(std::false_type) {}
+    void imgui_new_frame(std::false_type) {}
+    void imgui_end_frame(std::false_type) {}
+
+    // OpenGL stages: 3d state around render(), back to Allegro's 2d state after it
+    void gl_resize(std::true_type) {glViewport(0, 0, m_w, m_h);}
+    void gl_pre_render(std::true_type)
+    {
+        glPushMatrix(); // save 2d world matrix
+        glEnable(GL_DEPTH_TEST);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+    void gl_post_render(std::true_type)
+    {
+        glDisable(GL_DEPTH_TEST);
+        glPopMatrix(); // come back to 2d allegro world
+    }
+    void gl_resize(std::false_type) {}
+    void gl_pre_render(std::false_type) {}
+    void gl_post_render(std::false_type) {}
+
+    ALLEGRO_KEYBOARD_STATE m_keyboard_state;
+    ALLEGRO_KEYBOARD_STATE m_prev_keyboard_state;
+    ALLEGRO_MOUSE_STATE    m_mouse_state;
+    ALLEGRO_MOUSE_STATE    m_prev_mouse_state;
+    bool                   m_init        = false;
+    ALLEGRO_EVENT_QUEUE*   m_event_queue = nullptr;
+    ALLEGRO_DISPLAY*       m_display     = nullptr;
+    ALLEGRO_TIMER*         m_fps         = nullptr;
+    ALLEGRO_FONT*          m_font        = nullptr;
+    int                    m_w           = 0;
+    int                    m_h           = 0;
+    vv_mem::frame_arena    m_frame_arena;
+};
+#endif
@@ -9,8 +9,29 @@ int main(int argc, char **argv)
     allegro_project::allegro_check_version();
     allegro_opengl_project algl;
     algl.init(ALLEGRO_OPENGL | ALLEGRO_RESIZABLE);
+    // scene MSAA comes from the dynamic resolution target, the window stays single-sampled
+    algl.get_dynamic_resolution().set_enabled(true);
     algl.create_display(800, 600);
+    algl.set_trace_file("trace.json");
+#ifdef VV_TRACK_ALLOCATIONS
+    // after warming up the frame loop must not touch the heap
+    algl.get_allocation_monitor().set_steady_state_frame(240);
+#endif
+    if (argc > 1)
+    {
+        const std::string path = argv[1];
+        if (path.size() > 7 && path.compare(path.size() - 7, 7, ".vvmesh") == 0)
+            algl.open_mesh(path);
+        else
+            algl.open_point_cloud(path);
+    }
+    // further arguments are images, handed to the scene objects in turn
+    std::vector<uint32_t> textures;
+    for (int i = 2; i < argc; i++)
+        textures.push_back(algl.get_textures().load(argv[i]));
+    for (std::size_t i = 0; !textures.empty() && i < algl.get_scene().size(); i++)
+        algl.get_scene().set_texture(i, textures[i % textures.size()]);
     algl.main_loop();
-    return 0;
+    return algl.get_allocation_monitor().violations() > 0 ? 1 : 0;
 }
 
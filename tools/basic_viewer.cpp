@@ -0,0 +1,91 @@
+// Smallest users of basic_project, one per configuration, so both sides of
+// its compile-time switches get built:
+//   ./basic_viewer        Allegro 2d drawing, no ImGui compiled in
+//   ./basic_viewer --gl   OpenGL 3d state around render() and an ImGui window
+// Esc quits.
+#include "basic_project.h"
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // a box bouncing inside the window, the frame count in the corner
+    class viewer_2d : public basic_project<viewer_2d>
+    {
+    public:
+        static constexpr bool use_imgui = false;
+
+        void render()
+        {
+            al_clear_to_color(al_map_rgb(0, 148, 204));
+            m_frame++;
+            const float t = m_frame / 60.f;
+            const float x = (0.5f + 0.4f * std::sin(t)) * m_w;
+            const float y = (0.5f + 0.4f * std::cos(1.3f * t)) * m_h;
+            al_draw_filled_rectangle(x - 20, y - 20, x + 20, y + 20, al_map_rgb(230, 40, 40));
+            al_draw_textf(get_system_font(), al_map_rgb(255, 255, 255), 10, 10, ALLEGRO_ALIGN_LEFT,
+                          "frame %u", m_frame);
+        }
+
+    protected:
+        unsigned m_frame = 0;
+    };
+
+    // a turning triangle in the fixed function pipeline, its speed in ImGui
+    class viewer_gl : public basic_project<viewer_gl>
+    {
+    public:
+        static constexpr bool use_opengl = true;
+
+        void render()
+        {
+            m_angle += m_speed;
+            glMatrixMode(GL_PROJECTION);
+            glPushMatrix();
+            glLoadIdentity();
+            glMatrixMode(GL_MODELVIEW);
+            glPushMatrix();
+            glLoadIdentity();
+            glRotatef(m_angle, 0, 0, 1);
+            glBegin(GL_TRIANGLES);
+            glColor3f(1, 0, 0);
+            glVertex3f(-0.6f, -0.5f, 0);
+            glColor3f(0, 1, 0);
+            glVertex3f(0.6f, -0.5f, 0);
+            glColor3f(0, 0, 1);
+            glVertex3f(0, 0.6f, 0);
+            glEnd();
+            glPopMatrix();
+            glMatrixMode(GL_PROJECTION);
+            glPopMatrix();
+            glMatrixMode(GL_MODELVIEW);
+        }
+
+        void imgui_render()
+        {
+            ImGui::Begin("basic_viewer");
+            ImGui::SliderFloat("degrees per frame", &m_speed, 0.f, 10.f);
+            ImGui::End();
+        }
+
+    protected:
+        float m_angle = 0;
+        float m_speed = 1;
+    };
+
+    template <class Viewer>
+    int run()
+    {
+        Viewer viewer;
+        viewer.init(ALLEGRO_WINDOWED | ALLEGRO_RESIZABLE, 1.0 / 60.0);
+        viewer.create_display(640, 480);
+        viewer.main_loop();
+        return 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const bool gl = argc > 1 && std::strcmp(argv[1], "--gl") == 0;
+    return gl ? run<viewer_gl>() : run<viewer_2d>();
+}
@@ -0,0 +1,424 @@
+// Renders .vvmesh models from a set of camera orientations into png files,
+// for thumbnails and review sheets. The work is split into contiguous blocks
+// of images over several processes, each with its own GL context, and the
+// throughput is reported in images per second. On Linux without a desktop e.g.
+//   xvfb-run -s "-screen 0 1024x768x24" ./batch_render --jobs 8 --turntable 12 a.vvmesh b.vvmesh
+// Exit code: 0 all images written, 1 some failed, 2 couldn't run.
+#include "allegro_project.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace
+{
+    struct orientation
+    {
+        enum kind_t {orbit, euler, quat} m_kind = orbit;
+        double m_a[4] = {0, 0, 0, 0};  // degrees for orbit (pitch, yaw) and euler (xa, ya, za), w x y z for quat
+    };
+
+    struct options
+    {
+        std::vector<std::string> m_models;
+        std::vector<orientation> m_orientations;
+        std::string m_out = ".";
+        int         m_w = 256;
+        int         m_h = 256;
+        double      m_distance = 4.6;  // the fitted model spans [-1, 1], its bounding sphere fills a 45 degree view
+        int         m_turntable = 8;
+        double      m_pitch = 20;
+        int         m_jobs = 0;        // 0: one per hardware thread
+        int         m_worker = -1;     // set for the processes the first one starts
+        int         m_workers = 1;
+    };
+
+    const double deg = M_PI / 180;
+
+    std::string file_stem(const std::string& path)
+    {
+        const std::size_t slash = path.find_last_of("/\\");
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        const std::size_t dot = name.find_last_of('.');
+        return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+    }
+
+    // one per line: "orbit pitch yaw", "euler xa ya za" or "quat w x y z", # starts a comment
+    bool read_orientations(const std::string& path, std::vector<orientation>& out)
+    {
+        std::ifstream in(path.c_str());
+        if (!in)
+            return false;
+        std::string line;
+        int number = 0;
+        while (std::getline(in, line))
+        {
+            number++;
+            std::istringstream fields(line);
+            std::string kind;
+            if (!(fields >> kind) || kind[0] == '#')
+                continue;
+            orientation o;
+            int count = 0;
+            if (kind == "orbit")
+                o.m_kind = orientation::orbit, count = 2;
+            else if (kind == "euler")
+                o.m_kind = orientation::euler, count = 3;
+            else if (kind == "quat")
+                o.m_kind = orientation::quat, count = 4;
+            for (int i = 0; i < count; i++)
+                if (!(fields >> o.m_a[i]))
+                    count = 0;
+            if (!count)
+            {
+                std::cout << path << ":" << number << ": expected orbit, euler or quat and its angles" << std::endl;
+                return false;
+            }
+            out.push_back(o);
+        }
+        return true;
+    }
+
+    bool read_list(const std::string& path, std::vector<std::string>& out)
+    {
+        std::ifstream in(path.c_str());
+        if (!in)
+            return false;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty() && line[0] != '#')
+                out.push_back(line);
+        }
+        return true;
+    }
+
+    std::string shell_quote(const std::string& s)
+    {
+#ifdef _WIN32
+        return "\"" + s + "\"";
+#else
+        std::string q = "'";
+        for (char c : s)
+            q += c == '\'' ? std::string("'\\''") : std::string(1, c);
+        return q + "'";
+#endif
+    }
+
+    class batch_project : public allegro_opengl_project
+    {
+    public:
+        bool has_display() const {return m_display != nullptr;}
+
+        void setup(const options& opt)
+        {
+            m_options = &opt;
+            draw_state_flags::m_compas = false;
+            draw_state_flags::m_coord_sys = false;
+            draw_state_flags::m_occlusion = false;
+            draw_state_flags::m_debug_view = debug_view::none;
+            set_view_layout(view_layout::single);
+            set_clear_color(al_map_rgb(64, 64, 64));
+            m_scene.clear();
+            m_scene.add_box(0, 0, 0, 1);
+        }
+
+        // images [first, last) of the model major order, returns how many were queued
+        unsigned render(std::size_t first, std::size_t last, unsigned& failed)
+        {
+            const options& opt = *m_options;
+            const std::size_t per_model = opt.m_orientations.size();
+            std::size_t open = std::size_t(-1);
+            bool usable = false;
+            unsigned queued = 0;
+            const unsigned failed_saves = m_capture.frames_failed();
+            for (std::size_t u = first; u < last; u++)
+            {
+                const std::size_t model = u / per_model, k = u % per_model;
+                if (model != open)
+                {
+                    open = model;
+                    usable = open_mesh(opt.m_models[model]);
+                }
+                if (!usable)
+                {
+                    failed++;
+                    continue;
+                }
+                char suffix[32];
+                std::snprintf(suffix, sizeof(suffix), "_%03u.png", static_cast<unsigned>(k));
+                m_orientation = &opt.m_orientations[k];
+                m_capture.screenshot(opt.m_out + "/" + file_stem(opt.m_models[model]) + suffix);
+                draw_frame();
+                queued++;
+            }
+            // the last read backs and png writes finish here
+            m_capture.flush();
+            failed += m_capture.frames_failed() - failed_saves;
+            return queued;
+        }
+
+        void check_input_state() override
+        {
+            if (!m_orientation)
+                return;
+            const orientation& o = *m_orientation;
+            for (view& v : m_views)
+            {
+                if (o.m_kind == orientation::orbit)
+                {
+                    set_orbit_camera(v, m_options->m_distance, o.m_a[0] * deg, o.m_a[1] * deg);
+                    continue;
+                }
+                v.m_camera.reset();
+                v.m_camera.translate(0, 0, -m_options->m_distance);
+                if (o.m_kind == orientation::euler)
+                    v.m_camera.set_rotation(o.m_a[0] * deg, o.m_a[1] * deg, o.m_a[2] * deg);
+                else
+                    v.m_camera.set_rotation(o.m_a[0], o.m_a[1], o.m_a[2], o.m_a[3]);
+            }
+        }
+
+        // nothing but the model goes into the images
+        void draw_help_message() override {}
+        void draw_debug_info() override {}
+
+    protected:
+        const options*     m_options = nullptr;
+        const orientation* m_orientation = nullptr;
+    };
+
+    struct worker_result
+    {
+        unsigned m_images = 0;
+        unsigned m_failed = 0;
+        double   m_seconds = 0;
+        bool     m_finished = false;
+    };
+
+    // renders this process's share in its own GL context
+    int run_worker(const options& opt, worker_result& r)
+    {
+        const std::size_t total = opt.m_models.size() * opt.m_orientations.size();
+        const std::size_t first = total * opt.m_worker / opt.m_workers;
+        const std::size_t last = total * (opt.m_worker + 1) / opt.m_workers;
+
+        batch_project project;
+        project.set_trace_file("");
+        project.init(ALLEGRO_OPENGL, false);
+        al_set_new_display_option(ALLEGRO_VSYNC, 2, ALLEGRO_SUGGEST);  // never wait for the monitor
+        project.create_display(opt.m_w, opt.m_h);
+        if (!project.has_display())
+        {
+            std::cout << "couldn't create a " << opt.m_w << "x" << opt.m_h << " display" << std::endl;
+            return 2;
+        }
+        project.setup(opt);
+        const double start = al_get_time();
+        r.m_images = project.render(first, last, r.m_failed);
+        r.m_seconds = al_get_time() - start;
+        r.m_finished = true;
+        return r.m_failed ? 1 : 0;
+    }
+
+    // starts the workers as processes of this executable and relays their output
+    int run_parallel(const options& opt, const std::vector<std::string>& args)
+    {
+        std::string base;
+        for (const std::string& a : args)
+            base += shell_quote(a) + " ";
+
+        std::vector<worker_result> results(opt.m_workers);
+        std::mutex output;
+        std::vector<std::thread> threads;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < opt.m_workers; i++)
+            threads.emplace_back([&, i]()
+            {
+                const std::string command = base + "--worker " + std::to_string(i) + " --workers " +
+                                            std::to_string(opt.m_workers);
+                FILE* pipe = popen(command.c_str(), "r");
+                if (!pipe)
+                {
+                    std::lock_guard<std::mutex> lock(output);
+                    std::cout << "[" << i << "] couldn't start " << command << std::endl;
+                    return;
+                }
+                char line[1024];
+                while (std::fgets(line, sizeof(line), pipe))
+                {
+                    worker_result r;
+                    if (std::sscanf(line, "done %u %u %lf", &r.m_images, &r.m_failed, &r.m_seconds) == 3)
+                    {
+                        r.m_finished = true;
+                        results[i] = r;
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lock(output);
+                    std::cout << "[" << i << "] " << line << std::flush;
+                }
+                pclose(pipe);
+            });
+        for (std::thread& t : threads)
+            t.join();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        unsigned images = 0, failed = 0, lost = 0;
+        for (int i = 0; i < opt.m_workers; i++)
+        {
+            const worker_result& r = results[i];
+            if (!r.m_finished)
+            {
+                lost++;
+                continue;
+            }
+            images += r.m_images;
+            failed += r.m_failed;
+            std::printf("worker %d: %u images in %.2f s, %.1f images/s\n", i, r.m_images, r.m_seconds,
+                        r.m_seconds > 0 ? r.m_images / r.m_seconds : 0.0);
+        }
+        // the wall clock includes starting the processes and opening the displays
+        std::printf("%u images in %.2f s with %d processes, %.1f images/s\n", images, seconds, opt.m_workers,
+                    seconds > 0 ? images / seconds : 0.0);
+        if (failed || lost)
+            std::printf("%u images failed, %u workers didn't finish\n", failed, lost);
+        return failed || lost ? 1 : 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    options opt;
+    std::string orientations_path;
+    // what the workers are started with, --jobs left out
+    std::vector<std::string> args(1, argv[0]);
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; i++)
+    {
+        const int at = i;
+        const std::string arg = argv[i];
+        const bool value = i + 1 < argc;
+        if (arg == "--jobs" && value)
+        {
+            opt.m_jobs = std::max(1, std::atoi(argv[++i]));
+            continue;
+        }
+        if (arg == "--worker" && value)
+            opt.m_worker = std::atoi(argv[++i]);
+        else if (arg == "--workers" && value)
+            opt.m_workers = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--out" && value)
+            opt.m_out = argv[++i];
+        else if (arg == "--size" && value)
+            usage = std::sscanf(argv[++i], "%dx%d", &opt.m_w, &opt.m_h) != 2 || opt.m_w <= 0 || opt.m_h <= 0;
+        else if (arg == "--distance" && value)
+            opt.m_distance = std::atof(argv[++i]);
+        else if (arg == "--turntable" && value)
+            opt.m_turntable = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--pitch" && value)
+            opt.m_pitch = std::atof(argv[++i]);
+        else if (arg == "--orientations" && value)
+            orientations_path = argv[++i];
+        else if (arg == "--list" && value)
+        {
+            if (!read_list(argv[++i], opt.m_models))
+            {
+                std::cout << "couldn't read " << argv[i] << std::endl;
+                return 2;
+            }
+        }
+        else if (!arg.empty() && arg[0] != '-')
+            opt.m_models.push_back(arg);
+        else
+            usage = true;
+        args.insert(args.end(), argv + at, argv + i + 1);
+    }
+    if (usage || opt.m_models.empty())
+    {
+        std::cout << "usage: batch_render [--out dir] [--size WxH] [--jobs n] [--turntable n] [--pitch deg]\n"
+                     "                    [--orientations file] [--distance d] [--list file] model.vvmesh ...\n"
+                     "orientations file lines: orbit pitch yaw | euler xa ya za | quat w x y z, angles in degrees"
+                  << std::endl;
+        return 2;
+    }
+    if (!orientations_path.empty())
+    {
+        if (!read_orientations(orientations_path, opt.m_orientations))
+            return 2;
+    }
+    else
+        for (int k = 0; k < opt.m_turntable; k++)
+        {
+            orientation o;
+            o.m_a[0] = opt.m_pitch;
+            o.m_a[1] = 360.0 * k / opt.m_turntable;
+            opt.m_orientations.push_back(o);
+        }
+    if (opt.m_orientations.empty())
+    {
+        std::cout << "no orientations" << std::endl;
+        return 2;
+    }
+
+    // images are named after the model, two models with the same file name would overwrite each other
+    std::map<std::string, std::string> stems;
+    for (const std::string& model : opt.m_models)
+    {
+        auto it = stems.emplace(file_stem(model), model);
+        if (!it.second)
+        {
+            std::cout << it.first->second << " and " << model << " would both write " << it.first->first
+                      << "_NNN.png" << std::endl;
+            return 2;
+        }
+    }
+
+    worker_result r;
+    if (opt.m_worker >= 0)
+    {
+        if (opt.m_worker >= opt.m_workers)
+            return 2;
+        const int result = run_worker(opt, r);
+        if (r.m_finished)
+            std::cout << "done " << r.m_images << " " << r.m_failed << " " << r.m_seconds << std::endl;
+        return result;
+    }
+
+    // once here, the workers only write into it
+    if (!al_init() || !al_make_directory(opt.m_out.c_str()))
+    {
+        std::cout << "couldn't create " << opt.m_out << std::endl;
+        return 2;
+    }
+    const std::size_t total = opt.m_models.size() * opt.m_orientations.size();
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    opt.m_workers = static_cast<int>(std::min<std::size_t>(opt.m_jobs ? opt.m_jobs : cores, total));
+    if (opt.m_workers == 1)
+    {
+        // in this process, no second display to open
+        opt.m_worker = 0;
+        const int result = run_worker(opt, r);
+        if (r.m_finished)
+            std::printf("%u images in %.2f s, %.1f images/s\n", r.m_images, r.m_seconds,
+                        r.m_seconds > 0 ? r.m_images / r.m_seconds : 0.0);
+        if (r.m_failed)
+            std::printf("%u images failed\n", r.m_failed);
+        return result;
+    }
+    return run_parallel(opt, args);
+}
@@ -0,0 +1,518 @@
+// Converts OBJ, PLY (ascii or binary little endian) and STL (ascii or binary)
+// triangle meshes into the binary mesh format read by
+// allegro_opengl_project::open_mesh(). Polygons are triangulated as fans,
+// missing normals are computed smooth from the faces around every position.
+// Triangles and vertices are reordered for the vertex cache and overdraw
+// unless --no-optimize is given. The wireframe keeps every edge unless
+// --crease is given, then edges between faces closer than that many degrees
+// are left out.
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vv_mesh_file.h"
+#include "vv_mesh_optimize.h"
+
+namespace
+{
+    // triangle corners as read, turned into an indexed mesh at the end
+    struct triangle_soup
+    {
+        std::vector<float> m_positions;  // xyz per corner
+        std::vector<float> m_normals;    // xyz per corner, empty if the file has none
+
+        void add_corner(const float* p, const float* n)
+        {
+            m_positions.insert(m_positions.end(), p, p + 3);
+            if (n)
+                m_normals.insert(m_normals.end(), n, n + 3);
+        }
+    };
+
+    struct corner_hash
+    {
+        std::size_t operator()(const std::vector<uint32_t>& k) const
+        {
+            std::size_t h = 0;
+            for (uint32_t v : k)
+                h = h * 16777619u ^ v;
+            return h;
+        }
+    };
+
+    // merges corners with bit-equal attributes, key_floats of them per corner
+    std::vector<uint32_t> weld(const float* data, std::size_t corners, std::size_t key_floats, std::vector<uint32_t>& first)
+    {
+        std::unordered_map<std::vector<uint32_t>, uint32_t, corner_hash> ids;
+        ids.reserve(corners / 4);
+        std::vector<uint32_t> id(corners);
+        std::vector<uint32_t> key(key_floats);
+        for (std::size_t c = 0; c < corners; c++)
+        {
+            std::memcpy(key.data(), data + c * key_floats, key_floats * sizeof(float));
+            auto it = ids.emplace(key, static_cast<uint32_t>(first.size()));
+            if (it.second)
+                first.push_back(static_cast<uint32_t>(c));
+            id[c] = it.first->second;
+        }
+        return id;
+    }
+
+    vv_mesh::mesh build_mesh(triangle_soup& soup, bool smooth)
+    {
+        const std::size_t corners = soup.m_positions.size() / 3;
+        if (smooth || soup.m_normals.size() != soup.m_positions.size())
+        {
+            // area weighted face normals summed per position
+            std::vector<uint32_t> unique;
+            const std::vector<uint32_t> position = weld(soup.m_positions.data(), corners, 3, unique);
+            std::vector<float> sum(unique.size() * 3, 0.f);
+            for (std::size_t t = 0; t < corners / 3; t++)
+            {
+                const float* p = &soup.m_positions[9 * t];
+                const float a[3] = {p[3] - p[0], p[4] - p[1], p[5] - p[2]};
+                const float b[3] = {p[6] - p[0], p[7] - p[1], p[8] - p[2]};
+                const float n[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+                for (int c = 0; c < 3; c++)
+                    for (int k = 0; k < 3; k++)
+                        sum[3 * position[3 * t + c] + k] += n[k];
+            }
+            soup.m_normals.resize(soup.m_positions.size());
+            for (std::size_t c = 0; c < corners; c++)
+            {
+                const float* n = &sum[3 * position[c]];
+                const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                for (int k = 0; k < 3; k++)
+                    soup.m_normals[3 * c + k] = len > 0 ? n[k] / len : (k == 1 ? 1.f : 0.f);
+            }
+        }
+
+        std::vector<float> attributes(corners * 6);
+        for (std::size_t c = 0; c < corners; c++)
+        {
+            std::memcpy(&attributes[6 * c], &soup.m_positions[3 * c], 3 * sizeof(float));
+            std::memcpy(&attributes[6 * c + 3], &soup.m_normals[3 * c], 3 * sizeof(float));
+        }
+        std::vector<uint32_t> unique;
+        vv_mesh::mesh m;
+        m.m_indices = weld(attributes.data(), corners, 6, unique);
+        m.m_positions.reserve(unique.size() * 3);
+        m.m_normals.reserve(unique.size() * 3);
+        for (uint32_t c : unique)
+        {
+            m.m_positions.insert(m.m_positions.end(), &attributes[6 * c], &attributes[6 * c] + 3);
+            m.m_normals.insert(m.m_normals.end(), &attributes[6 * c + 3], &attributes[6 * c] + 6);
+        }
+        return m;
+    }
+
+    // OBJ index: 1-based, negative counts back from the last element read
+    bool obj_index(const char* s, std::size_t count, long& index)
+    {
+        char* end = nullptr;
+        const long i = std::strtol(s, &end, 10);
+        if (end == s || i == 0)
+            return false;
+        index = i > 0 ? i - 1 : static_cast<long>(count) + i;
+        return index >= 0 && index < static_cast<long>(count);
+    }
+
+    bool read_obj(FILE* f, triangle_soup& soup, std::string& error)
+    {
+        std::vector<float> positions, normals;
+        std::vector<long> face_p, face_n;
+        bool all_normals = true;
+        char line[4096];
+        while (std::fgets(line, sizeof(line), f))
+        {
+            float x, y, z;
+            if (line[0] == 'v' && line[1] == ' ' && std::sscanf(line + 2, "%f %f %f", &x, &y, &z) == 3)
+            {
+                const float p[3] = {x, y, z};
+                positions.insert(positions.end(), p, p + 3);
+            }
+            else if (line[0] == 'v' && line[1] == 'n' && std::sscanf(line + 2, "%f %f %f", &x, &y, &z) == 3)
+            {
+                const float n[3] = {x, y, z};
+                normals.insert(normals.end(), n, n + 3);
+            }
+            else if (line[0] == 'f' && line[1] == ' ')
+            {
+                // v, v/vt, v//vn or v/vt/vn per corner
+                face_p.clear();
+                face_n.clear();
+                for (char* token = std::strtok(line + 2, " \t\r\n"); token; token = std::strtok(nullptr, " \t\r\n"))
+                {
+                    long p = 0, n = -1;
+                    if (!obj_index(token, positions.size() / 3, p))
+                    {
+                        error = std::string("bad face index ") + token;
+                        return false;
+                    }
+                    const char* slash = std::strchr(token, '/');
+                    slash = slash ? std::strchr(slash + 1, '/') : nullptr;
+                    if (!slash || !obj_index(slash + 1, normals.size() / 3, n))
+                        n = -1;
+                    face_p.push_back(p);
+                    face_n.push_back(n);
+                }
+                for (std::size_t c = 2; c < face_p.size(); c++)
+                {
+                    const std::size_t fan[3] = {0, c - 1, c};
+                    for (std::size_t k : fan)
+                    {
+                        all_normals = all_normals && face_n[k] >= 0;
+                        soup.add_corner(&positions[3 * face_p[k]], face_n[k] >= 0 ? &normals[3 * face_n[k]] : nullptr);
+                    }
+                }
+            }
+        }
+        if (!all_normals)
+            soup.m_normals.clear();
+        return true;
+    }
+
+    struct ply_property
+    {
+        std::string m_name;
+        std::string m_type;
+        std::string m_count_type;  // non-empty for lists
+    };
+
+    struct ply_element
+    {
+        std::string               m_name;
+        std::size_t               m_count = 0;
+        std::vector<ply_property> m_properties;
+    };
+
+    std::size_t ply_type_size(const std::string& t)
+    {
+        if (t == "char" || t == "uchar" || t == "int8" || t == "uint8")
+            return 1;
+        if (t == "short" || t == "ushort" || t == "int16" || t == "uint16")
+            return 2;
+        if (t == "int" || t == "uint" || t == "float" || t == "int32" || t == "uint32" || t == "float32")
+            return 4;
+        if (t == "double" || t == "float64")
+            return 8;
+        return 0;
+    }
+
+    bool ply_read_binary(FILE* f, const std::string& t, double& value)
+    {
+        unsigned char b[8];
+        const std::size_t size = ply_type_size(t);
+        if (size == 0 || std::fread(b, size, 1, f) != 1)
+            return false;
+        // little endian on disk and, as everywhere else in this code, in memory
+        if (t == "char" || t == "int8")          {int8_t v;   std::memcpy(&v, b, 1); value = v;}
+        else if (t == "uchar" || t == "uint8")   {uint8_t v;  std::memcpy(&v, b, 1); value = v;}
+        else if (t == "short" || t == "int16")   {int16_t v;  std::memcpy(&v, b, 2); value = v;}
+        else if (t == "ushort" || t == "uint16") {uint16_t v; std::memcpy(&v, b, 2); value = v;}
+        else if (t == "int" || t == "int32")     {int32_t v;  std::memcpy(&v, b, 4); value = v;}
+        else if (t == "uint" || t == "uint32")   {uint32_t v; std::memcpy(&v, b, 4); value = v;}
+        else if (t == "float" || t == "float32") {float v;    std::memcpy(&v, b, 4); value = v;}
+        else                                     {double v;   std::memcpy(&v, b, 8); value = v;}
+        return true;
+    }
+
+    bool read_ply(FILE* f, triangle_soup& soup, std::string& error)
+    {
+        char line[1024];
+        std::vector<ply_element> elements;
+        bool binary = false;
+        while (std::fgets(line, sizeof(line), f))
+        {
+            char a[64] = {}, b[64] = {}, c[64] = {}, d[64] = {};
+            const int n = std::sscanf(line, "%63s %63s %63s %63s", a, b, c, d);
+            const std::string word = n > 0 ? a : "";
+            if (word == "end_header")
+                break;
+            if (word == "format")
+            {
+                binary = std::strcmp(b, "binary_little_endian") == 0;
+                if (!binary && std::strcmp(b, "ascii") != 0)
+                {
+                    error = std::string("unsupported PLY format ") + b;
+                    return false;
+                }
+            }
+            else if (word == "element" && n >= 3)
+            {
+                elements.push_back(ply_element());
+                elements.back().m_name = b;
+                elements.back().m_count = std::strtoul(c, nullptr, 10);
+            }
+            else if (word == "property" && !elements.empty())
+            {
+                ply_property p;
+                if (std::strcmp(b, "list") == 0 && n == 4)
+                {
+                    p.m_count_type = c;
+                    p.m_type = d;
+                    // the list name follows the item type
+                    char name[64] = {};
+                    std::sscanf(line, "%*s %*s %*s %*s %63s", name);
+                    p.m_name = name;
+                }
+                else
+                {
+                    p.m_type = b;
+                    p.m_name = c;
+                }
+                if (ply_type_size(p.m_type) == 0 || (!p.m_count_type.empty() && ply_type_size(p.m_count_type) == 0))
+                {
+                    error = "unknown PLY property type in: " + std::string(line);
+                    return false;
+                }
+                elements.back().m_properties.push_back(p);
+            }
+        }
+
+        // values are read one at a time the same way for both encodings
+        auto next_value = [f, binary](const std::string& type, double& value)
+        {
+            return binary ? ply_read_binary(f, type, value) : std::fscanf(f, "%lf", &value) == 1;
+        };
+
+        std::vector<float> positions, normals;
+        bool have_normals = false;
+        std::vector<double> list;
+        for (const ply_element& e : elements)
+        {
+            const bool vertex = e.m_name == "vertex";
+            const bool face = e.m_name == "face";
+            int slot[6] = {-1, -1, -1, -1, -1, -1};  // x y z nx ny nz
+            static const char* names[6] = {"x", "y", "z", "nx", "ny", "nz"};
+            for (std::size_t p = 0; p < e.m_properties.size(); p++)
+                for (int k = 0; k < 6; k++)
+                    if (e.m_properties[p].m_name == names[k])
+                        slot[k] = static_cast<int>(p);
+            if (vertex)
+            {
+                if (slot[0] < 0 || slot[1] < 0 || slot[2] < 0)
+                {
+                    error = "PLY vertices without x, y, z";
+                    return false;
+                }
+                have_normals = slot[3] >= 0 && slot[4] >= 0 && slot[5] >= 0;
+            }
+
+            for (std::size_t i = 0; i < e.m_count; i++)
+            {
+                float v[6] = {0, 0, 0, 0, 0, 0};
+                for (std::size_t p = 0; p < e.m_properties.size(); p++)
+                {
+                    const ply_property& prop = e.m_properties[p];
+                    double value = 0;
+                    if (prop.m_count_type.empty())
+                    {
+                        if (!next_value(prop.m_type, value))
+                        {
+                            error = "unexpected end of PLY " + e.m_name + " data";
+                            return false;
+                        }
+                        for (int k = 0; k < 6; k++)
+                            if (slot[k] == static_cast<int>(p))
+                                v[k] = static_cast<float>(value);
+                        continue;
+                    }
+                    double count = 0;
+                    bool ok = next_value(prop.m_count_type, count);
+                    list.resize(ok ? static_cast<std::size_t>(count) : 0);
+                    for (double& item : list)
+                        ok = ok && next_value(prop.m_type, item);
+                    if (!ok)
+                    {
+                        error = "unexpected end of PLY " + e.m_name + " data";
+                        return false;
+                    }
+                    if (!face || (prop.m_name != "vertex_indices" && prop.m_name != "vertex_index"))
+                        continue;
+                    const std::size_t vertex_count = positions.size() / 3;
+                    for (std::size_t c = 2; c < list.size(); c++)
+                    {
+                        const std::size_t fan[3] = {0, c - 1, c};
+                        for (std::size_t k : fan)
+                        {
+                            const std::size_t index = static_cast<std::size_t>(list[k]);
+                            if (list[k] < 0 || index >= vertex_count)
+                            {
+                                error = "PLY face index out of range";
+                                return false;
+                            }
+                            soup.add_corner(&positions[3 * index], have_normals ? &normals[3 * index] : nullptr);
+                        }
+                    }
+                }
+                if (vertex)
+                {
+                    positions.insert(positions.end(), v, v + 3);
+                    normals.insert(normals.end(), v + 3, v + 6);
+                }
+            }
+        }
+        return true;
+    }
+
+    bool read_stl(FILE* f, triangle_soup& soup, std::string& error)
+    {
+        // binary: 80 byte header, triangle count, 50 bytes per triangle
+        std::fseek(f, 0, SEEK_END);
+        const long size = std::ftell(f);
+        std::fseek(f, 0, SEEK_SET);
+        unsigned char head[84];
+        uint32_t count = 0;
+        if (size >= 84 && std::fread(head, 84, 1, f) == 1)
+            std::memcpy(&count, head + 80, 4);
+        // a zero facet normal means "compute it", then smooth normals are computed for all
+        bool missing_normals = false;
+        if (size >= 84 && static_cast<uint64_t>(size) == 84 + uint64_t(count) * 50)
+        {
+            unsigned char record[50];
+            for (uint32_t t = 0; t < count; t++)
+            {
+                if (std::fread(record, 50, 1, f) != 1)
+                {
+                    error = "unexpected end of STL data";
+                    return false;
+                }
+                float v[12];
+                std::memcpy(v, record, sizeof(v));
+                missing_normals = missing_normals || (v[0] == 0 && v[1] == 0 && v[2] == 0);
+                for (int c = 0; c < 3; c++)
+                    soup.add_corner(v + 3 + 3 * c, v);
+            }
+            if (missing_normals)
+                soup.m_normals.clear();
+            return true;
+        }
+
+        std::fseek(f, 0, SEEK_SET);
+        char line[1024];
+        float normal[3] = {0, 0, 0};
+        while (std::fgets(line, sizeof(line), f))
+        {
+            float x, y, z;
+            if (std::sscanf(line, " facet normal %f %f %f", &x, &y, &z) == 3)
+            {
+                normal[0] = x;
+                normal[1] = y;
+                normal[2] = z;
+                missing_normals = missing_normals || (x == 0 && y == 0 && z == 0);
+            }
+            else if (std::sscanf(line, " vertex %f %f %f", &x, &y, &z) == 3)
+            {
+                const float p[3] = {x, y, z};
+                soup.add_corner(p, normal);
+            }
+        }
+        if (soup.m_positions.size() % 9 != 0)
+        {
+            error = "STL facet with other than three vertices";
+            return false;
+        }
+        if (missing_normals)
+            soup.m_normals.clear();
+        return true;
+    }
+
+    bool ends_with(const std::string& s, const char* suffix)
+    {
+        const std::size_t n = std::strlen(suffix);
+        if (s.size() < n)
+            return false;
+        for (std::size_t i = 0; i < n; i++)
+            if (std::tolower(static_cast<unsigned char>(s[s.size() - n + i])) != suffix[i])
+                return false;
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> paths;
+    vv_mesh::write_options options;
+    bool smooth = false;
+    bool optimize = true;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--lods" && i + 1 < argc)
+            options.m_max_lods = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--compress")
+            options.m_compress = true;
+        else if (arg == "--smooth")
+            smooth = true;
+        else if (arg == "--crease" && i + 1 < argc)
+            options.m_crease_cos = std::cos(std::strtod(argv[++i], nullptr) * M_PI / 180);
+        else if (arg == "--no-optimize")
+            optimize = false;
+        else
+            paths.push_back(arg);
+    }
+    if (paths.size() != 2)
+    {
+        std::cout << "usage: mesh_convert input.(obj|ply|stl) output.vvmesh [--lods n] [--compress] [--smooth]"
+                     " [--crease degrees] [--no-optimize]" << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    FILE* in = std::fopen(paths[0].c_str(), "rb");
+    if (!in)
+    {
+        std::cout << "couldn't open " << paths[0] << std::endl;
+        return 1;
+    }
+    triangle_soup soup;
+    std::string error;
+    bool ok = false;
+    if (ends_with(paths[0], ".obj"))
+        ok = read_obj(in, soup, error);
+    else if (ends_with(paths[0], ".ply"))
+        ok = read_ply(in, soup, error);
+    else if (ends_with(paths[0], ".stl"))
+        ok = read_stl(in, soup, error);
+    else
+        error = "unknown input format, expected .obj, .ply or .stl";
+    std::fclose(in);
+    if (!ok)
+    {
+        std::cout << "error: " << error << std::endl;
+        return 1;
+    }
+
+    vv_mesh::mesh m = build_mesh(soup, smooth);
+    if (optimize)
+    {
+        vv_mesh::optimize_report report;
+        vv_mesh::optimize_mesh(m, &report);
+        std::cout << "optimized in " << report.m_ms << " ms: ACMR " << report.m_before.m_acmr << " -> "
+                  << report.m_after.m_acmr << ", ATVR " << report.m_before.m_atvr << " -> " << report.m_after.m_atvr
+                  << ", overdraw " << report.m_overdraw_before << " -> " << report.m_overdraw_after << std::endl;
+    }
+    if (!vv_mesh::write_mesh_file(paths[1], m, options, error))
+    {
+        std::cout << "error: " << error << std::endl;
+        return 1;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << m.vertex_count() << " vertices, " << m.triangle_count() << " triangles written to " << paths[1]
+              << " in " << seconds << " s" << std::endl;
+
+    vv_mesh::mesh_file written;
+    if (written.open(paths[1]))
+        for (uint32_t i = 0; i < written.header()->m_lod_count; i++)
+            std::cout << "LOD " << i << ": " << written.lods()[i].m_index_count / 3 << " triangles, error "
+                      << written.lods()[i].m_max_error << std::endl;
+    return 0;
+}
@@ -0,0 +1,51 @@
+// Converts a text point list (x y z [r g b] per line) into the chunked point
+// cloud format read by allegro_opengl_project::open_point_cloud().
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "vv_point_cloud_file.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "usage: pc_convert input.xyz output.vvpc [points per node]" << std::endl;
+        return 1;
+    }
+    const uint32_t node_capacity = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 65536;
+
+    FILE* in = std::fopen(argv[1], "r");
+    if (!in)
+    {
+        std::cout << "couldn't open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<vv_cloud::point_record> points;
+    char line[512];
+    while (std::fgets(line, sizeof(line), in))
+    {
+        vv_cloud::point_record p;
+        int r = 255, g = 255, b = 255;
+        int n = std::sscanf(line, "%f %f %f %d %d %d", &p.m_pos[0], &p.m_pos[1], &p.m_pos[2], &r, &g, &b);
+        if (n < 3)
+            continue;
+        p.m_rgba[0] = static_cast<uint8_t>(r);
+        p.m_rgba[1] = static_cast<uint8_t>(g);
+        p.m_rgba[2] = static_cast<uint8_t>(b);
+        p.m_rgba[3] = 255;
+        points.push_back(p);
+    }
+    std::fclose(in);
+
+    std::string error;
+    if (!vv_cloud::write_point_cloud(argv[2], points, node_capacity, error))
+    {
+        std::cout << "error: " << error << std::endl;
+        return 1;
+    }
+    std::cout << points.size() << " points written to " << argv[2] << std::endl;
+    return 0;
+}
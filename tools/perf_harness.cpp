@@ -0,0 +1,369 @@
+// Renders synthetic scenes through allegro_opengl_project along scripted camera
+// paths and compares frame time percentiles and draw counters against a stored
+// baseline. Timings may only get slower by their tolerance; counters are exact
+// within theirs either way, fewer draw calls or triangles mean the scene changed.
+// Runs without user interaction, on Linux with software GL e.g.
+//   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run -s "-screen 0 1024x768x24" ./perf_harness
+// Exit code: 0 within tolerance, 1 regression, 2 couldn't run or no baseline.
+#include "allegro_project.h"
+#include "vv_mesh.h"
+#include "vv_mesh_file.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const double timing_tolerance  = 0.25;  // relative, for new baseline entries
+    const double counter_tolerance = 0.0;
+    const char*  lod_mesh_path     = "perf_mesh.vvmesh";  // written by the mesh_lod scene, removed after it
+
+    // many short labels, the worst case for the HUD batch
+    class text_widget : public vv_ui::overlay_widget
+    {
+    public:
+        unsigned m_count = 0;
+
+        void build(vv_ui::overlay& o, int w, int h) override
+        {
+            const ALLEGRO_COLOR color = al_map_rgb(255, 255, 0);
+            const int columns = std::max(1, w / 80);
+            for (unsigned i = 0; i < m_count; i++)
+                o.textf(allegro_project::get_system_font(), color, 10 + (i % columns) * 80.f,
+                        10 + (i / columns % std::max(1, h / 12)) * 12.f, ALLEGRO_ALIGN_LEFT, "label %u", i);
+        }
+    };
+
+    struct scene_script
+    {
+        const char* m_name;
+        double      m_distance;  // camera orbit around the origin
+        double      m_pitch;
+        bool        m_shaded;
+        bool        m_wireframe;
+        bool        m_single_pass_wire;
+        unsigned    m_labels;
+        allegro_opengl_project::view_layout m_layout;
+    };
+
+    const scene_script g_scripts[] =
+    {
+        {"boxes",           45, 0.5, true,  false, false, 0,    allegro_opengl_project::view_layout::single},
+        {"boxes_split",     45, 0.5, true,  false, false, 0,    allegro_opengl_project::view_layout::top_front_iso},
+        {"moving_boxes",    45, 0.5, true,  false, false, 0,    allegro_opengl_project::view_layout::top_front_iso},
+        {"large_mesh",      12, 0.3, true,  false, false, 0,    allegro_opengl_project::view_layout::single},
+        {"large_mesh_oct8", 12, 0.3, true,  false, false, 0,    allegro_opengl_project::view_layout::single},
+        {"mesh_lod",        40, 0.3, true,  false, false, 0,    allegro_opengl_project::view_layout::single},
+        {"wireframe",       30, 0.4, true,  true,  false, 0,    allegro_opengl_project::view_layout::single},
+        {"wireframe_1pass", 30, 0.4, true,  true,  true,  0,    allegro_opengl_project::view_layout::single},
+        {"overlay_text",    10, 0.2, true,  false, false, 3000, allegro_opengl_project::view_layout::single},
+    };
+
+    struct metric
+    {
+        double m_value;
+        double m_tolerance;
+        bool   m_counter;  // checked both ways, not stored in the baseline
+    };
+    typedef std::map<std::string, metric> metric_map;
+
+    double percentile(const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+        const std::size_t rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+    }
+
+    class harness_project : public allegro_opengl_project
+    {
+    public:
+        bool has_display() const {return m_display != nullptr;}
+
+        void setup(const scene_script& s)
+        {
+            draw_state_flags::m_shaded = s.m_shaded;
+            draw_state_flags::m_wireframe = s.m_wireframe;
+            draw_state_flags::m_single_pass_wire = s.m_single_pass_wire;
+            draw_state_flags::m_wire_width = 1;
+            draw_state_flags::m_compas = true;
+            draw_state_flags::m_coord_sys = false;
+            draw_state_flags::m_occlusion = false;
+            draw_state_flags::m_debug_view = debug_view::none;
+            set_view_layout(s.m_layout);
+
+            m_scene.clear();
+            m_box.set_vertex_format(std::strcmp(s.m_name, "large_mesh_oct8") == 0 ?
+                                    vv_gl::mesh_renderer::vertex_format::quantized_oct8 :
+                                    vv_gl::mesh_renderer::vertex_format::float32);
+            if (std::strncmp(s.m_name, "large_mesh", 10) == 0)
+            {
+                set_object_mesh(vv_mesh::make_sphere(1, 256, 512));
+                for (int i = 0; i < 9; i++)
+                    m_scene.add_box(3.f * (i % 3 - 1), 0, 3.f * (i / 3 - 1), 1.2f);
+            }
+            else if (std::strcmp(s.m_name, "mesh_lod") == 0)
+            {
+                // the large sphere through the mesh file, far away objects take coarser LODs
+                std::string error;
+                if (!vv_mesh::write_mesh_file(lod_mesh_path, vv_mesh::make_sphere(1, 256, 512),
+                                              vv_mesh::write_options(), error))
+                    std::cout << error << std::endl;
+                open_mesh(lod_mesh_path);
+                for (int i = 0; i < 100; i++)
+                    m_scene.add_box(3.f * (i % 10 - 4.5f), 0, 3.f * (i / 10 - 4.5f), 1.2f);
+            }
+            else if (std::strncmp(s.m_name, "wireframe", 9) == 0)
+            {
+                set_object_mesh(vv_mesh::make_sphere(1, 48, 96));
+                for (int i = 0; i < 400; i++)
+                    m_scene.add_box(1.2f * (i % 20 - 9.5f), 0, 1.2f * (i / 20 - 9.5f), 0.5f);
+            }
+            else if (std::strncmp(s.m_name, "boxes", 5) == 0)
+            {
+                set_object_mesh(vv_mesh::make_box(1));
+                for (int i = 0; i < 10000; i++)
+                    m_scene.add_box(0.6f * (i % 100 - 49.5f), 0, 0.6f * (i / 100 - 49.5f), 0.2f);
+            }
+            else if (std::strcmp(s.m_name, "moving_boxes") == 0)
+            {
+                // fixed seed and fixed time step, every run sees the same motion
+                set_object_mesh(vv_mesh::make_box(1));
+                set_motion_limit(15);
+                uint32_t seed = 12345;
+                auto random = [&seed]() {seed = seed * 1664525u + 1013904223u; return (seed >> 8) / float(1 << 24) * 2 - 1;};
+                for (int i = 0; i < 50000; i++)
+                {
+                    const std::size_t id = m_scene.add_box(15 * random(), 15 * random(), 15 * random(), 0.05f);
+                    m_scene.set_velocity(id, 4 * random(), 4 * random(), 4 * random());
+                }
+            }
+            else
+            {
+                set_object_mesh(vv_mesh::make_box(1));
+                m_scene.add_box(0, 0, 0, 1);
+            }
+            m_text.m_count = s.m_labels;
+            if (s.m_labels)
+                m_overlay.add_widget(&m_text);
+            else
+                m_overlay.remove_widget(&m_text);
+            m_script = &s;
+        }
+
+        // one full orbit over the measured frames, warm-up frames start it early
+        void run(int warmup, int frames, metric_map& out)
+        {
+            std::vector<double> times;
+            times.reserve(frames);
+            typedef vv_gl::render_stats rs;
+            double scene[rs::counter_count] = {}, al_draw_calls = 0, labels = 0;
+            for (int f = -warmup; f < frames; f++)
+            {
+                m_angle = 2 * M_PI * f / frames;
+                const double start = al_get_time();
+                draw_frame();
+                glFinish();
+                if (f < 0)
+                    continue;
+                times.push_back((al_get_time() - start) * 1000);
+                const rs::frame& last = get_render_stats().last();
+                for (int c = 0; c < rs::counter_count; c++)
+                    scene[c] += rs::value(last.m_passes[rs::scene], static_cast<rs::counter>(c));
+                al_draw_calls += last.total().m_al_draw_calls;
+                labels += m_overlay.stats().m_labels;
+            }
+            std::sort(times.begin(), times.end());
+            std::cout << m_script->m_name << ":";
+            for (unsigned i = 0; i < m_jobs.worker_count(); i++)
+                std::cout << " worker " << i << " " << static_cast<int>(m_jobs.stats(i).m_utilization * 100) << "%";
+            std::cout << std::endl;
+            double sum = 0;
+            for (double t : times)
+                sum += t;
+
+            const std::string prefix = std::string(m_script->m_name) + ".";
+            out[prefix + "mean_ms"] = {sum / frames, timing_tolerance, false};
+            out[prefix + "p50_ms"] = {percentile(times, 0.5), timing_tolerance, false};
+            out[prefix + "p90_ms"] = {percentile(times, 0.9), timing_tolerance, false};
+            out[prefix + "p99_ms"] = {percentile(times, 0.99), timing_tolerance, false};
+            out[prefix + "objects"] = {scene[rs::objects] / frames, counter_tolerance, true};
+            out[prefix + "draw_calls"] = {scene[rs::draw_calls] / frames, counter_tolerance, true};
+            out[prefix + "triangles"] = {scene[rs::triangles] / frames, counter_tolerance, true};
+            out[prefix + "vertices"] = {scene[rs::vertices] / frames, counter_tolerance, true};
+            out[prefix + "lines"] = {scene[rs::lines] / frames, counter_tolerance, true};
+            out[prefix + "state_changes"] = {scene[rs::state_changes] / frames, counter_tolerance, true};
+            out[prefix + "texture_binds"] = {scene[rs::texture_binds] / frames, counter_tolerance, true};
+            out[prefix + "buffer_kib"] = {scene[rs::buffer_bytes] / 1024 / frames, counter_tolerance, true};
+            out[prefix + "al_draw_calls"] = {al_draw_calls / frames, counter_tolerance, true};
+            out[prefix + "labels"] = {labels / frames, counter_tolerance, true};
+            out[prefix + "vertex_kib"] = {m_box.stats().m_vertex_bytes / 1024.0, counter_tolerance, true};
+            out[prefix + "acmr"] = {m_box.stats().m_acmr, counter_tolerance, true};
+        }
+
+        // the renderer reads the mesh file while it is open, so it goes back to a box first
+        void finish()
+        {
+            if (std::strcmp(m_script->m_name, "mesh_lod") != 0)
+                return;
+            set_object_mesh(vv_mesh::make_box(1));
+            std::remove(lod_mesh_path);
+        }
+
+        void check_input_state() override
+        {
+            for (view& v : m_views)
+                set_orbit_camera(v, m_script->m_distance, m_script->m_pitch, m_angle);
+        }
+
+    protected:
+        const scene_script* m_script = &g_scripts[0];
+        double              m_angle = 0;
+        text_widget         m_text;
+    };
+
+    bool read_baseline(const std::string& path, metric_map& baseline)
+    {
+        std::ifstream in(path.c_str());
+        if (!in)
+            return false;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream fields(line);
+            std::string name;
+            metric m = {0, 0, false};
+            if (fields >> name >> m.m_value >> m.m_tolerance)
+                baseline[name] = m;
+        }
+        return true;
+    }
+
+    bool write_baseline(const std::string& path, const metric_map& metrics)
+    {
+        std::ofstream out(path.c_str());
+        if (!out)
+            return false;
+        out << "# metric value tolerance (relative; timings may not rise above it, counters may not leave it)\n";
+        for (const auto& m : metrics)
+        {
+            char line[256];
+            std::snprintf(line, sizeof(line), "%s %.4f %.2f\n", m.first.c_str(), m.second.m_value, m.second.m_tolerance);
+            out << line;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string baseline_path = "perf_baseline.txt";
+    std::string only;
+    bool update = false;
+    int frames = 300;
+    int warmup = 30;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--baseline" && i + 1 < argc)
+            baseline_path = argv[++i];
+        else if (arg == "--scene" && i + 1 < argc)
+            only = argv[++i];
+        else if (arg == "--frames" && i + 1 < argc)
+            frames = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--warmup" && i + 1 < argc)
+            warmup = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--update")
+            update = true;
+        else
+        {
+            std::cout << "usage: perf_harness [--baseline file] [--scene name] [--frames n] [--warmup n] [--update]"
+                      << std::endl;
+            return 2;
+        }
+    }
+
+    harness_project project;
+    project.set_back_buffer_samples(0);  // driver MSAA defaults would make timings machine dependent
+    project.init(ALLEGRO_OPENGL, false);
+    al_set_new_display_option(ALLEGRO_VSYNC, 2, ALLEGRO_SUGGEST);  // never wait for the monitor
+    project.create_display(800, 600);
+    if (!project.has_display())
+        return 2;
+    std::cout << "GL renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    metric_map measured;
+    for (const scene_script& s : g_scripts)
+    {
+        if (!only.empty() && only != s.m_name)
+            continue;
+        project.setup(s);
+        project.run(warmup, frames, measured);
+        project.finish();
+    }
+    if (measured.empty())
+    {
+        std::cout << "no scene named " << only << std::endl;
+        return 2;
+    }
+
+    metric_map baseline;
+    const bool have_baseline = read_baseline(baseline_path, baseline);
+    if (update)
+    {
+        // keep hand-tuned tolerances of metrics that already exist
+        for (auto& m : measured)
+        {
+            auto it = baseline.find(m.first);
+            if (it != baseline.end())
+                m.second.m_tolerance = it->second.m_tolerance;
+            baseline[m.first] = m.second;
+        }
+        if (!write_baseline(baseline_path, baseline))
+        {
+            std::cout << "couldn't write " << baseline_path << std::endl;
+            return 2;
+        }
+    }
+
+    int regressions = 0;
+    for (const auto& m : measured)
+    {
+        auto it = baseline.find(m.first);
+        char line[256];
+        if (update || !have_baseline || it == baseline.end())
+        {
+            std::snprintf(line, sizeof(line), "%-28s %12.3f", m.first.c_str(), m.second.m_value);
+            std::cout << line << (update || !have_baseline ? "" : "  (not in baseline)") << std::endl;
+            continue;
+        }
+        // the baseline keeps 4 decimals, its rounding must not count as a change
+        const double slack = std::fabs(it->second.m_value) * it->second.m_tolerance + 1e-4;
+        const double limit = it->second.m_value + slack;
+        const bool regressed = m.second.m_counter ? std::fabs(m.second.m_value - it->second.m_value) > slack
+                                                  : m.second.m_value > limit;
+        regressions += regressed;
+        std::snprintf(line, sizeof(line), "%-28s %12.3f  baseline %12.3f  %s %12.3f  %s", m.first.c_str(),
+                      m.second.m_value, it->second.m_value, m.second.m_counter ? "+/-  " : "limit",
+                      m.second.m_counter ? slack : limit, regressed ? "REGRESSION" : "ok");
+        std::cout << line << std::endl;
+    }
+
+    if (!have_baseline && !update)
+    {
+        std::cout << "no baseline at " << baseline_path << ", run with --update to store one" << std::endl;
+        return 2;
+    }
+    if (regressions)
+        std::cout << regressions << " metric(s) regressed" << std::endl;
+    return regressions ? 1 : 0;
+}
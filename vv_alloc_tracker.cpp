@@ -0,0 +1,234 @@
+#include "vv_alloc_tracker.h"
+#include "vv_trace.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace vv_mem
+{
+    namespace
+    {
+        // the size lives in front of the block, padded to keep malloc's alignment
+        const std::size_t header_size = 16;
+
+        std::atomic<uint64_t> g_allocs{0};
+        std::atomic<uint64_t> g_frees{0};
+        std::atomic<uint64_t> g_bytes{0};
+        std::atomic<int64_t>  g_live_bytes{0};
+        std::atomic<uint64_t> g_peak_bytes{0};
+
+        // open addressing by the zone name pointer, slot 0 collects allocations outside zones
+        // and everything that doesn't fit anymore
+        struct zone_slot
+        {
+            std::atomic<const char*> m_name{nullptr};
+            std::atomic<uint64_t>    m_allocs{0};
+            std::atomic<uint64_t>    m_bytes{0};
+        };
+        zone_slot g_zones[allocation_monitor::max_zones];
+
+        zone_slot& zone_for(const char* name)
+        {
+            if (!name)
+                return g_zones[0];
+            const std::size_t n = allocation_monitor::max_zones - 1;
+            std::size_t i = (reinterpret_cast<uintptr_t>(name) >> 4) % n;
+            for (std::size_t probe = 0; probe < n; probe++, i = (i + 1) % n)
+            {
+                zone_slot& z = g_zones[i + 1];
+                const char* current = z.m_name.load(std::memory_order_acquire);
+                if (current == name)
+                    return z;
+                // a failed exchange reloads current, another thread may have claimed it for this name
+                if (!current && z.m_name.compare_exchange_strong(current, name, std::memory_order_acq_rel))
+                    return z;
+                if (current == name)
+                    return z;
+            }
+            return g_zones[0];
+        }
+
+        void count_alloc(std::size_t size)
+        {
+            g_allocs.fetch_add(1, std::memory_order_relaxed);
+            g_bytes.fetch_add(size, std::memory_order_relaxed);
+            const int64_t live = g_live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+            uint64_t peak = g_peak_bytes.load(std::memory_order_relaxed);
+            while (live > 0 && static_cast<uint64_t>(live) > peak &&
+                   !g_peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+                ;
+            zone_slot& z = zone_for(vv_trace::current_zone());
+            z.m_allocs.fetch_add(1, std::memory_order_relaxed);
+            z.m_bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        void count_free(std::size_t size)
+        {
+            g_frees.fetch_add(1, std::memory_order_relaxed);
+            g_live_bytes.fetch_sub(size, std::memory_order_relaxed);
+        }
+    }
+
+    bool allocation_tracking_enabled()
+    {
+#ifdef VV_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    alloc_counters allocation_totals()
+    {
+        alloc_counters c;
+        c.m_allocs = g_allocs.load(std::memory_order_relaxed);
+        c.m_frees = g_frees.load(std::memory_order_relaxed);
+        c.m_bytes = g_bytes.load(std::memory_order_relaxed);
+        c.m_live_bytes = g_live_bytes.load(std::memory_order_relaxed);
+        c.m_peak_bytes = g_peak_bytes.load(std::memory_order_relaxed);
+        return c;
+    }
+
+    void reset_allocation_peak()
+    {
+        const int64_t live = g_live_bytes.load(std::memory_order_relaxed);
+        g_peak_bytes.store(live > 0 ? live : 0, std::memory_order_relaxed);
+    }
+
+    void* tracked_malloc(std::size_t size)
+    {
+        char* block = static_cast<char*>(std::malloc(size + header_size));
+        if (!block)
+            return nullptr;
+        *reinterpret_cast<std::size_t*>(block) = size;
+        count_alloc(size);
+        return block + header_size;
+    }
+
+    void* tracked_realloc(void* ptr, std::size_t size)
+    {
+        if (!ptr)
+            return tracked_malloc(size);
+        if (size == 0)
+        {
+            tracked_free(ptr);
+            return nullptr;
+        }
+        char* block = static_cast<char*>(ptr) - header_size;
+        const std::size_t old_size = *reinterpret_cast<std::size_t*>(block);
+        block = static_cast<char*>(std::realloc(block, size + header_size));
+        if (!block)
+            return nullptr;
+        *reinterpret_cast<std::size_t*>(block) = size;
+        count_free(old_size);
+        count_alloc(size);
+        return block + header_size;
+    }
+
+    void tracked_free(void* ptr)
+    {
+        if (!ptr)
+            return;
+        char* block = static_cast<char*>(ptr) - header_size;
+        count_free(*reinterpret_cast<std::size_t*>(block));
+        std::free(block);
+    }
+
+    void allocation_monitor::begin_frame()
+    {
+        reset_allocation_peak();
+        m_begin = allocation_totals();
+        for (std::size_t i = 0; i < max_zones; i++)
+        {
+            m_zone_allocs_begin[i] = g_zones[i].m_allocs.load(std::memory_order_relaxed);
+            m_zone_bytes_begin[i] = g_zones[i].m_bytes.load(std::memory_order_relaxed);
+        }
+    }
+
+    void allocation_monitor::end_frame()
+    {
+        const alloc_counters now = allocation_totals();
+        m_last.m_allocs = now.m_allocs - m_begin.m_allocs;
+        m_last.m_frees = now.m_frees - m_begin.m_frees;
+        m_last.m_bytes = now.m_bytes - m_begin.m_bytes;
+        m_last.m_live_bytes = now.m_live_bytes;
+        m_last.m_peak_bytes = now.m_peak_bytes;
+
+        m_frame_zone_count = 0;
+        for (std::size_t i = 0; i < max_zones; i++)
+        {
+            const uint64_t allocs = g_zones[i].m_allocs.load(std::memory_order_relaxed) - m_zone_allocs_begin[i];
+            if (allocs == 0)
+                continue;
+            zone_stats& z = m_frame_zones[m_frame_zone_count++];
+            z.m_name = g_zones[i].m_name.load(std::memory_order_relaxed);
+            z.m_allocs = allocs;
+            z.m_bytes = g_zones[i].m_bytes.load(std::memory_order_relaxed) - m_zone_bytes_begin[i];
+        }
+        std::sort(m_frame_zones, m_frame_zones + m_frame_zone_count,
+                  [](const zone_stats& a, const zone_stats& b) {return a.m_allocs > b.m_allocs;});
+
+        m_frame++;
+        if (m_steady_state_frame > 0 && m_frame >= m_steady_state_frame && m_last.m_allocs > 0)
+        {
+            if (m_violations++ == 0)
+            {
+                m_first_violation_frame = m_frame;
+                m_first_violation_zone = m_frame_zone_count > 0 ? m_frame_zones[0].m_name : nullptr;
+                std::cout << "steady state allocation: frame " << m_frame << ", " << m_last.m_allocs
+                          << " allocations, mostly in " << (m_first_violation_zone ? m_first_violation_zone : "(no zone)")
+                          << std::endl;
+            }
+        }
+    }
+}
+
+#ifdef VV_TRACK_ALLOCATIONS
+// the sized and aligned forms of later standards fall back to these
+void* operator new(std::size_t size)
+{
+    void* p = vv_mem::tracked_malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    void* p = vv_mem::tracked_malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return vv_mem::tracked_malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return vv_mem::tracked_malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    vv_mem::tracked_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    vv_mem::tracked_free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    vv_mem::tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    vv_mem::tracked_free(ptr);
+}
+#endif
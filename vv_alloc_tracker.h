@@ -0,0 +1,78 @@
+#ifndef vv_alloc_tracker_h
+#define vv_alloc_tracker_h
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace vv_mem
+{
+    // Heap instrumentation. Built with VV_TRACK_ALLOCATIONS, the global
+    // operator new / delete are replaced by the tracked versions below and every
+    // allocation is counted, also against the innermost VV_TRACE_SCOPE of the
+    // allocating thread (its zone). Without the define nothing is hooked and all
+    // counters stay at zero.
+    struct alloc_counters
+    {
+        uint64_t m_allocs     = 0;
+        uint64_t m_frees      = 0;
+        uint64_t m_bytes      = 0;  // requested, total
+        int64_t  m_live_bytes = 0;
+        uint64_t m_peak_bytes = 0;  // live bytes high water mark since reset_allocation_peak()
+    };
+
+    bool allocation_tracking_enabled();
+    alloc_counters allocation_totals();
+    void reset_allocation_peak();
+
+    // malloc-like entry points, also used to hook Allegro's and ImGui's allocators
+    void* tracked_malloc(std::size_t size);
+    void* tracked_realloc(void* ptr, std::size_t size);
+    void  tracked_free(void* ptr);
+
+    // Per-frame view of the counters. Works on fixed arrays, so the monitor
+    // itself never allocates inside the frame it measures.
+    class allocation_monitor
+    {
+    public:
+        static const std::size_t max_zones = 64;
+
+        struct zone_stats
+        {
+            const char* m_name   = nullptr;  // nullptr: outside any zone
+            uint64_t    m_allocs = 0;
+            uint64_t    m_bytes  = 0;
+        };
+
+        void begin_frame();
+        void end_frame();
+
+        // from this frame on any allocation is a violation, 0 disables the check
+        void set_steady_state_frame(unsigned frame) {m_steady_state_frame = frame;}
+        unsigned get_steady_state_frame() const {return m_steady_state_frame;}
+
+        const alloc_counters& last_frame() const {return m_last;}
+        // zones that allocated in the last frame, most allocations first
+        const zone_stats* last_frame_zones() const {return m_frame_zones;}
+        std::size_t last_frame_zone_count() const {return m_frame_zone_count;}
+
+        unsigned frame_index() const {return m_frame;}
+        unsigned violations() const {return m_violations;}
+        unsigned first_violation_frame() const {return m_first_violation_frame;}
+        const char* first_violation_zone() const {return m_first_violation_zone;}
+
+    protected:
+        alloc_counters m_begin;
+        alloc_counters m_last;
+        uint64_t       m_zone_allocs_begin[max_zones] = {};
+        uint64_t       m_zone_bytes_begin[max_zones] = {};
+        zone_stats     m_frame_zones[max_zones];
+        std::size_t    m_frame_zone_count = 0;
+
+        unsigned       m_frame = 0;
+        unsigned       m_steady_state_frame = 0;
+        unsigned       m_violations = 0;
+        unsigned       m_first_violation_frame = 0;
+        const char*    m_first_violation_zone = nullptr;
+    };
+}
+#endif
@@ -0,0 +1,276 @@
+#include "vv_dynamic_resolution.h"
+#include "vv_gl_ext.h"
+#include <allegro5/allegro5.h>
+#include <algorithm>
+#include <cmath>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+namespace vv_gl
+{
+    void dynamic_resolution::release_gl()
+    {
+        if (m_scene_fbo)
+            glDeleteFramebuffers(1, &m_scene_fbo);
+        if (m_resolve_fbo)
+            glDeleteFramebuffers(1, &m_resolve_fbo);
+        if (m_color_rb)
+            glDeleteRenderbuffers(1, &m_color_rb);
+        if (m_depth_rb)
+            glDeleteRenderbuffers(1, &m_depth_rb);
+        if (m_color_tex)
+            glDeleteTextures(1, &m_color_tex);
+        m_scene_fbo = m_resolve_fbo = m_color_rb = m_depth_rb = m_color_tex = 0;
+        m_alloc_w = m_alloc_h = 0;
+        m_alloc_samples = -1;
+
+        for (int i = 0; i < query_count; i++)
+        {
+            if (m_queries[i])
+                glDeleteQueries(1, &m_queries[i]);
+            m_queries[i] = 0;
+            m_query_pending[i] = false;
+        }
+    }
+
+    void dynamic_resolution::set_enabled(bool on)
+    {
+        if (m_enabled && !on)
+            release_gl();
+        m_enabled = on;
+        m_frames_since_change = 0;
+        m_stats.m_scene_ms = 0;
+    }
+
+    bool dynamic_resolution::allocate(int w, int h, int samples)
+    {
+        if (w == m_alloc_w && h == m_alloc_h && samples == m_alloc_samples)
+            return true;
+
+        // keep the queries, only the targets change
+        if (m_scene_fbo)
+            glDeleteFramebuffers(1, &m_scene_fbo);
+        if (m_resolve_fbo)
+            glDeleteFramebuffers(1, &m_resolve_fbo);
+        if (m_color_rb)
+            glDeleteRenderbuffers(1, &m_color_rb);
+        if (m_depth_rb)
+            glDeleteRenderbuffers(1, &m_depth_rb);
+        if (m_color_tex)
+            glDeleteTextures(1, &m_color_tex);
+        m_scene_fbo = m_resolve_fbo = m_color_rb = m_depth_rb = m_color_tex = 0;
+
+        glGenTextures(1, &m_color_tex);
+        glBindTexture(GL_TEXTURE_2D, m_color_tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenRenderbuffers(1, &m_depth_rb);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_depth_rb);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, w, h);
+
+        glGenFramebuffers(1, &m_scene_fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_scene_fbo);
+        if (samples > 0)
+        {
+            // multisampled scene, resolved into the texture before stretching
+            glGenRenderbuffers(1, &m_color_rb);
+            glBindRenderbuffer(GL_RENDERBUFFER, m_color_rb);
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, w, h);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color_rb);
+        }
+        else
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_color_tex, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth_rb);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+        if (samples > 0)
+        {
+            glGenFramebuffers(1, &m_resolve_fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_resolve_fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_color_tex, 0);
+            complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        if (!complete)
+        {
+            release_gl();
+            return false;
+        }
+        m_alloc_w = w;
+        m_alloc_h = h;
+        m_alloc_samples = samples;
+        return true;
+    }
+
+    bool dynamic_resolution::begin_scene(int window_w, int window_h)
+    {
+        if (!m_enabled || window_w <= 0 || window_h <= 0)
+            return false;
+
+        if (m_max_supported_samples < 0)
+        {
+            GLint max_samples = 0;
+            glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+            m_max_supported_samples = max_samples;
+            m_stats.m_gpu_timer = get_extensions().version_at_least(3, 3);
+        }
+        collect_timings();
+
+        m_window_w = window_w;
+        m_window_h = window_h;
+        const int w = std::max(1, static_cast<int>(window_w * m_scale + 0.5f));
+        const int h = std::max(1, static_cast<int>(window_h * m_scale + 0.5f));
+        if (!allocate(w, h, m_samples))
+        {
+            // no offscreen rendering here, stay with the window
+            m_enabled = false;
+            return false;
+        }
+        m_stats.m_width = w;
+        m_stats.m_height = h;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_scene_fbo);
+        glViewport(0, 0, w, h);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // keeps the window's clear color
+
+        const unsigned slot = m_query_index % query_count;
+        if (m_stats.m_gpu_timer && !m_query_pending[slot])
+        {
+            if (!m_queries[slot])
+                glGenQueries(1, &m_queries[slot]);
+            glBeginQuery(GL_TIME_ELAPSED, m_queries[slot]);
+        }
+        m_cpu_begin = al_get_time();
+        return true;
+    }
+
+    void dynamic_resolution::end_scene()
+    {
+        const unsigned slot = m_query_index % query_count;
+        if (m_stats.m_gpu_timer && !m_query_pending[slot])
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            m_query_pending[slot] = true;
+            m_query_generation[slot] = m_generation;
+            m_query_index++;
+        }
+        else if (!m_stats.m_gpu_timer)
+            adjust((al_get_time() - m_cpu_begin) * 1000);
+
+        if (m_resolve_fbo)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_scene_fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolve_fbo);
+            glBlitFramebuffer(0, 0, m_alloc_w, m_alloc_h, 0, 0, m_alloc_w, m_alloc_h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_window_w, m_window_h);
+
+        // a textured quad also works when the window itself is multisampled, a blit would not
+        static const GLfloat quad[] =
+        {
+            -1, -1, 0, 0,   1, -1, 1, 0,   1, 1, 1, 1,   -1, 1, 0, 1
+        };
+        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_CURRENT_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_ALPHA_TEST);
+        glDisable(GL_BLEND);
+        glDisable(GL_SCISSOR_TEST);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, m_color_tex);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), quad);
+        glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), quad + 2);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPopAttrib();
+    }
+
+    void dynamic_resolution::collect_timings()
+    {
+        // oldest first, stop at the first one the GPU hasn't finished
+        for (int i = 0; i < query_count; i++)
+        {
+            const unsigned slot = (m_query_index + i) % query_count;
+            if (!m_query_pending[slot])
+                continue;
+            GLuint available = 0;
+            glGetQueryObjectuiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(m_queries[slot], GL_QUERY_RESULT, &ns);
+            m_query_pending[slot] = false;
+            // frames rendered before the last change don't say anything about the new setup
+            if (m_query_generation[slot] == m_generation)
+                adjust(ns / 1e6);
+        }
+    }
+
+    void dynamic_resolution::adjust(double scene_ms)
+    {
+        m_stats.m_scene_ms = m_stats.m_scene_ms > 0 ? 0.8 * m_stats.m_scene_ms + 0.2 * scene_ms : scene_ms;
+        if (++m_frames_since_change < m_settings.m_adjust_interval)
+            return;
+
+        const double target = m_settings.m_target_ms;
+        const double current = m_stats.m_scene_ms;
+        const int max_samples = std::min(m_settings.m_max_samples, std::max(m_max_supported_samples, 0));
+        float scale = m_scale;
+        int samples = std::min(m_samples, max_samples);
+
+        // pixel cost goes with the square of the scale
+        const float step = static_cast<float>(std::sqrt(target / std::max(current, 0.001)));
+        if (current > target * 1.05)
+        {
+            if (samples > 0)
+                samples = samples > 2 ? samples / 2 : 0;
+            else
+                scale = std::max(m_settings.m_min_scale, scale * std::max(0.75f, step));
+        }
+        else if (current < target * 0.75)
+        {
+            if (scale < m_settings.m_max_scale)
+                scale = std::min(m_settings.m_max_scale, scale * std::min(1.15f, step));
+            else if (samples < max_samples)
+                samples = std::min(max_samples, samples > 0 ? samples * 2 : 2);
+        }
+        scale = std::min(std::max(scale, m_settings.m_min_scale), m_settings.m_max_scale);
+
+        if (scale == m_scale && samples == m_samples)
+            return;
+        m_scale = scale;
+        m_samples = samples;
+        m_frames_since_change = 0;
+        m_stats.m_scene_ms = 0;
+        m_stats.m_changes++;
+        m_generation++;
+    }
+}
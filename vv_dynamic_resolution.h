@@ -0,0 +1,87 @@
+#ifndef vv_dynamic_resolution_h
+#define vv_dynamic_resolution_h
+#include <allegro5/allegro_opengl.h>
+
+namespace vv_gl
+{
+    // Renders the 3D scene into an offscreen framebuffer and stretches it over the
+    // window. Resolution scale and MSAA samples follow the measured scene time:
+    // over budget, samples are dropped first and then the scale; with headroom,
+    // the scale comes back first and then the samples.
+    // The scene is timed with GL_TIME_ELAPSED queries read a few frames later,
+    // without them with the CPU time between begin_scene() and end_scene().
+    class dynamic_resolution
+    {
+    public:
+        static const int query_count = 4;
+
+        struct settings
+        {
+            double m_target_ms   = 1000.0 / 30;
+            float  m_min_scale   = 0.25f;
+            float  m_max_scale   = 1.0f;
+            int    m_max_samples = 4;
+            int    m_adjust_interval = 10;  // frames between two changes
+        };
+
+        struct statistics
+        {
+            double   m_scene_ms = 0;  // smoothed
+            int      m_width    = 0;  // offscreen size
+            int      m_height   = 0;
+            unsigned m_changes  = 0;
+            bool     m_gpu_timer = false;
+        };
+
+        // GL objects must be released with release_gl() while the context is alive
+        void release_gl();
+
+        void set_enabled(bool on);
+        bool is_enabled() const {return m_enabled;}
+        settings& get_settings() {return m_settings;}
+
+        // binds the offscreen target and clears it with the current clear color,
+        // viewports given in window pixels have to be scaled to stats().m_width/m_height;
+        // false when disabled or the target can't be created, the scene then goes to the window
+        bool begin_scene(int window_w, int window_h);
+        // stretches the scene over the window and binds the window back
+        void end_scene();
+
+        float scale() const {return m_scale;}
+        int samples() const {return m_samples;}
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        bool allocate(int w, int h, int samples);
+        void collect_timings();
+        void adjust(double scene_ms);
+
+        bool       m_enabled = false;
+        settings   m_settings;
+        statistics m_stats;
+
+        float  m_scale   = 1.0f;
+        int    m_samples = 0;
+        int    m_window_w = 0;
+        int    m_window_h = 0;
+        int    m_frames_since_change = 0;
+        int    m_max_supported_samples = -1;
+
+        GLuint m_scene_fbo   = 0;
+        GLuint m_resolve_fbo = 0;
+        GLuint m_color_rb    = 0;  // multisampled color, only with samples
+        GLuint m_depth_rb    = 0;
+        GLuint m_color_tex   = 0;  // what gets stretched over the window
+        int    m_alloc_w = 0;
+        int    m_alloc_h = 0;
+        int    m_alloc_samples = -1;
+
+        GLuint   m_queries[query_count] = {};
+        bool     m_query_pending[query_count] = {};
+        unsigned m_query_generation[query_count] = {};
+        unsigned m_query_index = 0;
+        unsigned m_generation = 0;  // bumped on every scale or samples change
+        double   m_cpu_begin = 0;
+    };
+}
+#endif
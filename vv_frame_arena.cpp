@@ -0,0 +1,96 @@
+#include "vv_frame_arena.h"
+#include <cstdint>
+#include <new>
+
+namespace vv_mem
+{
+    static std::size_t align_up(std::size_t value, std::size_t align)
+    {
+        return (value + align - 1) & ~(align - 1);
+    }
+
+    frame_arena::frame_arena(std::size_t capacity, int frames)
+    {
+        reserve(capacity, frames);
+    }
+
+    frame_arena::~frame_arena()
+    {
+        for (int i = 0; i < max_frames; i++)
+            release(m_buffers[i]);
+    }
+
+    void frame_arena::release(buffer& b)
+    {
+        for (void* p : b.m_overflow)
+            ::operator delete(p);
+        b.m_overflow.clear();
+        b.m_overflow_used = 0;
+        ::operator delete(b.m_data);
+        b.m_data = nullptr;
+        b.m_capacity = 0;
+        b.m_used = 0;
+    }
+
+    void frame_arena::reserve(std::size_t capacity, int frames)
+    {
+        if (frames < 1 || frames > max_frames)
+            throw "frame arena: frames count is out of range!";
+
+        for (int i = 0; i < max_frames; i++)
+            release(m_buffers[i]);
+
+        capacity = align_up(capacity, alignof(std::max_align_t));
+        for (int i = 0; i < frames; i++)
+        {
+            m_buffers[i].m_data = static_cast<char*>(::operator new(capacity));
+            m_buffers[i].m_capacity = capacity;
+        }
+        m_frames = frames;
+        m_current = 0;
+    }
+
+    void frame_arena::begin_frame()
+    {
+        const buffer& prev = m_buffers[m_current];
+        std::size_t prev_total = prev.m_used + prev.m_overflow_used;
+        if (prev_total > m_high_water)
+            m_high_water = prev_total;
+
+        m_current = (m_current + 1) % m_frames;
+        buffer& b = m_buffers[m_current];
+
+        // The frame that used this buffer did not fit: replace the buffer by one
+        // large enough for it, so the steady state never goes to the heap.
+        if (!b.m_overflow.empty())
+        {
+            std::size_t total = b.m_used + b.m_overflow_used;
+            std::size_t new_capacity = align_up(total + total / 2, alignof(std::max_align_t));
+            release(b);
+            b.m_data = static_cast<char*>(::operator new(new_capacity));
+            b.m_capacity = new_capacity;
+            m_grow_count++;
+        }
+        b.m_used = 0;
+    }
+
+    void* frame_arena::allocate(std::size_t size, std::size_t align)
+    {
+        buffer& b = m_buffers[m_current];
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(b.m_data);
+        std::size_t offset = align_up(base + b.m_used, align) - base;
+        if (offset + size <= b.m_capacity)
+        {
+            b.m_used = offset + size;
+            return b.m_data + offset;
+        }
+
+        // out of space: serve from heap and remember to grow on the next reuse
+        void* raw = ::operator new(size + align);
+        b.m_overflow.push_back(raw);
+        b.m_overflow_used += size;
+        m_overflow_bytes += size;
+        std::uintptr_t p = align_up(reinterpret_cast<std::uintptr_t>(raw), align);
+        return reinterpret_cast<void*>(p);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef vv_frame_arena_h
+#define vv_frame_arena_h
+#include <cstddef>
+#include <vector>
+
+namespace vv_mem
+{
+    // Linear (bump) allocator for data that lives at most for the frames in flight.
+    // Every frame gets its own buffer; begin_frame() moves to the next buffer and
+    // rewinds it, so memory handed out in frame N stays valid until frame N + frames.
+    // Not thread safe: use it from the main loop thread only.
+    class frame_arena
+    {
+    public:
+        static const int max_frames = 3;
+
+        explicit frame_arena(std::size_t capacity = 1 << 20, int frames = 2);
+        ~frame_arena();
+        frame_arena(const frame_arena&) = delete;
+        frame_arena& operator=(const frame_arena&) = delete;
+
+        void  reserve(std::size_t capacity, int frames);
+        void  begin_frame();
+        void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t));
+
+        int         frames() const          {return m_frames;}
+        int         frame_index() const     {return m_current;}
+        std::size_t used() const            {return m_buffers[m_current].m_used;}
+        std::size_t capacity() const        {return m_buffers[m_current].m_capacity;}
+        std::size_t high_water_mark() const {return m_high_water;}
+        std::size_t overflow_bytes() const  {return m_overflow_bytes;}
+        unsigned    grow_count() const      {return m_grow_count;}
+
+    protected:
+        struct buffer
+        {
+            char*              m_data     = nullptr;
+            std::size_t        m_capacity = 0;
+            std::size_t        m_used     = 0;
+            std::vector<void*> m_overflow; // heap blocks used when m_data ran out
+            std::size_t        m_overflow_used = 0;
+        };
+
+        void release(buffer& b);
+
+        buffer      m_buffers[max_frames];
+        int         m_frames         = 0;
+        int         m_current        = 0;
+        std::size_t m_high_water     = 0;
+        std::size_t m_overflow_bytes = 0;
+        unsigned    m_grow_count     = 0;
+    };
+
+    // STL allocator adapter. deallocate() is a no-op, memory goes back to the
+    // arena when the frame buffer is recycled.
+    template <class T>
+    class frame_allocator
+    {
+    public:
+        typedef T value_type;
+
+        explicit frame_allocator(frame_arena* arena) : m_arena(arena) {}
+        template <class U>
+        frame_allocator(const frame_allocator<U>& other) : m_arena(other.arena()) {}
+
+        T* allocate(std::size_t n)
+        {
+            return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, std::size_t) {}
+
+        frame_arena* arena() const {return m_arena;}
+
+    private:
+        frame_arena* m_arena;
+    };
+
+    template <class T, class U>
+    bool operator==(const frame_allocator<T>& a, const frame_allocator<U>& b) {return a.arena() == b.arena();}
+    template <class T, class U>
+    bool operator!=(const frame_allocator<T>& a, const frame_allocator<U>& b) {return a.arena() != b.arena();}
+
+    template <class T>
+    using frame_vector = std::vector<T, frame_allocator<T>>;
+}
+#endif
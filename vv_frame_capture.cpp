@@ -0,0 +1,333 @@
+#include "vv_frame_capture.h"
+#include "vv_trace.h"
+#include <allegro5/allegro5.h>
+#include <cstring>
+
+namespace vv_gl
+{
+    frame_capture::frame_capture() : m_frames_written(0), m_frames_failed(0)
+    {
+        m_writer = std::thread(&frame_capture::writer_proc, this);
+    }
+
+    frame_capture::~frame_capture()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_cv.notify_one();
+        m_writer.join();
+        close_stream();
+        for (job* j : m_queue)
+            delete j;
+        for (job* j : m_free)
+            delete j;
+    }
+
+    void frame_capture::release_gl()
+    {
+        for (slot& s : m_ring)
+        {
+            if (s.m_fence)
+                glDeleteSync(s.m_fence);
+            if (s.m_pbo)
+                glDeleteBuffers(1, &s.m_pbo);
+            s = slot();
+        }
+    }
+
+    void frame_capture::screenshot(const std::string& path)
+    {
+        m_pending_shot = path;
+    }
+
+    void frame_capture::start_sequence(const std::string& path, format fmt, int fps)
+    {
+        if (m_recording)
+            stop_sequence();
+        m_recording = true;
+        m_seq_path = path;
+        m_seq_format = fmt;
+        m_seq_fps = fps > 0 ? fps : 24;
+        m_seq_w = 0;
+        m_seq_h = 0;
+        m_seq_index = 0;
+    }
+
+    void frame_capture::stop_sequence()
+    {
+        if (!m_recording)
+            return;
+        m_recording = false;
+        for (int i = 0; i < ring_size; i++)
+        {
+            slot& s = m_ring[(m_next + i) % ring_size];
+            if (s.m_pending)
+                read_back(s, true);
+        }
+
+        // empty job closes the output stream in order with the frames
+        job* j = new job();
+        j->m_fmt = m_seq_format;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(j);
+        }
+        m_cv.notify_one();
+    }
+
+    void frame_capture::capture(int w, int h)
+    {
+        // pick up finished read backs without waiting
+        for (int i = 0; i < ring_size; i++)
+        {
+            slot& s = m_ring[(m_next + i) % ring_size];
+            if (s.m_pending)
+                read_back(s, false);
+        }
+
+        if (m_recording && m_seq_w && (m_seq_w != w || m_seq_h != h))
+            stop_sequence(); // a sequence can't change its frame size
+
+        const bool shot = !m_pending_shot.empty();
+        if (!shot && !m_recording)
+            return;
+        if (w <= 0 || h <= 0)
+            return;
+
+        slot& s = m_ring[m_next];
+        if (s.m_pending)
+        {
+            // ring wrapped onto a read back still in flight
+            m_forced_waits++;
+            read_back(s, true);
+        }
+
+        if (!s.m_pbo)
+            glGenBuffers(1, &s.m_pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.m_pbo);
+        if (s.m_w != w || s.m_h != h)
+            glBufferData(GL_PIXEL_PACK_BUFFER, w * h * 4, nullptr, GL_STREAM_READ);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadBuffer(GL_BACK);
+        glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        s.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        s.m_w = w;
+        s.m_h = h;
+        s.m_pending = true;
+        s.m_shot = shot;
+        s.m_path = shot ? m_pending_shot : m_seq_path;
+        m_pending_shot.clear();
+
+        if (m_recording && !shot)
+        {
+            m_seq_w = w;
+            m_seq_h = h;
+        }
+        m_next = (m_next + 1) % ring_size;
+    }
+
+    void frame_capture::read_back(slot& s, bool wait)
+    {
+        GLenum res = glClientWaitSync(s.m_fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                      wait ? GLuint64(1000000000) : 0);
+        if (res == GL_TIMEOUT_EXPIRED && !wait)
+            return;
+        glDeleteSync(s.m_fence);
+        s.m_fence = nullptr;
+        s.m_pending = false;
+
+        job* j = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!s.m_shot && m_queue.size() >= static_cast<std::size_t>(max_queued))
+            {
+                m_frames_dropped++;
+                return;
+            }
+            if (!m_free.empty())
+            {
+                j = m_free.back();
+                m_free.pop_back();
+            }
+        }
+        if (!j)
+            j = new job();
+
+        const std::size_t size = static_cast<std::size_t>(s.m_w) * s.m_h * 4;
+        j->m_pixels.resize(size);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.m_pbo);
+        void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (data)
+        {
+            std::memcpy(j->m_pixels.data(), data, size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        j->m_w = s.m_w;
+        j->m_h = s.m_h;
+        j->m_shot = s.m_shot;
+        j->m_path = s.m_path;
+        j->m_fmt = s.m_shot ? format::png : m_seq_format;
+        j->m_fps = m_seq_fps;
+        j->m_index = s.m_shot ? 0 : m_seq_index++;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(j);
+        }
+        m_cv.notify_one();
+    }
+
+    void frame_capture::flush()
+    {
+        for (int i = 0; i < ring_size; i++)
+        {
+            slot& s = m_ring[(m_next + i) % ring_size];
+            if (s.m_pending)
+                read_back(s, true);
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle_cv.wait(lock, [this] {return m_queue.empty() && !m_busy;});
+    }
+
+    void frame_capture::writer_proc()
+    {
+        vv_trace::set_thread_name("capture writer");
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cv.wait(lock, [this] {return m_quit || !m_queue.empty();});
+            if (m_queue.empty())
+                break; // quit requested and nothing left to write
+
+            job* j = m_queue.front();
+            m_queue.pop_front();
+            m_busy = true;
+            lock.unlock();
+
+            write_job(*j);
+
+            lock.lock();
+            m_free.push_back(j);
+            m_busy = false;
+            if (m_queue.empty())
+                m_idle_cv.notify_all();
+        }
+        m_idle_cv.notify_all();
+    }
+
+    void frame_capture::write_job(job& j)
+    {
+        VV_TRACE_SCOPE("job", "capture write");
+        if (j.m_w == 0)
+        {
+            close_stream();
+            return;
+        }
+
+        if (j.m_shot)
+        {
+            if (!write_png(j, j.m_path))
+            {
+                m_frames_failed++;
+                return;
+            }
+        }
+        else if (j.m_fmt == format::png)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "_%06u.png", j.m_index);
+            if (!write_png(j, j.m_path + name))
+            {
+                m_frames_failed++;
+                return;
+            }
+        }
+        else
+        {
+            if (j.m_index == 0)
+            {
+                close_stream();
+                m_stream = std::fopen(j.m_path.c_str(), "wb");
+                if (m_stream && j.m_fmt == format::y4m)
+                    std::fprintf(m_stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n",
+                                 j.m_w, j.m_h, j.m_fps);
+            }
+            if (!m_stream)
+            {
+                m_frames_failed++;
+                return;
+            }
+            if (j.m_fmt == format::raw)
+                std::fwrite(j.m_pixels.data(), 1, j.m_pixels.size(), m_stream);
+            else
+                write_y4m_frame(j);
+        }
+        m_frames_written++;
+    }
+
+    bool frame_capture::write_png(const job& j, const std::string& path)
+    {
+        // memory bitmaps are safe to use from a non-display thread
+        al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+        al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE);
+        ALLEGRO_BITMAP* bmp = al_create_bitmap(j.m_w, j.m_h);
+        if (!bmp)
+            return false;
+        ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE,
+                                                       ALLEGRO_LOCK_WRITEONLY);
+        bool saved = false;
+        if (region)
+        {
+            const int row = j.m_w * 4;
+            for (int y = 0; y < j.m_h; y++)
+            {
+                // GL rows are bottom-up
+                unsigned char* dst = static_cast<unsigned char*>(region->data) + y * region->pitch;
+                const unsigned char* src = j.m_pixels.data() + (j.m_h - 1 - y) * row;
+                std::memcpy(dst, src, row);
+                for (int x = 3; x < row; x += 4)
+                    dst[x] = 255;
+            }
+            al_unlock_bitmap(bmp);
+            saved = al_save_bitmap(path.c_str(), bmp);
+        }
+        al_destroy_bitmap(bmp);
+        return saved;
+    }
+
+    void frame_capture::write_y4m_frame(const job& j)
+    {
+        const std::size_t plane = static_cast<std::size_t>(j.m_w) * j.m_h;
+        m_yuv.resize(plane * 3);
+        unsigned char* py = m_yuv.data();
+        unsigned char* pu = py + plane;
+        unsigned char* pv = pu + plane;
+        for (int y = 0; y < j.m_h; y++)
+        {
+            const unsigned char* src = j.m_pixels.data() + static_cast<std::size_t>(j.m_h - 1 - y) * j.m_w * 4;
+            for (int x = 0; x < j.m_w; x++, src += 4)
+            {
+                // BT.601 studio range
+                const int r = src[0], g = src[1], b = src[2];
+                *py++ = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+                *pu++ = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                *pv++ = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+        std::fputs("FRAME\n", m_stream);
+        std::fwrite(m_yuv.data(), 1, m_yuv.size(), m_stream);
+    }
+
+    void frame_capture::close_stream()
+    {
+        if (m_stream)
+        {
+            std::fclose(m_stream);
+            m_stream = nullptr;
+        }
+    }
+}
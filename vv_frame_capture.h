@@ -0,0 +1,110 @@
+#ifndef vv_frame_capture_h
+#define vv_frame_capture_h
+#include <allegro5/allegro_opengl.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vv_gl
+{
+    // Back buffer capture without pipeline stalls: glReadPixels goes into a ring of
+    // pixel pack buffers, each one is mapped a frame or two later when its fence has
+    // signaled, and the pixels are written to disk by a background thread.
+    class frame_capture
+    {
+    public:
+        enum class format
+        {
+            png,  // numbered png files
+            raw,  // one file of bottom-up RGBA frames
+            y4m   // one YUV4MPEG2 4:4:4 stream
+        };
+
+        static const int ring_size  = 3;
+        static const int max_queued = 8; // frames waiting for the writer before dropping
+
+        frame_capture();
+        ~frame_capture();
+
+        void screenshot(const std::string& path);
+        void start_sequence(const std::string& path, format fmt, int fps);
+        void stop_sequence();
+        bool recording() const {return m_recording;}
+
+        // call once per frame after rendering, before the flip
+        void capture(int w, int h);
+        // read back everything in flight and wait for the writer
+        void flush();
+        void release_gl();
+
+        unsigned frames_written() const {return m_frames_written;}
+        // couldn't be saved, e.g. png files in a missing directory
+        unsigned frames_failed() const  {return m_frames_failed;}
+        unsigned frames_dropped() const {return m_frames_dropped;}
+        unsigned forced_waits() const   {return m_forced_waits;}
+
+    protected:
+        struct slot
+        {
+            GLuint      m_pbo     = 0;
+            GLsync      m_fence   = nullptr;
+            int         m_w       = 0;
+            int         m_h       = 0;
+            bool        m_pending = false;
+            bool        m_shot    = false;
+            std::string m_path;
+        };
+
+        struct job
+        {
+            std::vector<unsigned char> m_pixels;
+            int         m_w    = 0;
+            int         m_h    = 0;
+            format      m_fmt  = format::png;
+            int         m_fps  = 24;   // of the sequence, the writer can't read m_seq_fps
+            bool        m_shot = false;
+            std::string m_path;
+            unsigned    m_index = 0;
+        };
+
+        void read_back(slot& s, bool wait);
+        void writer_proc();
+        void write_job(job& j);
+        bool write_png(const job& j, const std::string& path);
+        void write_y4m_frame(const job& j);
+        void close_stream();
+
+        slot        m_ring[ring_size];
+        int         m_next = 0;
+        std::string m_pending_shot;
+        bool        m_recording = false;
+        format      m_seq_format = format::png;
+        std::string m_seq_path;
+        int         m_seq_fps = 24;
+        int         m_seq_w = 0;
+        int         m_seq_h = 0;
+        unsigned    m_seq_index = 0;
+        unsigned    m_forced_waits = 0;
+        unsigned    m_frames_dropped = 0;
+
+        // writer thread state
+        std::thread                          m_writer;
+        std::mutex                           m_mutex;
+        std::condition_variable              m_cv;
+        std::condition_variable              m_idle_cv;
+        std::deque<job*>                     m_queue;
+        std::vector<job*>                    m_free;
+        bool                                 m_quit = false;
+        bool                                 m_busy = false;
+        FILE*                                m_stream = nullptr;
+        std::vector<unsigned char>           m_yuv;
+        std::atomic<unsigned>                m_frames_written;
+        std::atomic<unsigned>                m_frames_failed;
+    };
+}
+#endif
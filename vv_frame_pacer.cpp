@@ -0,0 +1,77 @@
+#include "vv_frame_pacer.h"
+#include "vv_gl_ext.h"
+#include <allegro5/allegro5.h>
+#include <algorithm>
+
+namespace vv_gl
+{
+    void frame_pacer::release_gl()
+    {
+        for (int i = 0; i < m_count; i++)
+            glDeleteSync(m_frames[(m_first + i) % max_frames_in_flight].m_fence);
+        m_first = 0;
+        m_count = 0;
+    }
+
+    void frame_pacer::set_frames_in_flight(int frames)
+    {
+        m_frames_in_flight = std::min(std::max(frames, 1), static_cast<int>(max_frames_in_flight));
+    }
+
+    void frame_pacer::reset_latency()
+    {
+        m_stats.m_latency_ms = 0;
+        m_stats.m_latency_avg_ms = 0;
+        m_stats.m_latency_max_ms = 0;
+        m_stats.m_latency_samples = 0;
+    }
+
+    bool frame_pacer::retire_oldest(bool wait)
+    {
+        frame& f = m_frames[m_first];
+        // a wait gives up after a second rather than hanging on a lost context
+        const GLenum res = glClientWaitSync(f.m_fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                            wait ? GLuint64(1000000000) : 0);
+        if (res == GL_TIMEOUT_EXPIRED && !wait)
+            return false;
+        glDeleteSync(f.m_fence);
+        f.m_fence = nullptr;
+
+        if (f.m_input_timestamp > 0)
+        {
+            const double latency = (al_get_time() - f.m_input_timestamp) * 1000;
+            m_stats.m_latency_ms = latency;
+            m_stats.m_latency_avg_ms = m_stats.m_latency_samples ?
+                                       0.9 * m_stats.m_latency_avg_ms + 0.1 * latency : latency;
+            m_stats.m_latency_max_ms = std::max(m_stats.m_latency_max_ms, latency);
+            m_stats.m_latency_samples++;
+        }
+        m_first = (m_first + 1) % max_frames_in_flight;
+        m_count--;
+        return true;
+    }
+
+    void frame_pacer::begin_frame()
+    {
+        if (!get_extensions().m_sync)
+            return;
+        while (m_count > 0 && retire_oldest(false))
+            ;
+        const double start = al_get_time();
+        while (m_count >= m_frames_in_flight)
+            retire_oldest(true);
+        m_stats.m_wait_ms = (al_get_time() - start) * 1000;
+    }
+
+    void frame_pacer::end_frame(double input_timestamp)
+    {
+        if (!get_extensions().m_sync)
+            return;
+        if (m_count == max_frames_in_flight)
+            retire_oldest(true);
+        frame& f = m_frames[(m_first + m_count) % max_frames_in_flight];
+        f.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        f.m_input_timestamp = input_timestamp;
+        m_count++;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef vv_frame_pacer_h
+#define vv_frame_pacer_h
+#include <allegro5/allegro_opengl.h>
+
+namespace vv_gl
+{
+    // Bounds how many frames the driver may queue ahead of the GPU. Each flipped
+    // frame gets a fence; begin_frame() waits on the oldest one while the limit
+    // is reached, so the CPU builds frame N+1 while the GPU still works on N,
+    // but never more than frames_in_flight() ahead.
+    // 1 gives the freshest input on screen, 3 the best throughput.
+    // A frame can carry the timestamp of the oldest input event it reflects
+    // (al_get_time() clock); when its fence is seen signaled, the time since
+    // that input is taken as input-to-present latency. Fences are checked at
+    // the start of every frame, so latency is accurate to about one frame.
+    // Without sync objects (GL below 3.2 and no ARB_sync) pacing is off and
+    // begin_frame()/end_frame() do nothing.
+    class frame_pacer
+    {
+    public:
+        static const int max_frames_in_flight = 3;
+
+        struct statistics
+        {
+            double   m_wait_ms        = 0;  // blocked in the last begin_frame()
+            double   m_latency_ms     = 0;  // last measured frame
+            double   m_latency_avg_ms = 0;  // smoothed
+            double   m_latency_max_ms = 0;
+            unsigned m_latency_samples = 0;
+        };
+
+        // GL objects must be released with release_gl() while the context is alive
+        void release_gl();
+
+        void set_frames_in_flight(int frames);
+        int frames_in_flight() const {return m_frames_in_flight;}
+        int frames_pending() const {return m_count;}
+
+        // before the frame reads input
+        void begin_frame();
+        // after the flip, input_timestamp 0 when the frame reflects no new input
+        void end_frame(double input_timestamp);
+
+        const statistics& stats() const {return m_stats;}
+        void reset_latency();
+
+    protected:
+        struct frame
+        {
+            GLsync m_fence = nullptr;
+            double m_input_timestamp = 0;
+        };
+
+        bool retire_oldest(bool wait);
+
+        int        m_frames_in_flight = 2;
+        frame      m_frames[max_frames_in_flight];
+        int        m_first = 0;
+        int        m_count = 0;
+        statistics m_stats;
+    };
+}
+#endif
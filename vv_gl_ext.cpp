@@ -0,0 +1,40 @@
+#include "vv_gl_ext.h"
+
+namespace vv_gl
+{
+    template <class T>
+    static void load_proc(T& proc, const char* name)
+    {
+        proc = reinterpret_cast<T>(al_get_opengl_proc_address(name));
+    }
+
+    const extensions& get_extensions()
+    {
+        static extensions ext;
+        if (ext.m_loaded)
+            return ext;
+
+        const uint32_t version = al_get_opengl_version();
+        ext.m_major = version >> 24;
+        ext.m_minor = (version >> 16) & 255;
+
+        ext.m_sync = ext.version_at_least(3, 2) || al_have_opengl_extension("GL_ARB_sync");
+        if (ext.version_at_least(4, 4) || al_have_opengl_extension("GL_ARB_buffer_storage"))
+            load_proc(ext.m_buffer_storage, "glBufferStorage");
+        if (ext.version_at_least(4, 1) || al_have_opengl_extension("GL_ARB_get_program_binary"))
+        {
+            load_proc(ext.m_get_program_binary, "glGetProgramBinary");
+            load_proc(ext.m_program_binary, "glProgramBinary");
+            load_proc(ext.m_program_parameteri, "glProgramParameteri");
+        }
+        if (ext.version_at_least(4, 3) || al_have_opengl_extension("GL_ARB_compute_shader"))
+            load_proc(ext.m_dispatch_compute, "glDispatchCompute");
+        if (ext.version_at_least(4, 2) || al_have_opengl_extension("GL_ARB_shader_image_load_store"))
+            load_proc(ext.m_memory_barrier, "glMemoryBarrier");
+        if (ext.version_at_least(4, 3) || al_have_opengl_extension("GL_ARB_multi_draw_indirect"))
+            load_proc(ext.m_multi_draw_elements_indirect, "glMultiDrawElementsIndirect");
+
+        ext.m_loaded = true;
+        return ext;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef vv_gl_ext_h
+#define vv_gl_ext_h
+#include <allegro5/allegro_opengl.h>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT   0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x0200
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x0040
+#endif
+
+namespace vv_gl
+{
+    // Entry points newer than the ones Allegro exposes through allegro_opengl.h.
+    // Loaded from the current context, a null pointer means "not supported".
+    struct extensions
+    {
+        typedef void (APIENTRY *buffer_storage_proc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+        typedef void (APIENTRY *get_program_binary_proc)(GLuint program, GLsizei size, GLsizei* length, GLenum* format, void* binary);
+        typedef void (APIENTRY *program_binary_proc)(GLuint program, GLenum format, const void* binary, GLsizei length);
+        typedef void (APIENTRY *program_parameteri_proc)(GLuint program, GLenum name, GLint value);
+        typedef void (APIENTRY *dispatch_compute_proc)(GLuint x, GLuint y, GLuint z);
+        typedef void (APIENTRY *memory_barrier_proc)(GLbitfield barriers);
+        typedef void (APIENTRY *multi_draw_elements_indirect_proc)(GLenum mode, GLenum type, const void* indirect,
+                                                                   GLsizei draw_count, GLsizei stride);
+
+        bool m_loaded = false;
+        int  m_major  = 0;
+        int  m_minor  = 0;
+        bool m_sync   = false;  // ARB_sync, glFenceSync and friends come through Allegro's own loader
+
+        buffer_storage_proc     m_buffer_storage     = nullptr;
+        get_program_binary_proc m_get_program_binary = nullptr;  // ARB_get_program_binary
+        program_binary_proc     m_program_binary     = nullptr;
+        program_parameteri_proc m_program_parameteri = nullptr;
+        dispatch_compute_proc   m_dispatch_compute   = nullptr;  // ARB_compute_shader
+        memory_barrier_proc     m_memory_barrier     = nullptr;  // ARB_shader_image_load_store
+        multi_draw_elements_indirect_proc m_multi_draw_elements_indirect = nullptr;  // ARB_multi_draw_indirect
+
+        bool version_at_least(int major, int minor) const
+        {
+            return m_major > major || (m_major == major && m_minor >= minor);
+        }
+    };
+
+    // loads on the first call, needs a current GL context
+    const extensions& get_extensions();
+}
+#endif
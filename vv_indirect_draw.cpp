@@ -0,0 +1,376 @@
+#include "vv_indirect_draw.h"
+#include "vv_gl_ext.h"
+#include "vv_shader.h"
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+namespace vv_gl
+{
+    // away from 0..3 where drivers like to alias gl_Vertex and gl_Normal
+    static const GLuint object_location = 6;
+    static const GLuint cull_group_size = 64;
+
+    static const char* cull_cs =
+        "#version 430\n"
+        "layout(local_size_x = 64) in;\n"
+        "// x[n], y[n], z[n], half size[n]\n"
+        "layout(std430, binding = 0) readonly buffer object_block {float objects[];};\n"
+        "struct draw_command {uint count; uint instance_count; uint first_index; int base_vertex; uint base_instance;};\n"
+        "layout(std430, binding = 1) writeonly buffer command_block {draw_command commands[];};\n"
+        "layout(std430, binding = 2) buffer counter_block {uint visible; uint triangles;};\n"
+        "uniform uint u_count;\n"
+        "uniform uint u_first_command;\n"
+        "uniform vec4 u_planes[6];\n"
+        "uniform vec4 u_depth_row;   // clip w, the view depth\n"
+        "uniform float u_znear;\n"
+        "uniform float u_units;      // pixels per unit of half size at distance 1\n"
+        "uniform float u_lod_pixels;\n"
+        "uniform int u_lod_count;\n"
+        "uniform uint u_lod_first[8];\n"
+        "uniform uint u_lod_indices[8];\n"
+        "uniform float u_lod_error[8];\n"
+        "void main()\n"
+        "{\n"
+        "    uint id = gl_GlobalInvocationID.x;\n"
+        "    if (id >= u_count)\n"
+        "        return;\n"
+        "    vec3 c = vec3(objects[id], objects[u_count + id], objects[2u * u_count + id]);\n"
+        "    float s = objects[3u * u_count + id];\n"
+        "    bool inside = true;\n"
+        "    for (int i = 0; i < 6; i++)\n"
+        "    {\n"
+        "        // corner of the box farthest along the plane normal\n"
+        "        vec3 corner = c + s * sign(u_planes[i].xyz);\n"
+        "        inside = inside && dot(u_planes[i].xyz, corner) + u_planes[i].w >= 0.0;\n"
+        "    }\n"
+        "    // errors grow with the level, as mesh_renderer::select_lod()\n"
+        "    int lod = 0;\n"
+        "    float w = dot(u_depth_row, vec4(c, 1.0));\n"
+        "    if (w > u_znear)\n"
+        "    {\n"
+        "        float pixels_per_unit = s * u_units / w;\n"
+        "        while (lod + 1 < u_lod_count && u_lod_error[lod + 1] * pixels_per_unit <= u_lod_pixels)\n"
+        "            lod++;\n"
+        "    }\n"
+        "    commands[u_first_command + id] = draw_command(u_lod_indices[lod], inside ? 1u : 0u, u_lod_first[lod], 0, id);\n"
+        "    if (inside)\n"
+        "    {\n"
+        "        atomicAdd(visible, 1u);\n"
+        "        atomicAdd(triangles, u_lod_indices[lod] / 3u);\n"
+        "    }\n"
+        "}\n";
+
+    static const char* draw_vs =
+        "#version 430 compatibility\n"
+        "layout(std430, binding = 0) readonly buffer object_block {float objects[];};\n"
+        "in uint a_object;\n"
+        "uniform uint u_count;\n"
+        "uniform vec4 u_fit;  // mesh center and scale, (0, 0, 0, 1) leaves it alone\n"
+        "out vec4 v_color;\n"
+        "void main()\n"
+        "{\n"
+        "    uint id = a_object;\n"
+        "    vec3 c = vec3(objects[id], objects[u_count + id], objects[2u * u_count + id]);\n"
+        "    float k = objects[3u * u_count + id] * u_fit.w;\n"
+        "    vec4 position = vec4(c + k * (gl_Vertex.xyz - u_fit.xyz), 1.0);\n"
+        "    // the fixed function light 0 and the global ambient, as the other paths get them\n"
+        "    vec3 n = normalize(gl_NormalMatrix * gl_Normal);\n"
+        "    vec4 ec = gl_ModelViewMatrix * position;\n"
+        "    vec3 l = normalize(gl_LightSource[0].position.xyz - ec.xyz * gl_LightSource[0].position.w);\n"
+        "    v_color = gl_FrontLightModelProduct.sceneColor + gl_FrontMaterial.ambient * gl_LightSource[0].ambient\n"
+        "            + gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse * max(dot(n, l), 0.0);\n"
+        "    v_color.a = gl_FrontMaterial.diffuse.a;\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * position;\n"
+        "}\n";
+
+    static const char* draw_fs =
+        "#version 430 compatibility\n"
+        "in vec4 v_color;\n"
+        "void main()\n"
+        "{\n"
+        "    gl_FragColor = v_color;\n"
+        "}\n";
+
+    void indirect_renderer::release_gl()
+    {
+        GLuint buffers[3] = {m_objects, m_ids, m_commands};
+        for (GLuint b : buffers)
+            if (b)
+                glDeleteBuffers(1, &b);
+        for (counter_slot& c : m_counters)
+        {
+            if (c.m_buffer)
+                glDeleteBuffers(1, &c.m_buffer);
+            if (c.m_fence)
+                glDeleteSync(c.m_fence);
+            c = counter_slot();
+        }
+        if (!m_cache)
+        {
+            if (m_cull_program)
+                glDeleteProgram(m_cull_program);
+            if (m_draw_program)
+                glDeleteProgram(m_draw_program);
+        }
+        m_objects = m_ids = m_commands = 0;
+        m_cull_program = m_draw_program = 0;
+        m_count = m_command_capacity = 0;
+        m_revision = ~uint64_t(0);
+        m_frame = 0;
+        m_checked = false;
+        m_failure.clear();
+    }
+
+    GLuint indirect_renderer::get_program(const program_source& source, std::string& log)
+    {
+        if (m_cache)
+            return m_cache->get(source, log);
+        if (source.m_compute)
+            return build_compute_program(source.m_compute, log);
+        return build_program(source.m_vertex, source.m_fragment, source.m_attributes, log);
+    }
+
+    bool indirect_renderer::is_supported()
+    {
+        if (m_checked)
+            return m_failure.empty();
+        m_checked = true;
+        if (!prepare())
+        {
+            std::cout << "GPU-driven drawing: " << m_failure << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool indirect_renderer::prepare()
+    {
+        const extensions& ext = get_extensions();
+        if (!ext.version_at_least(4, 3) || !ext.m_dispatch_compute || !ext.m_memory_barrier ||
+            !ext.m_multi_draw_elements_indirect)
+        {
+            m_failure = "needs GL 4.3";
+            return false;
+        }
+
+        std::string log;
+        program_source cull;
+        cull.m_compute = cull_cs;
+        m_cull_program = get_program(cull, log);
+        if (!m_cull_program)
+        {
+            m_failure = "culling shader: " + log;
+            return false;
+        }
+        program_source draw;
+        draw.m_vertex = draw_vs;
+        draw.m_fragment = draw_fs;
+        draw.m_attributes = {{object_location, "a_object"}};
+        m_draw_program = get_program(draw, log);
+        if (!m_draw_program)
+        {
+            if (!m_cache)
+                glDeleteProgram(m_cull_program);
+            m_cull_program = 0;
+            m_failure = "drawing shader: " + log;
+            return false;
+        }
+
+        m_count_location = glGetUniformLocation(m_cull_program, "u_count");
+        m_first_command_location = glGetUniformLocation(m_cull_program, "u_first_command");
+        m_planes_location = glGetUniformLocation(m_cull_program, "u_planes");
+        m_depth_row_location = glGetUniformLocation(m_cull_program, "u_depth_row");
+        m_znear_location = glGetUniformLocation(m_cull_program, "u_znear");
+        m_units_location = glGetUniformLocation(m_cull_program, "u_units");
+        m_lod_pixels_location = glGetUniformLocation(m_cull_program, "u_lod_pixels");
+        m_lod_count_location = glGetUniformLocation(m_cull_program, "u_lod_count");
+        m_lod_first_location = glGetUniformLocation(m_cull_program, "u_lod_first");
+        m_lod_indices_location = glGetUniformLocation(m_cull_program, "u_lod_indices");
+        m_lod_error_location = glGetUniformLocation(m_cull_program, "u_lod_error");
+        m_draw_count_location = glGetUniformLocation(m_draw_program, "u_count");
+        m_fit_location = glGetUniformLocation(m_draw_program, "u_fit");
+
+        glGenBuffers(1, &m_objects);
+        glGenBuffers(1, &m_ids);
+        glGenBuffers(1, &m_commands);
+        const GLuint zeros[2] = {0, 0};
+        for (counter_slot& c : m_counters)
+        {
+            glGenBuffers(1, &c.m_buffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.m_buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zeros), zeros, GL_DYNAMIC_READ);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return true;
+    }
+
+    void indirect_renderer::set_fit(const float fit[4], bool fitted)
+    {
+        std::copy(fit, fit + 4, m_fit);
+        m_fitted = fitted;
+    }
+
+    void indirect_renderer::read_counters()
+    {
+        // oldest frame first, fences signal in order so the first unfinished one ends the search
+        for (uint64_t f = m_frame > counter_buffers ? m_frame - counter_buffers : 0; f < m_frame; f++)
+        {
+            counter_slot& c = m_counters[f % counter_buffers];
+            if (!c.m_fence)
+                continue;
+            const GLenum res = glClientWaitSync(c.m_fence, 0, 0);
+            if (res != GL_ALREADY_SIGNALED && res != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(c.m_fence);
+            c.m_fence = nullptr;
+            GLuint counts[2] = {0, 0};
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, c.m_buffer);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counts), counts);
+            m_stats.m_visible = counts[0];
+            m_stats.m_triangles = counts[1];
+        }
+    }
+
+    void indirect_renderer::begin_frame(const vv_scene::scene& s, std::size_t views)
+    {
+        m_stats.m_uploaded_bytes = 0;
+        if (!is_supported())
+            return;
+
+        // the previous frame's draws are all submitted, its counters are final once the GPU gets here
+        if (m_frame > 0)
+            m_counters[(m_frame - 1) % counter_buffers].m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        read_counters();
+
+        // the pacer keeps the GPU within fewer frames than there are slots; if it is
+        // further behind anyway that frame's counts are skipped rather than waited for
+        counter_slot& slot = m_counters[m_frame % counter_buffers];
+        if (slot.m_fence)
+        {
+            glDeleteSync(slot.m_fence);
+            slot.m_fence = nullptr;
+        }
+        const GLuint zeros[2] = {0, 0};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot.m_buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zeros), zeros);
+        m_frame++;
+
+        const std::size_t n = s.size();
+        if (n != m_count)
+        {
+            // the id of instance i is i, the base instance of a command picks the object
+            std::vector<uint32_t> ids(n);
+            std::iota(ids.begin(), ids.end(), 0u);
+            glBindBuffer(GL_ARRAY_BUFFER, m_ids);
+            glBufferData(GL_ARRAY_BUFFER, n * sizeof(uint32_t), ids.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objects);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * n * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+            m_count = n;
+            m_revision = ~uint64_t(0);
+        }
+        if (n * views > m_command_capacity)
+        {
+            m_command_capacity = n * views;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commands);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, m_command_capacity * sizeof(draw_command), nullptr, GL_DYNAMIC_COPY);
+        }
+        if (n && (s.revision() != m_revision || s.has_motion()))
+        {
+            // the arrays as they are, one copy each
+            const std::vector<float>* arrays[4] = {&s.m_x, &s.m_y, &s.m_z, &s.m_half_size};
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objects);
+            for (int k = 0; k < 4; k++)
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, k * n * sizeof(float), n * sizeof(float), arrays[k]->data());
+            m_revision = s.revision();
+            m_stats.m_uploaded_bytes += 4 * n * sizeof(float);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        m_stats.m_objects = static_cast<unsigned>(n);
+    }
+
+    bool indirect_renderer::draw(const mesh_renderer& mesh, std::size_t view, const view_params& params)
+    {
+        if (!is_supported() || !mesh.is_uploaded() || mesh.lod_count() == 0 ||
+            mesh.get_vertex_format() != mesh_renderer::vertex_format::float32 ||
+            (view + 1) * m_count > m_command_capacity)
+            return false;
+        if (m_count == 0)
+            return true;
+
+        const extensions& ext = get_extensions();
+        const GLuint n = static_cast<GLuint>(m_count);
+        const GLuint first_command = static_cast<GLuint>(view * m_count);
+
+        GLfloat planes[24];
+        for (int i = 0; i < 6; i++)
+            for (int k = 0; k < 4; k++)
+                planes[4 * i + k] = static_cast<GLfloat>(params.m_frustum->m_planes[i][k]);
+        const double* vp = params.m_view_projection;
+        const GLfloat depth_row[4] = {GLfloat(vp[3]), GLfloat(vp[7]), GLfloat(vp[11]), GLfloat(vp[15])};
+        const GLint lods = static_cast<GLint>(std::min<std::size_t>(mesh.lod_count(), max_lods));
+        GLuint lod_first[max_lods] = {};
+        GLuint lod_indices[max_lods] = {};
+        GLfloat lod_error[max_lods] = {};
+        for (GLint i = 0; i < lods; i++)
+        {
+            lod_first[i] = mesh.lod(i).m_first_index;
+            lod_indices[i] = mesh.lod(i).m_index_count;
+            lod_error[i] = mesh.lod(i).m_max_error;
+        }
+
+        // cull and pick the LODs into this view's commands
+        glUseProgram(m_cull_program);
+        glUniform1ui(m_count_location, n);
+        glUniform1ui(m_first_command_location, first_command);
+        glUniform4fv(m_planes_location, 6, planes);
+        glUniform4fv(m_depth_row_location, 1, depth_row);
+        glUniform1f(m_znear_location, params.m_znear);
+        glUniform1f(m_units_location, m_fit[3] * params.m_pixel_scale);
+        glUniform1f(m_lod_pixels_location, params.m_lod_pixels);
+        glUniform1i(m_lod_count_location, lods);
+        glUniform1uiv(m_lod_first_location, max_lods, lod_first);
+        glUniform1uiv(m_lod_indices_location, max_lods, lod_indices);
+        glUniform1fv(m_lod_error_location, max_lods, lod_error);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objects);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_commands);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_counters[(m_frame - 1) % counter_buffers].m_buffer);
+        ext.m_dispatch_compute((n + cull_group_size - 1) / cull_group_size, 1, 1);
+        // the commands feed the draw, the counters the read back next frame
+        ext.m_memory_barrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // every object in one call, the culled ones have no instance
+        const GLfloat identity[4] = {0, 0, 0, 1};
+        glUseProgram(m_draw_program);
+        glUniform1ui(m_draw_count_location, n);
+        glUniform4fv(m_fit_location, 1, m_fitted ? m_fit : identity);
+        const GLsizei stride = 6 * sizeof(float);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer());
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glVertexPointer(3, GL_FLOAT, stride, nullptr);
+        glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const void*>(3 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, m_ids);
+        glEnableVertexAttribArray(object_location);
+        glVertexAttribIPointer(object_location, 1, GL_UNSIGNED_INT, 0, nullptr);
+        glVertexAttribDivisor(object_location, 1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.triangle_buffer());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commands);
+        ext.m_multi_draw_elements_indirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                           reinterpret_cast<const void*>(first_command * sizeof(draw_command)),
+                                           static_cast<GLsizei>(n), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glVertexAttribDivisor(object_location, 0);
+        glDisableVertexAttribArray(object_location);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for (GLuint b = 0; b < 3; b++)
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, 0);
+        glUseProgram(0);
+        return true;
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef vv_indirect_draw_h
+#define vv_indirect_draw_h
+#include <allegro5/allegro_opengl.h>
+#include <cstdint>
+#include <string>
+#include "vv_frame_pacer.h"
+#include "vv_mesh_renderer.h"
+#include "vv_program_cache.h"
+#include "vv_scene.h"
+
+namespace vv_gl
+{
+    // GPU-driven drawing of every scene object with the same mesh. Object
+    // positions and sizes sit in a shader storage buffer, uploaded as whole
+    // arrays when the scene changes or moves. Per view a compute shader tests
+    // each object against the frustum, picks its LOD from the screen size as
+    // mesh_renderer::select_lod() does, and writes one indirect command for it,
+    // with an instance count of 0 when it is outside. One
+    // glMultiDrawElementsIndirect then draws the scene. The base instance
+    // carries the object id into the vertex shader through an instanced
+    // attribute, so the CPU does no work per object. The visible and triangle
+    // counters rotate through one buffer more than the pacer lets frames be in
+    // flight, each fenced; one is only read once its fence has signaled, until
+    // then the stats keep the last values, so reading them never stalls.
+    // Needs GL 4.3, which Mesa's llvmpipe has, and a float32 mesh.
+    class indirect_renderer
+    {
+    public:
+        static const int max_lods = 8;  // coarser ones aren't used
+        static const int counter_buffers = frame_pacer::max_frames_in_flight + 1;
+
+        struct statistics
+        {
+            unsigned    m_objects        = 0;  // in the object buffer
+            unsigned    m_visible        = 0;  // summed over the views, of the newest frame the GPU finished
+            unsigned    m_triangles      = 0;
+            std::size_t m_uploaded_bytes = 0;  // of this frame
+        };
+
+        // the view to cull and draw for, its matrices are the current GL ones
+        struct view_params
+        {
+            const vv_scene::frustum* m_frustum;
+            const double* m_view_projection;  // column major, clip w is the view depth
+            float m_znear;
+            float m_pixel_scale;  // pixels per unit at distance 1
+            float m_lod_pixels;   // LOD error allowed on screen
+        };
+
+        // GL objects must be released with release_gl() while the context is alive
+        void release_gl();
+        // programs come from the cache when set, it owns them then
+        void set_program_cache(program_cache* cache) {m_cache = cache;}
+        // needs a current context, builds the programs on the first call;
+        // false when the context can't do it, failure() tells why
+        bool is_supported();
+        const std::string& failure() const {return m_failure;}
+
+        // center and scale of the mesh into the unit box, fitted moves the mesh
+        // there; the LOD selection takes the scale either way
+        void set_fit(const float fit[4], bool fitted);
+
+        // once per frame, views is how many draw() calls follow
+        void begin_frame(const vv_scene::scene& s, std::size_t views);
+        // view counts from 0 within the frame; false when nothing was drawn
+        bool draw(const mesh_renderer& mesh, std::size_t view, const view_params& params);
+
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        GLuint get_program(const program_source& source, std::string& log);
+        bool prepare();
+
+        // visible, triangles of one frame
+        struct counter_slot
+        {
+            GLuint m_buffer = 0;
+            GLsync m_fence  = nullptr;  // set when the frame is done submitting
+        };
+
+        void read_counters();
+
+        struct draw_command  // as glMultiDrawElementsIndirect reads it
+        {
+            GLuint m_count;
+            GLuint m_instance_count;
+            GLuint m_first_index;
+            GLint  m_base_vertex;
+            GLuint m_base_instance;
+        };
+
+        GLuint   m_objects       = 0;  // x[n], y[n], z[n], half size[n]
+        GLuint   m_ids           = 0;  // 0 .. n - 1, instanced
+        GLuint   m_commands      = 0;  // n per view
+        counter_slot m_counters[counter_buffers];  // m_frame % counter_buffers is written
+        std::size_t m_count      = 0;
+        std::size_t m_command_capacity = 0;
+        uint64_t m_revision      = ~uint64_t(0);  // of the uploaded scene
+        uint64_t m_frame         = 0;
+        float    m_fit[4]        = {0, 0, 0, 1};
+        bool     m_fitted        = false;
+
+        GLuint   m_cull_program  = 0;
+        GLuint   m_draw_program  = 0;
+        bool     m_checked       = false;
+        std::string m_failure;
+        program_cache* m_cache   = nullptr;
+        GLint    m_count_location       = -1;
+        GLint    m_first_command_location = -1;
+        GLint    m_planes_location      = -1;
+        GLint    m_depth_row_location   = -1;
+        GLint    m_znear_location       = -1;
+        GLint    m_units_location       = -1;
+        GLint    m_lod_pixels_location  = -1;
+        GLint    m_lod_count_location   = -1;
+        GLint    m_lod_first_location   = -1;
+        GLint    m_lod_indices_location = -1;
+        GLint    m_lod_error_location   = -1;
+        GLint    m_draw_count_location  = -1;
+        GLint    m_fit_location         = -1;
+
+        statistics m_stats;
+    };
+}
+#endif
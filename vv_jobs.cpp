@@ -0,0 +1,261 @@
+#include "vv_jobs.h"
+#include "vv_trace.h"
+#include <algorithm>
+
+namespace vv_jobs
+{
+    namespace
+    {
+        // worker the calling thread belongs to, per job system
+        struct thread_binding
+        {
+            const job_system* m_system = nullptr;
+            unsigned          m_index  = 0;
+        };
+        thread_local thread_binding t_binding;
+
+        const char* const worker_names[job_system::max_workers] =
+        {
+            "main", "job worker 1", "job worker 2", "job worker 3", "job worker 4", "job worker 5",
+            "job worker 6", "job worker 7", "job worker 8", "job worker 9", "job worker 10",
+            "job worker 11", "job worker 12", "job worker 13", "job worker 14", "job worker 15"
+        };
+    }
+
+    // orderings follow Le, Pop, Cohen, Zappa Nardelli, "Correct and Efficient
+    // Work-Stealing for Weak Memory Models" (PPoPP 2013)
+    bool work_stealing_deque::push(job* j)
+    {
+        const long b = m_bottom.load(std::memory_order_relaxed);
+        const long t = m_top.load(std::memory_order_acquire);
+        if (b - t >= static_cast<long>(capacity))
+            return false;
+        m_jobs[b & (capacity - 1)].store(j, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    job* work_stealing_deque::pop()
+    {
+        const long b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = m_top.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        job* j = m_jobs[b & (capacity - 1)].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            // last one, race the thieves for it
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                j = nullptr;
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return j;
+    }
+
+    job* work_stealing_deque::steal()
+    {
+        long t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const long b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        job* j = m_jobs[t & (capacity - 1)].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return j;
+    }
+
+    void job_system::start(unsigned workers)
+    {
+        if (m_worker_count)
+            return;
+        if (workers == 0)
+            workers = std::max(1u, std::thread::hardware_concurrency());
+        m_worker_count = std::min(workers, max_workers);
+        m_workers.reset(new worker[m_worker_count]);
+        for (unsigned i = 0; i < m_worker_count; i++)
+            m_workers[i].m_pool.reset(new job[pool_size]);
+
+        t_binding.m_system = this;
+        t_binding.m_index = 0;
+        m_window_begin_ns = vv_trace::now_ns();
+        m_running.store(true);
+        for (unsigned i = 1; i < m_worker_count; i++)
+            m_workers[i].m_thread = std::thread(&job_system::worker_loop, this, i);
+    }
+
+    void job_system::stop()
+    {
+        if (!m_worker_count)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_running.store(false);
+        }
+        m_wake.notify_all();
+        for (unsigned i = 1; i < m_worker_count; i++)
+            m_workers[i].m_thread.join();
+        if (t_binding.m_system == this)
+            t_binding = thread_binding();
+        m_workers.reset();
+        m_worker_count = 0;
+    }
+
+    job_system::worker* job_system::this_worker() const
+    {
+        return t_binding.m_system == this ? &m_workers[t_binding.m_index] : nullptr;
+    }
+
+    job* job_system::allocate(job* parent, const char* name)
+    {
+        worker* w = this_worker();
+        job* j = &w->m_pool[w->m_pool_next++ % pool_size];
+        j->m_function = nullptr;
+        j->m_name = name;
+        j->m_parent = parent;
+        j->m_unfinished.store(1, std::memory_order_relaxed);
+        j->m_continuation_count = 0;
+        if (parent)
+            parent->m_unfinished.fetch_add(1, std::memory_order_relaxed);
+        return j;
+    }
+
+    bool job_system::add_continuation(job* ancestor, job* continuation)
+    {
+        if (ancestor->m_continuation_count == job::max_continuations)
+            return false;
+        ancestor->m_continuations[ancestor->m_continuation_count++] = continuation;
+        return true;
+    }
+
+    void job_system::push(worker& w, job* j)
+    {
+        if (!w.m_queue.push(j))
+        {
+            // deque full, no one else can take it anyway
+            execute(w, j);
+            return;
+        }
+        m_queued.fetch_add(1);
+        if (m_sleepers.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_wake.notify_one();
+        }
+    }
+
+    void job_system::run(job* j)
+    {
+        push(*this_worker(), j);
+    }
+
+    job* job_system::next_job(worker& w)
+    {
+        job* j = w.m_queue.pop();
+        if (!j)
+        {
+            // victims in turn, starting after ourselves
+            const unsigned self = static_cast<unsigned>(&w - m_workers.get());
+            for (unsigned i = 1; i < m_worker_count && !j; i++)
+                j = m_workers[(self + i) % m_worker_count].m_queue.steal();
+            if (j)
+                w.m_steals.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (j)
+            m_queued.fetch_sub(1);
+        return j;
+    }
+
+    void job_system::execute(worker& w, job* j)
+    {
+        const uint64_t begin = vv_trace::now_ns();
+        {
+            VV_TRACE_SCOPE("job", j->m_name);
+            if (j->m_function)
+                j->m_function(*j);
+        }
+        w.m_busy_ns.fetch_add(vv_trace::now_ns() - begin, std::memory_order_relaxed);
+        w.m_jobs.fetch_add(1, std::memory_order_relaxed);
+        finish(w, j);
+    }
+
+    void job_system::finish(worker& w, job* j)
+    {
+        if (j->m_unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        // continuations first, they may be children of our parent
+        for (int i = 0; i < j->m_continuation_count; i++)
+            push(w, j->m_continuations[i]);
+        if (j->m_parent)
+            finish(w, j->m_parent);
+    }
+
+    void job_system::wait(const job* j)
+    {
+        worker& w = *this_worker();
+        while (j->m_unfinished.load(std::memory_order_acquire) > 0)
+        {
+            if (job* next = next_job(w))
+                execute(w, next);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    void job_system::worker_loop(unsigned index)
+    {
+        t_binding.m_system = this;
+        t_binding.m_index = index;
+        vv_trace::set_thread_name(worker_names[index]);
+        worker& w = m_workers[index];
+
+        int idle = 0;
+        while (m_running.load(std::memory_order_acquire))
+        {
+            if (job* j = next_job(w))
+            {
+                execute(w, j);
+                idle = 0;
+                continue;
+            }
+            // spin a little for the next stage, then sleep until something is queued
+            if (++idle < 64)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            idle = 0;
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            m_sleepers.fetch_add(1);
+            m_wake.wait(lock, [this] {return m_queued.load() > 0 || !m_running.load();});
+            m_sleepers.fetch_sub(1);
+        }
+    }
+
+    void job_system::begin_frame()
+    {
+        const uint64_t now = vv_trace::now_ns();
+        const double window = static_cast<double>(std::max<uint64_t>(now - m_window_begin_ns, 1));
+        m_window_begin_ns = now;
+        for (unsigned i = 0; i < m_worker_count; i++)
+        {
+            worker& w = m_workers[i];
+            const uint64_t busy = w.m_busy_ns.load(std::memory_order_relaxed);
+            const unsigned jobs = w.m_jobs.load(std::memory_order_relaxed);
+            const unsigned steals = w.m_steals.load(std::memory_order_relaxed);
+            w.m_stats.m_busy_ms = (busy - w.m_busy_mark) / 1e6;
+            w.m_stats.m_utilization = std::min(1.0, (busy - w.m_busy_mark) / window);
+            w.m_stats.m_jobs = jobs - w.m_jobs_mark;
+            w.m_stats.m_steals = steals - w.m_steals_mark;
+            w.m_busy_mark = busy;
+            w.m_jobs_mark = jobs;
+            w.m_steals_mark = steals;
+        }
+    }
+}
@@ -0,0 +1,165 @@
+#ifndef vv_jobs_h
+#define vv_jobs_h
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+namespace vv_jobs
+{
+    // Unit of work with a parent and continuations. A job is finished once its
+    // function returned and all its children finished; then its continuations
+    // are queued and its parent is told. Callables are copied into the payload,
+    // so they must be small and trivially destructible (lambdas capturing
+    // pointers and references).
+    struct job
+    {
+        static const std::size_t payload_size = 64;
+        static const int max_continuations = 8;
+
+        void              (*m_function)(job&) = nullptr;
+        const char*       m_name = "job";  // string literal, shows up in the trace
+        job*              m_parent = nullptr;
+        std::atomic<int>  m_unfinished{0};
+        int               m_continuation_count = 0;  // only touched before the job runs
+        job*              m_continuations[max_continuations];
+        alignas(16) unsigned char m_payload[payload_size];
+    };
+
+    // Chase-Lev deque of a worker: the owner pushes and pops at the bottom,
+    // thieves take from the top. Fixed capacity, push fails when full.
+    class work_stealing_deque
+    {
+    public:
+        static const std::size_t capacity = 4096;  // power of two
+
+        bool push(job* j);
+        job* pop();
+        job* steal();
+
+    protected:
+        std::atomic<long> m_top{0};
+        std::atomic<long> m_bottom{0};
+        std::atomic<job*> m_jobs[capacity];
+    };
+
+    // Work-stealing scheduler. The thread calling start() becomes worker 0 and
+    // helps while it waits; the other workers sleep when there is nothing to
+    // steal. Jobs come from per-worker rings that are recycled, so at most
+    // pool_size jobs per worker may be alive at once, which is plenty for a frame.
+    // Jobs must be created and run from worker threads only.
+    class job_system
+    {
+    public:
+        static const std::size_t pool_size = 4096;
+        static const unsigned max_workers = 16;
+
+        struct worker_stats
+        {
+            double   m_utilization = 0;  // busy share of the last frame
+            double   m_busy_ms     = 0;
+            unsigned m_jobs        = 0;
+            unsigned m_steals      = 0;
+        };
+
+        job_system() = default;
+        job_system(const job_system&) = delete;
+        job_system& operator=(const job_system&) = delete;
+        ~job_system() {stop();}
+
+        // workers including the calling thread, 0 takes the hardware threads
+        void start(unsigned workers = 0);
+        void stop();
+        unsigned worker_count() const {return m_worker_count;}
+
+        // job calling f(), child of parent when given; queue it with run()
+        template<class F>
+        job* create(job* parent, const F& f, const char* name = "job")
+        {
+            static_assert(sizeof(F) <= job::payload_size, "job callable too large");
+            static_assert(std::is_trivially_destructible<F>::value, "job callable must be trivially destructible");
+            job* j = allocate(parent, name);
+            new (j->m_payload) F(f);
+            j->m_function = [](job& self) {(*reinterpret_cast<F*>(self.m_payload))();};
+            return j;
+        }
+
+        // job that splits [0, count) into grain sized f(begin, end) children when it runs
+        template<class F>
+        job* parallel_for(job* parent, std::size_t count, std::size_t grain, const F& f, const char* name = "parallel_for")
+        {
+            struct range_job
+            {
+                F           m_f;
+                std::size_t m_count;
+                std::size_t m_grain;
+                job_system* m_system;
+                const char* m_name;
+            };
+            static_assert(sizeof(range_job) <= job::payload_size, "parallel_for callable too large");
+            static_assert(std::is_trivially_destructible<F>::value, "job callable must be trivially destructible");
+            job* j = allocate(parent, name);
+            new (j->m_payload) range_job{f, count, grain > 0 ? grain : 1, this, name};
+            j->m_function = [](job& self)
+            {
+                const range_job& r = *reinterpret_cast<const range_job*>(self.m_payload);
+                for (std::size_t begin = 0; begin < r.m_count; begin += r.m_grain)
+                {
+                    const std::size_t end = begin + r.m_grain < r.m_count ? begin + r.m_grain : r.m_count;
+                    const F* f = &r.m_f;  // lives in the parent, which outlasts its children
+                    r.m_system->run(r.m_system->create(&self, [f, begin, end]() {(*f)(begin, end);}, r.m_name));
+                }
+            };
+            return j;
+        }
+
+        // queues continuation once ancestor finished, before ancestor is run
+        bool add_continuation(job* ancestor, job* continuation);
+        void run(job* j);
+        // executes queued jobs until j finished
+        void wait(const job* j);
+
+        // closes the utilization window of the previous frame
+        void begin_frame();
+        const worker_stats& stats(unsigned worker) const {return m_workers[worker].m_stats;}
+
+    protected:
+        struct worker
+        {
+            work_stealing_deque    m_queue;
+            std::unique_ptr<job[]> m_pool;
+            std::size_t            m_pool_next = 0;
+            std::atomic<uint64_t>  m_busy_ns{0};
+            std::atomic<unsigned>  m_jobs{0};
+            std::atomic<unsigned>  m_steals{0};
+            uint64_t               m_busy_mark = 0;
+            unsigned               m_jobs_mark = 0;
+            unsigned               m_steals_mark = 0;
+            worker_stats           m_stats;
+            std::thread            m_thread;
+        };
+
+        job* allocate(job* parent, const char* name);
+        worker* this_worker() const;
+        job* next_job(worker& w);
+        void execute(worker& w, job* j);
+        void finish(worker& w, job* j);
+        void push(worker& w, job* j);
+        void worker_loop(unsigned index);
+
+        std::unique_ptr<worker[]> m_workers;
+        unsigned                  m_worker_count = 0;
+        std::atomic<bool>         m_running{false};
+        std::atomic<int>          m_queued{0};    // jobs sitting in the deques
+        std::atomic<int>          m_sleepers{0};
+        std::mutex                m_sleep_mutex;  // only taken to go to sleep or to wake someone
+        std::condition_variable   m_wake;
+        uint64_t                  m_window_begin_ns = 0;
+    };
+}
+#endif
@@ -0,0 +1,108 @@
+#include "vv_mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vv_mem
+{
+    mapped_file::~mapped_file()
+    {
+        close();
+    }
+
+#ifdef _WIN32
+    bool mapped_file::open(const std::string& path)
+    {
+        close();
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data)
+        {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        m_file = file;
+        m_mapping = mapping;
+        m_data = data;
+        m_size = static_cast<std::size_t>(size.QuadPart);
+        m_path = path;
+        return true;
+    }
+
+    void mapped_file::close()
+    {
+        if (m_data)
+            UnmapViewOfFile(m_data);
+        if (m_mapping)
+            CloseHandle(static_cast<HANDLE>(m_mapping));
+        if (m_file)
+            CloseHandle(static_cast<HANDLE>(m_file));
+        m_data = nullptr;
+        m_mapping = nullptr;
+        m_file = nullptr;
+        m_size = 0;
+        m_path.clear();
+    }
+#else
+    bool mapped_file::open(const std::string& path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        // out-of-core data is accessed node by node, not sequentially
+        madvise(data, st.st_size, MADV_RANDOM);
+        m_fd = fd;
+        m_data = data;
+        m_size = static_cast<std::size_t>(st.st_size);
+        m_path = path;
+        return true;
+    }
+
+    void mapped_file::close()
+    {
+        if (m_data)
+            munmap(const_cast<void*>(m_data), m_size);
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_data = nullptr;
+        m_fd = -1;
+        m_size = 0;
+        m_path.clear();
+    }
+#endif
+}
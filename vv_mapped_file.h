@@ -0,0 +1,37 @@
+#ifndef vv_mapped_file_h
+#define vv_mapped_file_h
+#include <cstddef>
+#include <string>
+
+namespace vv_mem
+{
+    // Read-only memory mapping of a whole file
+    class mapped_file
+    {
+    public:
+        mapped_file() = default;
+        ~mapped_file();
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        bool open(const std::string& path);
+        void close();
+
+        bool               is_open() const {return m_data != nullptr;}
+        const void*        data() const    {return m_data;}
+        std::size_t        size() const    {return m_size;}
+        const std::string& path() const    {return m_path;}
+
+    private:
+        const void* m_data = nullptr;
+        std::size_t m_size = 0;
+        std::string m_path;
+#ifdef _WIN32
+        void* m_file    = nullptr;
+        void* m_mapping = nullptr;
+#else
+        int   m_fd      = -1;
+#endif
+    };
+}
+#endif
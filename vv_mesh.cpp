@@ -0,0 +1,235 @@
+#include "vv_mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace vv_mesh
+{
+    namespace
+    {
+        // id of the first vertex with the same position, for every vertex
+        std::vector<uint32_t> weld_positions(const mesh& m)
+        {
+            struct key_hash
+            {
+                std::size_t operator()(const uint32_t* k) const {return k[0] * 73856093u ^ k[1] * 19349663u ^ k[2] * 83492791u;}
+            };
+            struct key_equal
+            {
+                bool operator()(const uint32_t* a, const uint32_t* b) const {return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];}
+            };
+
+            // exact bit patterns are enough, split vertices copy their positions
+            const std::size_t count = m.vertex_count();
+            std::vector<uint32_t> bits(count * 3);
+            if (count > 0)
+                std::memcpy(bits.data(), m.m_positions.data(), bits.size() * sizeof(uint32_t));
+
+            std::unordered_map<const uint32_t*, uint32_t, key_hash, key_equal> first;
+            first.reserve(count);
+            std::vector<uint32_t> weld(count);
+            for (std::size_t i = 0; i < count; i++)
+                weld[i] = first.emplace(&bits[3 * i], static_cast<uint32_t>(i)).first->second;
+            return weld;
+        }
+
+        void face_normal(const mesh& m, std::size_t tri, float n[3])
+        {
+            const float* p[3];
+            for (int k = 0; k < 3; k++)
+                p[k] = &m.m_positions[3 * m.m_indices[3 * tri + k]];
+            const float a[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+            const float b[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+            n[0] = a[1] * b[2] - a[2] * b[1];
+            n[1] = a[2] * b[0] - a[0] * b[2];
+            n[2] = a[0] * b[1] - a[1] * b[0];
+            const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (len > 0)
+                for (int k = 0; k < 3; k++)
+                    n[k] /= len;
+        }
+
+        uint64_t edge_key(uint32_t a, uint32_t b)
+        {
+            return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+        }
+
+        struct edge_info
+        {
+            uint32_t m_v0;
+            uint32_t m_v1;
+            uint32_t m_first_tri;
+            bool     m_visible;
+        };
+
+        // all position-welded edges in order of first appearance, crease test applied
+        std::vector<edge_info> collect_edges(const mesh& m, const std::vector<uint32_t>& weld, float crease_cos,
+                                             std::unordered_map<uint64_t, uint32_t>& lookup)
+        {
+            std::vector<edge_info> edges;
+            lookup.reserve(m.m_indices.size());
+            for (std::size_t t = 0; t < m.triangle_count(); t++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    const uint32_t a = m.m_indices[3 * t + k];
+                    const uint32_t b = m.m_indices[3 * t + (k + 1) % 3];
+                    auto it = lookup.emplace(edge_key(weld[a], weld[b]), static_cast<uint32_t>(edges.size()));
+                    if (it.second)
+                    {
+                        edges.push_back({a, b, static_cast<uint32_t>(t), true});
+                        continue;
+                    }
+                    // shared edge: hidden when the faces are coplanar enough
+                    edge_info& e = edges[it.first->second];
+                    float n0[3], n1[3];
+                    face_normal(m, e.m_first_tri, n0);
+                    face_normal(m, t, n1);
+                    if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] > crease_cos)
+                        e.m_visible = false;
+                }
+            }
+            return edges;
+        }
+    }
+
+    mesh make_box(float half_size)
+    {
+        static const float normals[6][3] =
+        {
+            {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}
+        };
+        mesh m;
+        m.m_positions.reserve(24 * 3);
+        m.m_normals.reserve(24 * 3);
+        m.m_indices.reserve(36);
+        for (int f = 0; f < 6; f++)
+        {
+            const float* n = normals[f];
+            // two axes spanning the face, ordered so the corners wind counter-clockwise
+            const int axis = n[0] != 0 ? 0 : (n[1] != 0 ? 1 : 2);
+            const float sign = n[axis];
+            const int u = (axis + 1) % 3;
+            const int v = (axis + 2) % 3;
+            const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+            const uint32_t base = static_cast<uint32_t>(m.vertex_count());
+            for (int c = 0; c < 4; c++)
+            {
+                float p[3];
+                p[axis] = sign * half_size;
+                p[u] = corners[c][0] * half_size;
+                p[v] = corners[c][1] * half_size * sign;
+                m.m_positions.insert(m.m_positions.end(), p, p + 3);
+                m.m_normals.insert(m.m_normals.end(), n, n + 3);
+            }
+            const uint32_t quad[6] = {base, base + 1, base + 2, base, base + 2, base + 3};
+            m.m_indices.insert(m.m_indices.end(), quad, quad + 6);
+        }
+        return m;
+    }
+
+    mesh make_sphere(float radius, int rings, int segments)
+    {
+        rings = std::max(rings, 2);
+        segments = std::max(segments, 3);
+        mesh m;
+        const std::size_t vertices = 2 + std::size_t(rings - 1) * segments;
+        m.m_positions.reserve(vertices * 3);
+        m.m_normals.reserve(vertices * 3);
+        m.m_indices.reserve(std::size_t(rings - 1) * segments * 6);
+
+        auto add_vertex = [&m, radius](float x, float y, float z)
+        {
+            const float n[3] = {x, y, z};
+            m.m_normals.insert(m.m_normals.end(), n, n + 3);
+            m.m_positions.push_back(x * radius);
+            m.m_positions.push_back(y * radius);
+            m.m_positions.push_back(z * radius);
+        };
+        const float pi = 3.14159265358979f;
+        add_vertex(0, 1, 0);
+        for (int r = 1; r < rings; r++)
+        {
+            const float theta = pi * r / rings;
+            for (int s = 0; s < segments; s++)
+            {
+                const float phi = 2 * pi * s / segments;
+                add_vertex(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi));
+            }
+        }
+        add_vertex(0, -1, 0);
+
+        // ring r starts at 1 + r * segments, the columns wrap around
+        const uint32_t bottom = static_cast<uint32_t>(vertices - 1);
+        auto at = [segments](int r, int s) {return static_cast<uint32_t>(1 + r * segments + s % segments);};
+        for (int s = 0; s < segments; s++)
+        {
+            const uint32_t cap[3] = {0, at(0, s), at(0, s + 1)};
+            m.m_indices.insert(m.m_indices.end(), cap, cap + 3);
+        }
+        for (int r = 0; r + 1 < rings - 1; r++)
+            for (int s = 0; s < segments; s++)
+            {
+                const uint32_t quad[6] = {at(r, s), at(r + 1, s), at(r + 1, s + 1),
+                                          at(r, s), at(r + 1, s + 1), at(r, s + 1)};
+                m.m_indices.insert(m.m_indices.end(), quad, quad + 6);
+            }
+        for (int s = 0; s < segments; s++)
+        {
+            const uint32_t cap[3] = {bottom, at(rings - 2, s + 1), at(rings - 2, s)};
+            m.m_indices.insert(m.m_indices.end(), cap, cap + 3);
+        }
+        return m;
+    }
+
+    std::vector<uint32_t> extract_edges(const mesh& m, float crease_cos)
+    {
+        const std::vector<uint32_t> weld = weld_positions(m);
+        std::unordered_map<uint64_t, uint32_t> lookup;
+        const std::vector<edge_info> edges = collect_edges(m, weld, crease_cos, lookup);
+
+        std::vector<uint32_t> lines;
+        lines.reserve(edges.size() * 2);
+        for (const edge_info& e : edges)
+        {
+            if (!e.m_visible)
+                continue;
+            lines.push_back(e.m_v0);
+            lines.push_back(e.m_v1);
+        }
+        return lines;
+    }
+
+    std::vector<float> unroll_with_barycentrics(const mesh& m, float crease_cos)
+    {
+        const std::vector<uint32_t> weld = weld_positions(m);
+        std::unordered_map<uint64_t, uint32_t> lookup;
+        const std::vector<edge_info> edges = collect_edges(m, weld, crease_cos, lookup);
+
+        std::vector<float> out;
+        out.reserve(m.triangle_count() * 27);
+        for (std::size_t t = 0; t < m.triangle_count(); t++)
+        {
+            const uint32_t* tri = &m.m_indices[3 * t];
+            // component k measures the distance to the edge opposite corner k
+            float hidden[3];
+            for (int k = 0; k < 3; k++)
+            {
+                const uint32_t a = weld[tri[(k + 1) % 3]];
+                const uint32_t b = weld[tri[(k + 2) % 3]];
+                hidden[k] = edges[lookup[edge_key(a, b)]].m_visible ? 0.f : 1.f;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                const float* p = &m.m_positions[3 * tri[k]];
+                const float* n = &m.m_normals[3 * tri[k]];
+                out.insert(out.end(), p, p + 3);
+                out.insert(out.end(), n, n + 3);
+                for (int c = 0; c < 3; c++)
+                    out.push_back((c == k ? 1.f : 0.f) + hidden[c]);
+            }
+        }
+        return out;
+    }
+}
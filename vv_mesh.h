@@ -0,0 +1,44 @@
+#ifndef vv_mesh_h
+#define vv_mesh_h
+#include <cstdint>
+#include <vector>
+
+namespace vv_mesh
+{
+    // Indexed triangle mesh. Vertices are split wherever the normal changes,
+    // so several vertices can share one position.
+    struct mesh
+    {
+        std::vector<float>    m_positions;  // xyz per vertex
+        std::vector<float>    m_normals;    // xyz per vertex
+        std::vector<uint32_t> m_indices;    // three per triangle
+
+        std::size_t vertex_count() const   {return m_positions.size() / 3;}
+        std::size_t triangle_count() const {return m_indices.size() / 3;}
+    };
+
+    // axis aligned cube around the origin, flat normals, two triangles per face
+    mesh make_box(float half_size);
+
+    // UV sphere around the origin with smooth normals, one vertex per pole and
+    // no seam column, 2 * segments * (rings - 1) triangles
+    mesh make_sphere(float radius, int rings, int segments);
+
+    // crease_cos values for the edge functions below: every edge, or only those
+    // between faces more than about 0.8 degrees apart, which hides the diagonals
+    // of flat quads but also most edges of a finely tessellated surface
+    const float all_edges = 2.f;
+    const float flat_crease_cos = 0.9999f;
+
+    // Unique edges as vertex index pairs for GL_LINES. Edges are matched by position,
+    // so split vertices don't produce duplicates. An edge between two faces whose
+    // normals are closer than crease_cos (cosine of the angle) is skipped.
+    std::vector<uint32_t> extract_edges(const mesh& m, float crease_cos = all_edges);
+
+    // Unindexed copy for single-pass wireframe: per corner position, normal and
+    // a barycentric coordinate. Components that belong to edges dropped by
+    // extract_edges() are raised by one so the shader never draws them.
+    // Layout: 9 floats per vertex, 3 vertices per triangle.
+    std::vector<float> unroll_with_barycentrics(const mesh& m, float crease_cos = all_edges);
+}
+#endif
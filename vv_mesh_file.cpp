@@ -0,0 +1,356 @@
+#include "vv_mesh_file.h"
+#include "vv_mesh_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace vv_mesh
+{
+    namespace
+    {
+        const uint64_t block_alignment = 16;
+
+        uint64_t align_block(uint64_t offset)
+        {
+            return (offset + block_alignment - 1) & ~(block_alignment - 1);
+        }
+
+        struct lod_level
+        {
+            std::vector<uint32_t> m_indices;
+            float                 m_max_error;
+        };
+
+        // Snaps every vertex to the first vertex of its grid cell and drops the
+        // triangles that collapse. The indices keep pointing into the shared vertex block.
+        lod_level cluster_vertices(const mesh& m, const float mn[3], float cell)
+        {
+            const std::size_t count = m.vertex_count();
+            std::unordered_map<uint64_t, uint32_t> cells;
+            cells.reserve(count / 4);
+            std::vector<uint32_t> remap(count);
+            lod_level level;
+            level.m_max_error = 0;
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const float* p = &m.m_positions[3 * i];
+                uint64_t key = 0;
+                for (int k = 0; k < 3; k++)
+                    key = key << 21 | (static_cast<uint64_t>((p[k] - mn[k]) / cell) & 0x1fffff);
+                const uint32_t r = cells.emplace(key, static_cast<uint32_t>(i)).first->second;
+                remap[i] = r;
+                const float* q = &m.m_positions[3 * r];
+                const float d2 = (p[0] - q[0]) * (p[0] - q[0]) + (p[1] - q[1]) * (p[1] - q[1]) + (p[2] - q[2]) * (p[2] - q[2]);
+                level.m_max_error = std::max(level.m_max_error, std::sqrt(d2));
+            }
+            level.m_indices.reserve(m.m_indices.size() / 2);
+            for (std::size_t t = 0; t < m.triangle_count(); t++)
+            {
+                const uint32_t a = remap[m.m_indices[3 * t]];
+                const uint32_t b = remap[m.m_indices[3 * t + 1]];
+                const uint32_t c = remap[m.m_indices[3 * t + 2]];
+                if (a == b || b == c || a == c)
+                    continue;
+                level.m_indices.push_back(a);
+                level.m_indices.push_back(b);
+                level.m_indices.push_back(c);
+            }
+            return level;
+        }
+
+        // index deltas are small for meshes with any locality, zigzag keeps negative ones short
+        void compress_indices(const std::vector<uint32_t>& indices, std::vector<uint8_t>& out)
+        {
+            out.reserve(indices.size() * 2);
+            uint32_t previous = 0;
+            for (uint32_t index : indices)
+            {
+                const int32_t delta = static_cast<int32_t>(index - previous);
+                uint32_t v = (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+                previous = index;
+                while (v >= 0x80)
+                {
+                    out.push_back(static_cast<uint8_t>(v | 0x80));
+                    v >>= 7;
+                }
+                out.push_back(static_cast<uint8_t>(v));
+            }
+        }
+
+        // false on truncated data or an index that is not below vertex_count
+        bool decompress_indices(const uint8_t* data, uint64_t size, uint32_t vertex_count, std::vector<uint32_t>& out)
+        {
+            const uint8_t* end = data + size;
+            uint32_t previous = 0;
+            for (uint32_t& index : out)
+            {
+                uint32_t v = 0;
+                for (int shift = 0; ; shift += 7)
+                {
+                    if (data == end || shift > 28)
+                        return false;
+                    const uint8_t byte = *data++;
+                    v |= static_cast<uint32_t>(byte & 0x7f) << shift;
+                    if (!(byte & 0x80))
+                        break;
+                }
+                previous += static_cast<uint32_t>(v >> 1) ^ (0u - (v & 1));
+                if (previous >= vertex_count)
+                    return false;
+                index = previous;
+            }
+            return data == end;
+        }
+
+        // written so that a crafted offset can't wrap the sum around
+        bool block_in_file(uint64_t offset, uint64_t length, std::size_t file_size)
+        {
+            return offset <= file_size && length <= file_size - offset;
+        }
+
+        bool indices_below(const uint32_t* indices, std::size_t count, uint32_t vertex_count)
+        {
+            for (std::size_t i = 0; i < count; i++)
+                if (indices[i] >= vertex_count)
+                    return false;
+            return true;
+        }
+
+        bool write_block(FILE* f, uint64_t offset, const void* data, std::size_t size)
+        {
+            static const char zeros[block_alignment] = {};
+            const long at = std::ftell(f);
+            if (at < 0 || static_cast<uint64_t>(at) > offset)
+                return false;
+            const std::size_t padding = static_cast<std::size_t>(offset - at);
+            return (padding == 0 || std::fwrite(zeros, padding, 1, f) == 1) &&
+                   (size == 0 || std::fwrite(data, size, 1, f) == 1);
+        }
+    }
+
+    bool write_mesh_file(const std::string& path, const mesh& m, const write_options& options, std::string& error)
+    {
+        if (m.vertex_count() == 0 || m.triangle_count() == 0)
+        {
+            error = "no triangles to write";
+            return false;
+        }
+        if (m.m_normals.size() != m.m_positions.size() || m.m_indices.size() % 3 != 0)
+        {
+            error = "inconsistent mesh arrays";
+            return false;
+        }
+        for (uint32_t index : m.m_indices)
+            if (index >= m.vertex_count())
+            {
+                error = "vertex index out of range";
+                return false;
+            }
+
+        file_header header;
+        std::memset(&header, 0, sizeof(header));
+        for (int k = 0; k < 3; k++)
+            header.m_min[k] = header.m_max[k] = m.m_positions[k];
+        for (std::size_t i = 0; i < m.vertex_count(); i++)
+            for (int k = 0; k < 3; k++)
+            {
+                header.m_min[k] = std::min(header.m_min[k], m.m_positions[3 * i + k]);
+                header.m_max[k] = std::max(header.m_max[k], m.m_positions[3 * i + k]);
+            }
+
+        // LOD 0 is the mesh itself, every further level doubles the cell size
+        std::vector<lod_record> lods(1);
+        lods[0].m_first_index = 0;
+        lods[0].m_index_count = static_cast<uint32_t>(m.m_indices.size());
+        lods[0].m_max_error = 0;
+        lods[0].m_reserved = 0;
+        std::vector<uint32_t> indices = m.m_indices;
+        const float extent = std::max(header.m_max[0] - header.m_min[0],
+                             std::max(header.m_max[1] - header.m_min[1], header.m_max[2] - header.m_min[2]));
+        float cell = extent / 256;
+        while (lods.size() < options.m_max_lods && cell > 0)
+        {
+            lod_level level = cluster_vertices(m, header.m_min, cell);
+            cell *= 2;
+            const std::size_t previous = lods.back().m_index_count;
+            if (level.m_indices.size() > previous * 3 / 4)
+                continue;  // too little gain, a coarser grid may still pay off
+            if (level.m_indices.empty())
+                break;
+            // LOD 0 keeps the caller's order, which may be tuned for overdraw as well
+            optimize_vertex_cache(level.m_indices.data(), level.m_indices.size(), m.vertex_count());
+            lod_record lod;
+            lod.m_first_index = static_cast<uint32_t>(indices.size());
+            lod.m_index_count = static_cast<uint32_t>(level.m_indices.size());
+            lod.m_max_error = level.m_max_error;
+            lod.m_reserved = 0;
+            lods.push_back(lod);
+            indices.insert(indices.end(), level.m_indices.begin(), level.m_indices.end());
+            if (cell > extent)
+                break;
+        }
+
+        std::vector<vertex_record> vertices(m.vertex_count());
+        for (std::size_t i = 0; i < vertices.size(); i++)
+            for (int k = 0; k < 3; k++)
+            {
+                vertices[i].m_pos[k] = m.m_positions[3 * i + k];
+                vertices[i].m_normal[k] = m.m_normals[3 * i + k];
+            }
+        const std::vector<uint32_t> edges = extract_edges(m, options.m_crease_cos);
+        std::vector<uint8_t> compressed;
+        if (options.m_compress)
+            compress_indices(indices, compressed);
+
+        std::memcpy(header.m_magic, file_magic, sizeof(header.m_magic));
+        header.m_version = file_version;
+        header.m_flags = options.m_compress ? flag_compressed_indices : 0;
+        header.m_vertex_count = static_cast<uint32_t>(vertices.size());
+        header.m_index_count = static_cast<uint32_t>(indices.size());
+        header.m_edge_index_count = static_cast<uint32_t>(edges.size());
+        header.m_lod_count = static_cast<uint32_t>(lods.size());
+        header.m_crease_cos = options.m_crease_cos;
+        header.m_lods_offset = align_block(sizeof(file_header));
+        header.m_vertices_offset = align_block(header.m_lods_offset + lods.size() * sizeof(lod_record));
+        uint64_t next = header.m_vertices_offset + vertices.size() * sizeof(vertex_record);
+        if (!options.m_compress)
+        {
+            header.m_indices_offset = align_block(next);
+            next = header.m_indices_offset + indices.size() * sizeof(uint32_t);
+        }
+        header.m_edges_offset = align_block(next);
+        next = header.m_edges_offset + edges.size() * sizeof(uint32_t);
+        if (options.m_compress)
+        {
+            header.m_compressed_offset = align_block(next);
+            header.m_compressed_size = compressed.size();
+        }
+
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f)
+        {
+            error = "couldn't open " + path + " for writing";
+            return false;
+        }
+        bool ok = write_block(f, 0, &header, sizeof(header));
+        ok = ok && write_block(f, header.m_lods_offset, lods.data(), lods.size() * sizeof(lod_record));
+        ok = ok && write_block(f, header.m_vertices_offset, vertices.data(), vertices.size() * sizeof(vertex_record));
+        if (!options.m_compress)
+            ok = ok && write_block(f, header.m_indices_offset, indices.data(), indices.size() * sizeof(uint32_t));
+        ok = ok && write_block(f, header.m_edges_offset, edges.data(), edges.size() * sizeof(uint32_t));
+        if (options.m_compress)
+            ok = ok && write_block(f, header.m_compressed_offset, compressed.data(), compressed.size());
+        ok = (std::fclose(f) == 0) && ok;
+        if (!ok)
+            error = "write error in " + path;
+        return ok;
+    }
+
+    const file_header* validate_mesh_file(const void* data, std::size_t size)
+    {
+        if (!data || size < sizeof(file_header))
+            return nullptr;
+        const file_header* header = static_cast<const file_header*>(data);
+        if (std::memcmp(header->m_magic, file_magic, sizeof(file_magic)) != 0 ||
+                header->m_version != file_version)
+            return nullptr;
+        const bool compressed = (header->m_flags & flag_compressed_indices) != 0;
+        const uint64_t offsets[4] = {header->m_lods_offset, header->m_vertices_offset,
+                                     compressed ? header->m_compressed_offset : header->m_indices_offset,
+                                     header->m_edges_offset};
+        for (uint64_t offset : offsets)
+            if (offset % block_alignment != 0 || offset < sizeof(file_header))
+                return nullptr;
+        if (header->m_vertex_count == 0 || header->m_lod_count == 0 ||
+                !block_in_file(header->m_lods_offset, uint64_t(header->m_lod_count) * sizeof(lod_record), size) ||
+                !block_in_file(header->m_vertices_offset, uint64_t(header->m_vertex_count) * sizeof(vertex_record), size) ||
+                !block_in_file(header->m_edges_offset, uint64_t(header->m_edge_index_count) * sizeof(uint32_t), size))
+            return nullptr;
+        // a compressed index takes at least a byte, which bounds the decode buffer
+        if (compressed ? !block_in_file(header->m_compressed_offset, header->m_compressed_size, size) ||
+                             header->m_index_count > header->m_compressed_size
+                       : !block_in_file(header->m_indices_offset, uint64_t(header->m_index_count) * sizeof(uint32_t), size))
+            return nullptr;
+
+        // the LOD table is a handful of records
+        const lod_record* lods = reinterpret_cast<const lod_record*>(
+            static_cast<const char*>(data) + header->m_lods_offset);
+        for (uint32_t i = 0; i < header->m_lod_count; i++)
+            if (lods[i].m_index_count % 3 != 0 ||
+                    uint64_t(lods[i].m_first_index) + lods[i].m_index_count > header->m_index_count)
+                return nullptr;
+
+        // every index is read on upload anyway; compressed ones are checked as they are decoded
+        const char* base = static_cast<const char*>(data);
+        if (!indices_below(reinterpret_cast<const uint32_t*>(base + header->m_edges_offset),
+                           header->m_edge_index_count, header->m_vertex_count))
+            return nullptr;
+        if (!compressed && !indices_below(reinterpret_cast<const uint32_t*>(base + header->m_indices_offset),
+                                          header->m_index_count, header->m_vertex_count))
+            return nullptr;
+        return header;
+    }
+
+    bool mesh_file::open(const std::string& path)
+    {
+        close();
+        if (!m_file.open(path))
+            return false;
+        const file_header* header = validate_mesh_file(m_file.data(), m_file.size());
+        if (!header)
+        {
+            m_file.close();
+            return false;
+        }
+        const char* base = static_cast<const char*>(m_file.data());
+        if (header->m_flags & flag_compressed_indices)
+        {
+            m_decoded.resize(header->m_index_count);
+            if (!decompress_indices(reinterpret_cast<const uint8_t*>(base + header->m_compressed_offset),
+                                    header->m_compressed_size, header->m_vertex_count, m_decoded))
+            {
+                close();
+                return false;
+            }
+            m_indices = m_decoded.data();
+        }
+        else
+            m_indices = reinterpret_cast<const uint32_t*>(base + header->m_indices_offset);
+        m_lods = reinterpret_cast<const lod_record*>(base + header->m_lods_offset);
+        m_vertices = reinterpret_cast<const vertex_record*>(base + header->m_vertices_offset);
+        m_edges = reinterpret_cast<const uint32_t*>(base + header->m_edges_offset);
+        m_header = header;
+        return true;
+    }
+
+    void mesh_file::close()
+    {
+        m_file.close();
+        m_header = nullptr;
+        m_lods = nullptr;
+        m_vertices = nullptr;
+        m_indices = nullptr;
+        m_edges = nullptr;
+        std::vector<uint32_t>().swap(m_decoded);
+    }
+
+    mesh mesh_file::to_mesh() const
+    {
+        mesh m;
+        if (!m_header)
+            return m;
+        m.m_positions.resize(std::size_t(m_header->m_vertex_count) * 3);
+        m.m_normals.resize(m.m_positions.size());
+        for (std::size_t i = 0; i < m_header->m_vertex_count; i++)
+            for (int k = 0; k < 3; k++)
+            {
+                m.m_positions[3 * i + k] = m_vertices[i].m_pos[k];
+                m.m_normals[3 * i + k] = m_vertices[i].m_normal[k];
+            }
+        const uint32_t* first = m_indices + m_lods[0].m_first_index;
+        m.m_indices.assign(first, first + m_lods[0].m_index_count);
+        return m;
+    }
+}
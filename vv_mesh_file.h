@@ -0,0 +1,110 @@
+#ifndef vv_mesh_file_h
+#define vv_mesh_file_h
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "vv_mapped_file.h"
+#include "vv_mesh.h"
+
+// On-disk triangle mesh, blocks stored the way the GPU buffers take them, so
+// loading is a mapping and a glBufferData per block. All LODs share the vertex
+// block and own a range of the index block. Edges are the unique edges of
+// LOD 0 as GL_LINES pairs (see vv_mesh::extract_edges).
+// The index block can instead be stored compressed, as zigzag deltas in
+// LEB128 varints; such files are smaller but need a decode pass on load.
+//
+// layout: file_header | lod_record[lod_count] | vertex_record[vertex_count] |
+//         uint32_t index[index_count] | uint32_t edge[edge_index_count] | compressed indices
+// every block starts at a multiple of 16 bytes
+namespace vv_mesh
+{
+    const char     file_magic[8] = {'V', 'V', 'M', 'E', 'S', 'H', 0, 0};
+    const uint32_t file_version  = 1;
+
+    // file_header::m_flags
+    const uint32_t flag_compressed_indices = 1;  // m_indices_offset is 0, see m_compressed_offset
+
+    struct file_header
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_flags;
+        uint32_t m_vertex_count;
+        uint32_t m_index_count;       // all LODs
+        uint32_t m_edge_index_count;
+        uint32_t m_lod_count;
+        uint64_t m_lods_offset;
+        uint64_t m_vertices_offset;
+        uint64_t m_indices_offset;
+        uint64_t m_edges_offset;
+        uint64_t m_compressed_offset;
+        uint64_t m_compressed_size;
+        float    m_min[3];
+        float    m_max[3];
+        float    m_crease_cos;  // the edges were extracted with it, 0 in older files: flat_crease_cos
+        uint32_t m_reserved;
+    };
+
+    struct lod_record
+    {
+        uint32_t m_first_index;
+        uint32_t m_index_count;
+        float    m_max_error;  // object space distance the LOD may be off by
+        uint32_t m_reserved;
+    };
+
+    // interleaved as in vv_gl::mesh_renderer's vertex buffer
+    struct vertex_record
+    {
+        float m_pos[3];
+        float m_normal[3];
+    };
+
+    static_assert(sizeof(file_header) == 112, "unexpected file_header layout");
+    static_assert(sizeof(lod_record) == 16, "unexpected lod_record layout");
+    static_assert(sizeof(vertex_record) == 24, "unexpected vertex_record layout");
+
+    struct write_options
+    {
+        uint32_t m_max_lods = 4;  // including the full mesh
+        bool     m_compress = false;
+        float    m_crease_cos = all_edges;  // see extract_edges()
+    };
+
+    // LODs by vertex clustering, each one stops when it no longer removes a quarter of the triangles
+    bool write_mesh_file(const std::string& path, const mesh& m, const write_options& options, std::string& error);
+
+    // Checks the block ranges of a mapped file and that stored indices address existing
+    // vertices, returns nullptr if it is not a valid mesh. Compressed indices can only
+    // be checked as mesh_file::open() decodes them.
+    const file_header* validate_mesh_file(const void* data, std::size_t size);
+
+    // A mapped mesh file, blocks point straight into the mapping
+    class mesh_file
+    {
+    public:
+        bool open(const std::string& path);
+        void close();
+        bool is_open() const {return m_header != nullptr;}
+
+        const file_header*   header() const   {return m_header;}
+        const lod_record*    lods() const     {return m_lods;}
+        const vertex_record* vertices() const {return m_vertices;}
+        const uint32_t*      indices() const  {return m_indices;}
+        const uint32_t*      edges() const    {return m_edges;}
+
+        // CPU side copy of LOD 0
+        mesh to_mesh() const;
+
+    protected:
+        vv_mem::mapped_file   m_file;
+        const file_header*    m_header   = nullptr;
+        const lod_record*     m_lods     = nullptr;
+        const vertex_record*  m_vertices = nullptr;
+        const uint32_t*       m_indices  = nullptr;
+        const uint32_t*       m_edges    = nullptr;
+        std::vector<uint32_t> m_decoded;  // only for compressed indices
+    };
+}
+#endif
@@ -0,0 +1,523 @@
+#include "vv_mesh_optimize.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace vv_mesh
+{
+    namespace
+    {
+        // Forsyth's scoring, his published constants
+        const int   score_cache_size     = 32;
+        const float cache_decay_power    = 1.5f;
+        const float last_triangle_score  = 0.75f;
+        const float valence_boost_scale  = 2.0f;
+        const float valence_boost_power  = 0.5f;
+        const int   max_scored_valence   = 64;
+
+        struct score_table
+        {
+            float m_cache[score_cache_size];
+            float m_valence[max_scored_valence];
+
+            score_table()
+            {
+                for (int i = 0; i < score_cache_size; i++)
+                    m_cache[i] = i < 3 ? last_triangle_score
+                                       : std::pow(1 - float(i - 3) / (score_cache_size - 3), cache_decay_power);
+                m_valence[0] = 0;
+                for (int i = 1; i < max_scored_valence; i++)
+                    m_valence[i] = valence_boost_scale * std::pow(float(i), -valence_boost_power);
+            }
+
+            float vertex(int cache_position, uint32_t valence) const
+            {
+                if (valence == 0)
+                    return -1;  // no triangles left, never pick it
+                const float cache = cache_position >= 0 ? m_cache[cache_position] : 0;
+                return cache + m_valence[std::min<uint32_t>(valence, max_scored_valence - 1)];
+            }
+        };
+
+        // triangles around every vertex, compressed rows
+        struct adjacency
+        {
+            std::vector<uint32_t> m_offsets;    // vertex_count + 1
+            std::vector<uint32_t> m_triangles;
+
+            adjacency(const uint32_t* indices, std::size_t index_count, std::size_t vertex_count)
+                : m_offsets(vertex_count + 1, 0), m_triangles(index_count)
+            {
+                for (std::size_t i = 0; i < index_count; i++)
+                    m_offsets[indices[i] + 1]++;
+                for (std::size_t v = 0; v < vertex_count; v++)
+                    m_offsets[v + 1] += m_offsets[v];
+                std::vector<uint32_t> fill(m_offsets.begin(), m_offsets.end() - 1);
+                for (std::size_t i = 0; i < index_count; i++)
+                    m_triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        };
+
+        void triangle_normal(const float* a, const float* b, const float* c, float n[3])
+        {
+            const float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            const float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            n[0] = u[1] * v[2] - u[2] * v[1];
+            n[1] = u[2] * v[0] - u[0] * v[2];
+            n[2] = u[0] * v[1] - u[1] * v[0];
+        }
+
+        // triangles that start with an empty cache, where a cluster may begin without extra misses
+        std::vector<uint32_t> hard_boundaries(const uint32_t* indices, std::size_t index_count,
+                                              std::size_t vertex_count, unsigned cache_size)
+        {
+            std::vector<uint32_t> cached_at(vertex_count, 0);
+            uint32_t time = cache_size + 1;
+            std::vector<uint32_t> starts;
+            for (std::size_t t = 0; t < index_count / 3; t++)
+            {
+                int misses = 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    const uint32_t v = indices[3 * t + k];
+                    if (time - cached_at[v] > cache_size)
+                    {
+                        cached_at[v] = time++;
+                        misses++;
+                    }
+                }
+                if (t == 0 || misses == 3)
+                    starts.push_back(static_cast<uint32_t>(t));
+            }
+            return starts;
+        }
+
+        // Splits the hard clusters further wherever the part so far is no worse
+        // for the cache than threshold times the whole cluster; the next part
+        // starts cold. Whole closed surfaces have no direction, patches do.
+        std::vector<uint32_t> soft_boundaries(const uint32_t* indices, std::size_t index_count, std::size_t vertex_count,
+                                              const std::vector<uint32_t>& hard, unsigned cache_size, float threshold)
+        {
+            const unsigned min_triangles = 16;
+            const uint32_t triangle_count = static_cast<uint32_t>(index_count / 3);
+            std::vector<uint32_t> cached_at(vertex_count, 0);
+            uint32_t time = cache_size + 1;
+            auto misses = [&](uint32_t t)
+            {
+                int m = 0;
+                for (int k = 0; k < 3; k++)
+                    if (time - cached_at[indices[3 * t + k]] > cache_size)
+                    {
+                        cached_at[indices[3 * t + k]] = time++;
+                        m++;
+                    }
+                return m;
+            };
+
+            std::vector<uint32_t> starts;
+            for (std::size_t c = 0; c < hard.size(); c++)
+            {
+                const uint32_t begin = hard[c];
+                const uint32_t end = c + 1 < hard.size() ? hard[c + 1] : triangle_count;
+                time += cache_size + 1;  // every entry stale
+                std::size_t total = 0;
+                for (uint32_t t = begin; t < end; t++)
+                    total += misses(t);
+                const float limit = float(total) / (end - begin) * threshold;
+
+                time += cache_size + 1;
+                starts.push_back(begin);
+                uint32_t start = begin;
+                std::size_t part = 0;
+                for (uint32_t t = begin; t < end; t++)
+                {
+                    part += misses(t);
+                    const uint32_t size = t + 1 - start;
+                    if (t + 1 < end && size >= min_triangles && float(part) / size <= limit)
+                    {
+                        starts.push_back(t + 1);
+                        start = t + 1;
+                        part = 0;
+                        time += cache_size + 1;
+                    }
+                }
+            }
+            return starts;
+        }
+
+        // clusters given by their first triangle, sorted by how far out they face
+        void sort_clusters(const uint32_t* source, uint32_t* destination, std::size_t triangle_count,
+                           const std::vector<uint32_t>& starts, const float* positions, std::size_t stride,
+                           const float centroid[3])
+        {
+            struct cluster
+            {
+                uint32_t m_begin;
+                uint32_t m_end;
+                float    m_key;
+            };
+            std::vector<cluster> clusters(starts.size());
+            for (std::size_t c = 0; c < starts.size(); c++)
+            {
+                cluster& cl = clusters[c];
+                cl.m_begin = starts[c];
+                cl.m_end = c + 1 < starts.size() ? starts[c + 1] : static_cast<uint32_t>(triangle_count);
+                float center[3] = {0, 0, 0}, normal[3] = {0, 0, 0}, area = 0;
+                for (uint32_t t = cl.m_begin; t < cl.m_end; t++)
+                {
+                    const float* p[3];
+                    for (int k = 0; k < 3; k++)
+                        p[k] = positions + source[3 * t + k] * stride;
+                    float n[3];
+                    triangle_normal(p[0], p[1], p[2], n);
+                    const float a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    for (int k = 0; k < 3; k++)
+                    {
+                        center[k] += (p[0][k] + p[1][k] + p[2][k]) / 3 * a;
+                        normal[k] += n[k];
+                    }
+                    area += a;
+                }
+                cl.m_key = 0;
+                if (area > 0)
+                    for (int k = 0; k < 3; k++)
+                        cl.m_key += (center[k] / area - centroid[k]) * normal[k] / area;
+            }
+            std::stable_sort(clusters.begin(), clusters.end(),
+                             [](const cluster& a, const cluster& b) {return a.m_key > b.m_key;});
+            for (const cluster& cl : clusters)
+            {
+                std::copy(source + 3 * cl.m_begin, source + 3 * cl.m_end, destination);
+                destination += 3 * (cl.m_end - cl.m_begin);
+            }
+        }
+
+        // scanline free rasterizer: edge functions over the triangle's pixel rectangle
+        void rasterize_view(const float* positions, std::size_t stride, const uint32_t* indices, std::size_t index_count,
+                            int axis, bool from_positive, const float mn[3], const float mx[3], int resolution,
+                            std::vector<float>& depth, uint64_t& covered, uint64_t& shaded)
+        {
+            // screen axes cyclic with the view axis keep counter-clockwise front faces counter-clockwise
+            const int u = from_positive ? (axis + 1) % 3 : (axis + 2) % 3;
+            const int v = from_positive ? (axis + 2) % 3 : (axis + 1) % 3;
+            const float su = mx[u] > mn[u] ? (resolution - 1) / (mx[u] - mn[u]) : 0;
+            const float sv = mx[v] > mn[v] ? (resolution - 1) / (mx[v] - mn[v]) : 0;
+            depth.assign(std::size_t(resolution) * resolution, std::numeric_limits<float>::max());
+
+            for (std::size_t t = 0; t + 2 < index_count; t += 3)
+            {
+                float x[3], y[3], z[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    const float* p = positions + indices[t + k] * stride;
+                    x[k] = (p[u] - mn[u]) * su;
+                    y[k] = (p[v] - mn[v]) * sv;
+                    z[k] = from_positive ? -p[axis] : p[axis];
+                }
+                const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+                if (area <= 0)
+                    continue;  // back face or edge on
+                const int x0 = std::max(0, static_cast<int>(std::ceil(std::min(x[0], std::min(x[1], x[2])))));
+                const int x1 = std::min(resolution - 1, static_cast<int>(std::floor(std::max(x[0], std::max(x[1], x[2])))));
+                const int y0 = std::max(0, static_cast<int>(std::ceil(std::min(y[0], std::min(y[1], y[2])))));
+                const int y1 = std::min(resolution - 1, static_cast<int>(std::floor(std::max(y[0], std::max(y[1], y[2])))));
+                for (int py = y0; py <= y1; py++)
+                    for (int px = x0; px <= x1; px++)
+                    {
+                        float w[3];
+                        for (int k = 0; k < 3; k++)
+                        {
+                            const int a = (k + 1) % 3, b = (k + 2) % 3;
+                            w[k] = ((x[b] - x[a]) * (py - y[a]) - (y[b] - y[a]) * (px - x[a])) / area;
+                        }
+                        if (w[0] < 0 || w[1] < 0 || w[2] < 0)
+                            continue;
+                        const float d = w[0] * z[0] + w[1] * z[1] + w[2] * z[2];
+                        float& stored = depth[std::size_t(py) * resolution + px];
+                        if (stored == std::numeric_limits<float>::max())
+                            covered++;
+                        if (d < stored)
+                        {
+                            stored = d;
+                            shaded++;
+                        }
+                    }
+            }
+        }
+    }
+
+    vertex_cache_stats analyze_vertex_cache(const uint32_t* indices, std::size_t index_count,
+                                            std::size_t vertex_count, unsigned cache_size)
+    {
+        vertex_cache_stats s;
+        if (index_count < 3)
+            return s;
+        // a vertex is cached while fewer than cache_size misses happened since it was loaded
+        std::vector<uint32_t> cached_at(vertex_count, 0);
+        std::vector<bool> used(vertex_count, false);
+        uint32_t time = cache_size + 1;
+        std::size_t misses = 0, unique = 0;
+        for (std::size_t i = 0; i < index_count; i++)
+        {
+            const uint32_t v = indices[i];
+            if (time - cached_at[v] > cache_size)
+            {
+                cached_at[v] = time++;
+                misses++;
+            }
+            if (!used[v])
+            {
+                used[v] = true;
+                unique++;
+            }
+        }
+        s.m_acmr = float(misses) / (index_count / 3);
+        s.m_atvr = unique ? float(misses) / unique : 0;
+        return s;
+    }
+
+    float analyze_overdraw(const float* positions, std::size_t stride, const uint32_t* indices,
+                           std::size_t index_count, int resolution)
+    {
+        if (index_count < 3)
+            return 0;
+        float mn[3], mx[3];
+        for (int k = 0; k < 3; k++)
+            mn[k] = mx[k] = positions[indices[0] * stride + k];
+        for (std::size_t i = 0; i < index_count; i++)
+            for (int k = 0; k < 3; k++)
+            {
+                mn[k] = std::min(mn[k], positions[indices[i] * stride + k]);
+                mx[k] = std::max(mx[k], positions[indices[i] * stride + k]);
+            }
+        std::vector<float> depth;
+        uint64_t covered = 0, shaded = 0;
+        for (int axis = 0; axis < 3; axis++)
+            for (int side = 0; side < 2; side++)
+                rasterize_view(positions, stride, indices, index_count, axis, side == 0, mn, mx, resolution,
+                               depth, covered, shaded);
+        return covered ? float(shaded) / covered : 0;
+    }
+
+    void optimize_vertex_cache(uint32_t* indices, std::size_t index_count, std::size_t vertex_count)
+    {
+        const std::size_t triangle_count = index_count / 3;
+        if (triangle_count < 2)
+            return;
+        static const score_table scores;
+        adjacency adj(indices, index_count, vertex_count);
+        std::vector<uint32_t> valence(vertex_count);
+        std::vector<float> vertex_score(vertex_count);
+        std::vector<int> cache_position(vertex_count, -1);
+        for (std::size_t v = 0; v < vertex_count; v++)
+        {
+            valence[v] = adj.m_offsets[v + 1] - adj.m_offsets[v];
+            vertex_score[v] = scores.vertex(-1, valence[v]);
+        }
+        std::vector<bool> emitted(triangle_count, false);
+
+        std::vector<uint32_t> output;
+        output.reserve(index_count);
+        // LRU with room for the three new vertices in front
+        uint32_t cache[score_cache_size + 3];
+        int cache_count = 0;
+        std::size_t scan = 0;  // restart point when the cache offers nothing
+        // start where the valence is lowest, on a border if there is one
+        std::size_t best = 0;
+        float best_score = -1;
+        for (std::size_t t = 0; t < triangle_count; t++)
+        {
+            const float s = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] +
+                            vertex_score[indices[3 * t + 2]];
+            if (s > best_score)
+            {
+                best_score = s;
+                best = t;
+            }
+        }
+
+        for (std::size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++)
+        {
+            if (best == triangle_count)
+            {
+                while (emitted[scan])
+                    scan++;
+                best = scan;
+            }
+            const uint32_t* tri = &indices[3 * best];
+            emitted[best] = true;
+            output.insert(output.end(), tri, tri + 3);
+
+            // the triangle's vertices to the front, the rest keep their order
+            uint32_t next[score_cache_size + 3];
+            int next_count = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                next[next_count++] = tri[k];
+                // drop the emitted triangle from the vertex's list
+                uint32_t* begin = &adj.m_triangles[adj.m_offsets[tri[k]]];
+                uint32_t* end = begin + valence[tri[k]];
+                std::swap(*std::find(begin, end, static_cast<uint32_t>(best)), *(end - 1));
+                valence[tri[k]]--;
+            }
+            for (int i = 0; i < cache_count; i++)
+                if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+                    next[next_count++] = cache[i];
+            // evicted vertices lose their cache score
+            for (int i = score_cache_size; i < next_count; i++)
+            {
+                cache_position[next[i]] = -1;
+                vertex_score[next[i]] = scores.vertex(-1, valence[next[i]]);
+            }
+            cache_count = std::min(next_count, score_cache_size);
+            std::copy(next, next + cache_count, cache);
+
+            // rescore what is in the cache and pick the best triangle around it
+            for (int i = 0; i < cache_count; i++)
+            {
+                cache_position[cache[i]] = i;
+                vertex_score[cache[i]] = scores.vertex(i, valence[cache[i]]);
+            }
+            best = triangle_count;
+            best_score = -1;
+            for (int i = 0; i < cache_count; i++)
+            {
+                const uint32_t v = cache[i];
+                for (uint32_t j = 0; j < valence[v]; j++)
+                {
+                    const uint32_t t = adj.m_triangles[adj.m_offsets[v] + j];
+                    const float s = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] +
+                                    vertex_score[indices[3 * t + 2]];
+                    if (s > best_score)
+                    {
+                        best_score = s;
+                        best = t;
+                    }
+                }
+            }
+        }
+        std::copy(output.begin(), output.end(), indices);
+    }
+
+    void optimize_overdraw(uint32_t* indices, std::size_t index_count, const float* positions,
+                           std::size_t stride, std::size_t vertex_count, float threshold)
+    {
+        const std::size_t triangle_count = index_count / 3;
+        if (triangle_count < 2)
+            return;
+        float centroid[3] = {0, 0, 0};
+        for (std::size_t i = 0; i < index_count; i++)
+            for (int k = 0; k < 3; k++)
+                centroid[k] += positions[indices[i] * stride + k] / index_count;
+
+        const std::vector<uint32_t> source(indices, indices + index_count);
+        const float limit = analyze_vertex_cache(indices, index_count, vertex_count).m_acmr * threshold;
+        const std::vector<uint32_t> hard = hard_boundaries(indices, index_count, vertex_count, 16);
+        std::vector<uint32_t> starts = soft_boundaries(indices, index_count, vertex_count, hard, 16, threshold);
+        std::vector<uint32_t> sorted(index_count);
+        // fewer, bigger clusters until the cache cost is acceptable
+        while (starts.size() > 1)
+        {
+            sort_clusters(source.data(), sorted.data(), triangle_count, starts, positions, stride, centroid);
+            if (analyze_vertex_cache(sorted.data(), index_count, vertex_count).m_acmr <= limit)
+            {
+                std::copy(sorted.begin(), sorted.end(), indices);
+                return;
+            }
+            std::vector<uint32_t> merged;
+            for (std::size_t c = 0; c < starts.size(); c += 2)
+                merged.push_back(starts[c]);
+            starts.swap(merged);
+        }
+    }
+
+    void optimize_vertex_fetch(mesh& m)
+    {
+        const std::size_t count = m.vertex_count();
+        std::vector<uint32_t> remap(count, UINT32_MAX);
+        uint32_t next = 0;
+        for (uint32_t& index : m.m_indices)
+        {
+            if (remap[index] == UINT32_MAX)
+                remap[index] = next++;
+            index = remap[index];
+        }
+        std::vector<float> positions(std::size_t(next) * 3), normals(std::size_t(next) * 3);
+        for (std::size_t v = 0; v < count; v++)
+        {
+            if (remap[v] == UINT32_MAX)
+                continue;
+            std::copy(&m.m_positions[3 * v], &m.m_positions[3 * v] + 3, &positions[3 * remap[v]]);
+            std::copy(&m.m_normals[3 * v], &m.m_normals[3 * v] + 3, &normals[3 * remap[v]]);
+        }
+        m.m_positions.swap(positions);
+        m.m_normals.swap(normals);
+    }
+
+    std::vector<meshlet> build_meshlets(const float* positions, std::size_t stride, const uint32_t* indices,
+                                        std::size_t index_count, unsigned max_vertices, unsigned max_triangles)
+    {
+        std::vector<meshlet> meshlets;
+        std::vector<uint32_t> members;  // distinct vertices of the open meshlet
+        members.reserve(max_vertices);
+        auto close = [&](std::size_t end)
+        {
+            meshlet& m = meshlets.back();
+            m.m_index_count = static_cast<uint32_t>(end - m.m_first_index);
+            for (int k = 0; k < 3; k++)
+            {
+                m.m_min[k] = std::numeric_limits<float>::max();
+                m.m_max[k] = -std::numeric_limits<float>::max();
+            }
+            for (uint32_t v : members)
+                for (int k = 0; k < 3; k++)
+                {
+                    m.m_min[k] = std::min(m.m_min[k], positions[v * stride + k]);
+                    m.m_max[k] = std::max(m.m_max[k], positions[v * stride + k]);
+                }
+            members.clear();
+        };
+
+        for (std::size_t t = 0; t + 2 < index_count; t += 3)
+        {
+            unsigned added = 0;
+            for (int k = 0; k < 3; k++)
+                if (std::find(members.begin(), members.end(), indices[t + k]) == members.end())
+                    added++;
+            if (meshlets.empty() || members.size() + added > max_vertices ||
+                    t - meshlets.back().m_first_index >= 3 * max_triangles)
+            {
+                if (!meshlets.empty())
+                    close(t);
+                meshlets.push_back(meshlet());
+                meshlets.back().m_first_index = static_cast<uint32_t>(t);
+            }
+            for (int k = 0; k < 3; k++)
+                if (std::find(members.begin(), members.end(), indices[t + k]) == members.end())
+                    members.push_back(indices[t + k]);
+        }
+        if (!meshlets.empty())
+            close(index_count - index_count % 3);
+        return meshlets;
+    }
+
+    void optimize_mesh(mesh& m, optimize_report* report)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (report)
+        {
+            report->m_before = analyze_vertex_cache(m.m_indices.data(), m.m_indices.size(), m.vertex_count());
+            report->m_overdraw_before = analyze_overdraw(m.m_positions.data(), 3, m.m_indices.data(), m.m_indices.size());
+        }
+        optimize_vertex_cache(m.m_indices.data(), m.m_indices.size(), m.vertex_count());
+        optimize_overdraw(m.m_indices.data(), m.m_indices.size(), m.m_positions.data(), 3, m.vertex_count());
+        optimize_vertex_fetch(m);
+        if (report)
+        {
+            report->m_after = analyze_vertex_cache(m.m_indices.data(), m.m_indices.size(), m.vertex_count());
+            report->m_overdraw_after = analyze_overdraw(m.m_positions.data(), 3, m.m_indices.data(), m.m_indices.size());
+            report->m_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+}
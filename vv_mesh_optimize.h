@@ -0,0 +1,67 @@
+#ifndef vv_mesh_optimize_h
+#define vv_mesh_optimize_h
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "vv_mesh.h"
+
+// Triangle and vertex order for the GPU: post-transform cache reuse
+// (Forsyth, "Linear-Speed Vertex Cache Optimisation"), overdraw (clusters
+// sorted outside-in after Sander, Nehab, Barczak, "Fast Triangle Reordering
+// for Vertex Locality and Reduced Overdraw"), vertex fetch locality, and
+// meshlets with bounds for culling below the object level.
+// Positions are read with a stride in floats: 3 for mesh::m_positions,
+// 6 for interleaved position + normal.
+namespace vv_mesh
+{
+    struct vertex_cache_stats
+    {
+        float m_acmr = 0;  // transformed vertices per triangle, 0.5 is the ideal for big grids, 3 the worst
+        float m_atvr = 0;  // transformed vertices per referenced vertex, 1 is the ideal
+    };
+
+    // FIFO cache of cache_size entries, the classic hardware model
+    vertex_cache_stats analyze_vertex_cache(const uint32_t* indices, std::size_t index_count,
+                                            std::size_t vertex_count, unsigned cache_size = 16);
+
+    // Shaded fragments per covered pixel with early depth test and back-face
+    // culling, averaged over six axis aligned orthographic views; 1 is the ideal.
+    float analyze_overdraw(const float* positions, std::size_t stride, const uint32_t* indices,
+                           std::size_t index_count, int resolution = 256);
+
+    void optimize_vertex_cache(uint32_t* indices, std::size_t index_count, std::size_t vertex_count);
+
+    // Expects cache optimized indices. Reorders clusters of triangles so that
+    // the outside ones come first; ACMR may grow by threshold at most.
+    void optimize_overdraw(uint32_t* indices, std::size_t index_count, const float* positions,
+                           std::size_t stride, std::size_t vertex_count, float threshold = 1.05f);
+
+    // Vertices in order of first use, unreferenced ones dropped
+    void optimize_vertex_fetch(mesh& m);
+
+    struct meshlet
+    {
+        uint32_t m_first_index;
+        uint32_t m_index_count;
+        float    m_min[3];
+        float    m_max[3];
+    };
+
+    // Consecutive runs of triangles with at most max_vertices distinct vertices
+    std::vector<meshlet> build_meshlets(const float* positions, std::size_t stride, const uint32_t* indices,
+                                        std::size_t index_count, unsigned max_vertices = 64,
+                                        unsigned max_triangles = 126);
+
+    struct optimize_report
+    {
+        vertex_cache_stats m_before;
+        vertex_cache_stats m_after;
+        float              m_overdraw_before = 0;
+        float              m_overdraw_after  = 0;
+        double             m_ms              = 0;
+    };
+
+    // all of the above on a mesh, report is optional as measuring overdraw is not free
+    void optimize_mesh(mesh& m, optimize_report* report = nullptr);
+}
+#endif
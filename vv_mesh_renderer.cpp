@@ -0,0 +1,544 @@
+#include "vv_mesh_renderer.h"
+#include "vv_shader.h"
+#include "vv_trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace vv_gl
+{
+    // away from 0..3 where drivers like to alias gl_Vertex and gl_Normal
+    static const GLuint barycentric_location = 6;
+    // 0 is what triggers drawing in the compatibility profile, it must be the position
+    static const GLuint quantized_position_location = 0;
+    static const GLuint quantized_normal_location = 7;
+
+    static const char* wireframe_vs =
+        "#version 120\n"
+        "attribute vec3 a_barycentric;\n"
+        "varying vec3 v_barycentric;\n"
+        "varying vec4 v_color;\n"
+        "void main()\n"
+        "{\n"
+        "    // the fixed function light 0 and the global ambient, per vertex as before\n"
+        "    vec3 n = normalize(gl_NormalMatrix * gl_Normal);\n"
+        "    vec4 ec = gl_ModelViewMatrix * gl_Vertex;\n"
+        "    vec3 l = normalize(gl_LightSource[0].position.xyz - ec.xyz * gl_LightSource[0].position.w);\n"
+        "    v_color = gl_FrontLightModelProduct.sceneColor + gl_FrontMaterial.ambient * gl_LightSource[0].ambient\n"
+        "            + gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse * max(dot(n, l), 0.0);\n"
+        "    v_color.a = gl_FrontMaterial.diffuse.a;\n"
+        "    v_barycentric = a_barycentric;\n"
+        "    gl_Position = ftransform();\n"
+        "}\n";
+
+    static const char* wireframe_fs =
+        "#version 120\n"
+        "uniform float u_width;\n"
+        "uniform vec4 u_color;\n"
+        "varying vec3 v_barycentric;\n"
+        "varying vec4 v_color;\n"
+        "void main()\n"
+        "{\n"
+        "    // pixels to the nearest edge, hidden edges are one unit further away\n"
+        "    vec3 d = v_barycentric / max(fwidth(v_barycentric), vec3(1e-6));\n"
+        "    float edge = min(min(d.x, d.y), d.z);\n"
+        "    float half_width = u_width * 0.5;\n"
+        "    float a = 1.0 - smoothstep(half_width - 0.5, half_width + 0.5, edge);\n"
+        "    gl_FragColor = mix(v_color, u_color, a * u_color.a);\n"
+        "}\n";
+
+    static const char* quantized_vs =
+        "#version 120\n"
+        "attribute vec3 a_position;\n"
+        "attribute vec2 a_normal;\n"
+        "uniform vec3 u_offset;\n"
+        "uniform vec3 u_scale;\n"
+        "uniform float u_normal_scale;\n"
+        "uniform float u_lighting;\n"
+        "varying vec4 v_color;\n"
+        "void main()\n"
+        "{\n"
+        "    // octahedron back onto the sphere, the lower half is folded over the diagonals\n"
+        "    vec2 e = a_normal * u_normal_scale;\n"
+        "    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+        "    if (n.z < 0.0)\n"
+        "        n.xy = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);\n"
+        "    n = normalize(gl_NormalMatrix * normalize(n));\n"
+        "    vec4 position = vec4(u_offset + a_position * u_scale, 1.0);\n"
+        "    vec4 ec = gl_ModelViewMatrix * position;\n"
+        "    // the fixed function light 0 and the global ambient, as the float path gets them\n"
+        "    vec3 l = normalize(gl_LightSource[0].position.xyz - ec.xyz * gl_LightSource[0].position.w);\n"
+        "    vec4 lit = gl_FrontLightModelProduct.sceneColor + gl_FrontMaterial.ambient * gl_LightSource[0].ambient\n"
+        "             + gl_FrontMaterial.diffuse * gl_LightSource[0].diffuse * max(dot(n, l), 0.0);\n"
+        "    lit.a = gl_FrontMaterial.diffuse.a;\n"
+        "    v_color = mix(gl_Color, lit, u_lighting);\n"
+        "    // object linear texgen, as the fixed function path gets it\n"
+        "    gl_TexCoord[0] = vec4(dot(gl_ObjectPlaneS[0], position), dot(gl_ObjectPlaneT[0], position), 0.0, 1.0);\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * position;\n"
+        "}\n";
+
+    static const char* quantized_fs =
+        "#version 120\n"
+        "uniform sampler2D u_texture;\n"
+        "uniform float u_textured;\n"
+        "varying vec4 v_color;\n"
+        "void main()\n"
+        "{\n"
+        "    // modulated like GL_MODULATE\n"
+        "    gl_FragColor = v_color * mix(vec4(1.0), texture2D(u_texture, gl_TexCoord[0].st), u_textured);\n"
+        "}\n";
+
+    namespace
+    {
+        struct quantized_vertices
+        {
+            std::vector<unsigned char> m_data;
+            float m_offset[3];
+            float m_scale[3];
+            float m_position_error = 0;
+            float m_normal_error   = 0;  // radians
+        };
+
+        // folds the lower hemisphere over the diagonals of the upper one
+        void octahedral_decode(float u, float v, float n[3])
+        {
+            n[0] = u;
+            n[1] = v;
+            n[2] = 1 - std::fabs(u) - std::fabs(v);
+            if (n[2] < 0)
+            {
+                n[0] = (1 - std::fabs(v)) * (u >= 0 ? 1 : -1);
+                n[1] = (1 - std::fabs(u)) * (v >= 0 ? 1 : -1);
+            }
+            const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++)
+                n[k] /= len;
+        }
+
+        // steps of 1 / range; of the four neighbours of the exact point the one decoding closest wins
+        void octahedral_encode(const float* normal, int range, int e[2])
+        {
+            e[0] = e[1] = 0;
+            const float l1 = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+            if (l1 == 0)
+                return;
+            float u = normal[0] / l1, v = normal[1] / l1;
+            if (normal[2] < 0)
+            {
+                const float fu = (1 - std::fabs(v)) * (u >= 0 ? 1 : -1);
+                v = (1 - std::fabs(u)) * (v >= 0 ? 1 : -1);
+                u = fu;
+            }
+            float best = -2;
+            for (int c = 0; c < 4; c++)
+            {
+                const int cu = static_cast<int>(c & 1 ? std::ceil(u * range) : std::floor(u * range));
+                const int cv = static_cast<int>(c & 2 ? std::ceil(v * range) : std::floor(v * range));
+                float n[3];
+                octahedral_decode(float(cu) / range, float(cv) / range, n);
+                const float d = n[0] * normal[0] + n[1] * normal[1] + n[2] * normal[2];
+                if (d > best)
+                {
+                    best = d;
+                    e[0] = cu;
+                    e[1] = cv;
+                }
+            }
+        }
+
+        // interleaved position + normal floats -> 16-bit positions in the bounds and octahedral normals
+        void quantize(const float* vertices, std::size_t count, bool oct16, quantized_vertices& out)
+        {
+            float mn[3] = {0, 0, 0}, mx[3] = {0, 0, 0};
+            for (std::size_t i = 0; i < count; i++)
+                for (int k = 0; k < 3; k++)
+                {
+                    const float p = vertices[6 * i + k];
+                    mn[k] = i ? std::min(mn[k], p) : p;
+                    mx[k] = i ? std::max(mx[k], p) : p;
+                }
+            for (int k = 0; k < 3; k++)
+            {
+                out.m_offset[k] = mn[k];
+                out.m_scale[k] = (mx[k] - mn[k]) / 65535;
+            }
+
+            const std::size_t stride = oct16 ? 12 : 8;
+            const int range = oct16 ? 32767 : 127;
+            out.m_data.assign(count * stride, 0);
+            float min_dot = 1;
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const float* p = &vertices[6 * i];
+                const float* n = &vertices[6 * i + 3];
+                unsigned char* q = &out.m_data[i * stride];
+                float d2 = 0;
+                for (int k = 0; k < 3; k++)
+                {
+                    const uint16_t v = out.m_scale[k] > 0 ?
+                        static_cast<uint16_t>(std::min(65535.f, std::floor((p[k] - mn[k]) / out.m_scale[k] + 0.5f))) : 0;
+                    std::memcpy(q + 2 * k, &v, 2);
+                    const float d = out.m_offset[k] + v * out.m_scale[k] - p[k];
+                    d2 += d * d;
+                }
+                out.m_position_error = std::max(out.m_position_error, std::sqrt(d2));
+
+                int e[2] = {0, 0};
+                octahedral_encode(n, range, e);
+                if (oct16)
+                {
+                    const int16_t s[2] = {static_cast<int16_t>(e[0]), static_cast<int16_t>(e[1])};
+                    std::memcpy(q + 8, s, 4);
+                }
+                else
+                {
+                    const int8_t s[2] = {static_cast<int8_t>(e[0]), static_cast<int8_t>(e[1])};
+                    std::memcpy(q + 6, s, 2);
+                }
+                const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (len == 0)
+                    continue;
+                float decoded[3];
+                octahedral_decode(float(e[0]) / range, float(e[1]) / range, decoded);
+                min_dot = std::min(min_dot, (decoded[0] * n[0] + decoded[1] * n[1] + decoded[2] * n[2]) / len);
+            }
+            out.m_normal_error = std::acos(std::max(-1.f, std::min(1.f, min_dot)));
+        }
+    }
+
+    bool mesh_renderer::upload(const vv_mesh::mesh& m, float crease_cos)
+    {
+        release_gl();
+        m_mesh = m;
+        m_file = nullptr;
+        m_crease_cos = crease_cos;
+        for (uint32_t index : m.m_indices)
+            if (index >= m.vertex_count())
+                return false;
+
+        std::vector<float> interleaved(m.vertex_count() * 6);
+        for (std::size_t i = 0; i < m.vertex_count(); i++)
+            for (int k = 0; k < 3; k++)
+            {
+                interleaved[6 * i + k] = m.m_positions[3 * i + k];
+                interleaved[6 * i + 3 + k] = m.m_normals[3 * i + k];
+            }
+        const std::vector<uint32_t> edges = vv_mesh::extract_edges(m, crease_cos);
+        m_lods.assign(1, vv_mesh::lod_record{0, static_cast<uint32_t>(m.m_indices.size()), 0, 0});
+        return create_buffers(interleaved.data(), m.vertex_count(), m.m_indices.data(), m.m_indices.size(),
+                              edges.data(), edges.size());
+    }
+
+    bool mesh_renderer::upload(const vv_mesh::mesh_file& file)
+    {
+        release_gl();
+        m_mesh = vv_mesh::mesh();
+        m_file = nullptr;
+        m_lods.clear();
+        const vv_mesh::file_header* header = file.header();
+        if (!header)
+            return false;
+        m_file = &file;
+        m_crease_cos = header->m_crease_cos != 0 ? header->m_crease_cos : vv_mesh::flat_crease_cos;
+        m_lods.assign(file.lods(), file.lods() + header->m_lod_count);
+        // vertex_record is the buffer layout, the mapping goes to the driver as it is
+        return create_buffers(file.vertices(), header->m_vertex_count, file.indices(), header->m_index_count,
+                              file.edges(), header->m_edge_index_count);
+    }
+
+    bool mesh_renderer::create_buffers(const void* vertices, std::size_t vertex_count, const uint32_t* indices,
+                                       std::size_t index_count, const uint32_t* edges, std::size_t edge_index_count)
+    {
+        const uint64_t start = vv_trace::now_ns();
+        m_uploaded_format = m_format;
+        if (m_format != vertex_format::float32 && !prepare_quantized())
+            m_uploaded_format = vertex_format::float32;
+        quantized_vertices quantized;
+        const void* data = vertices;
+        std::size_t bytes = vertex_count * sizeof(vv_mesh::vertex_record);
+        m_stats.m_position_error = 0;
+        m_stats.m_normal_error = 0;
+        if (m_uploaded_format != vertex_format::float32)
+        {
+            quantize(static_cast<const float*>(vertices), vertex_count,
+                     m_uploaded_format == vertex_format::quantized_oct16, quantized);
+            std::copy(quantized.m_offset, quantized.m_offset + 3, m_position_offset);
+            std::copy(quantized.m_scale, quantized.m_scale + 3, m_position_scale);
+            m_stats.m_position_error = quantized.m_position_error;
+            m_stats.m_normal_error = static_cast<float>(quantized.m_normal_error * 180 / M_PI);
+            data = quantized.m_data.data();
+            bytes = quantized.m_data.size();
+        }
+        glGenBuffers(1, &m_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_stats.m_vertex_bytes = bytes;
+        m_stats.m_upload_ms = (vv_trace::now_ns() - start) / 1e6;
+
+        glGenBuffers(1, &m_tri_ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_tri_ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(uint32_t), indices, GL_STATIC_DRAW);
+        glGenBuffers(1, &m_edge_ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_edge_ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, edge_index_count * sizeof(uint32_t), edges, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        // vertices are position + normal floats here whatever goes to the GPU
+        const uint32_t lod0_first = m_lods.empty() ? 0 : m_lods[0].m_first_index;
+        const uint32_t lod0 = m_lods.empty() ? 0 : m_lods[0].m_index_count;
+        m_meshlets = vv_mesh::build_meshlets(static_cast<const float*>(vertices), 6, indices + lod0_first, lod0);
+        m_meshlet_bounds.resize(m_meshlets.size());
+        for (std::size_t i = 0; i < m_meshlets.size(); i++)
+        {
+            m_meshlets[i].m_first_index += lod0_first;
+            for (int k = 0; k < 3; k++)
+            {
+                m_meshlet_bounds[i].m_min[k] = m_meshlets[i].m_min[k];
+                m_meshlet_bounds[i].m_max[k] = m_meshlets[i].m_max[k];
+            }
+        }
+        m_run_counts.clear();
+        m_run_counts.reserve(m_meshlets.size());
+        m_run_offsets.clear();
+        m_run_offsets.reserve(m_meshlets.size());
+        m_stats.m_acmr = vv_mesh::analyze_vertex_cache(indices + lod0_first, lod0, vertex_count).m_acmr;
+        m_stats.m_meshlets = static_cast<unsigned>(m_meshlets.size());
+
+        m_edge_index_count = static_cast<GLsizei>(edge_index_count);
+        m_stats.m_triangles = lod_triangles(0);
+        m_stats.m_edges = static_cast<unsigned>(edge_index_count / 2);
+        m_stats.m_face_loop_lines = m_stats.m_triangles * 3;
+        return m_vbo != 0;
+    }
+
+    std::size_t mesh_renderer::select_lod(float pixels_per_unit, float max_pixels) const
+    {
+        // errors grow with the level
+        std::size_t lod = 0;
+        while (lod + 1 < m_lods.size() && m_lods[lod + 1].m_max_error * pixels_per_unit <= max_pixels)
+            lod++;
+        return lod;
+    }
+
+    void mesh_renderer::release_gl()
+    {
+        GLuint buffers[4] = {m_vbo, m_tri_ibo, m_edge_ibo, m_unrolled_vbo};
+        for (GLuint b : buffers)
+            if (b)
+                glDeleteBuffers(1, &b);
+        if (!m_cache)
+        {
+            if (m_program)
+                glDeleteProgram(m_program);
+            if (m_quantized_program)
+                glDeleteProgram(m_quantized_program);
+        }
+        m_vbo = m_tri_ibo = m_edge_ibo = m_unrolled_vbo = 0;
+        m_program = 0;
+        m_quantized_program = 0;
+        m_unrolled_count = 0;
+        m_program_failed = false;
+    }
+
+    void mesh_renderer::bind_quantized(bool lighting, bool textured) const
+    {
+        const bool oct16 = m_uploaded_format == vertex_format::quantized_oct16;
+        const GLsizei stride = oct16 ? 12 : 8;
+        glUseProgram(m_quantized_program);
+        glUniform3fv(m_offset_location, 1, m_position_offset);
+        glUniform3fv(m_scale_location, 1, m_position_scale);
+        glUniform1f(m_normal_scale_location, oct16 ? 1.f / 32767 : 1.f / 127);
+        glUniform1f(m_lighting_location, lighting ? 1.f : 0.f);
+        glUniform1f(m_textured_location, textured ? 1.f : 0.f);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        // integers go in unnormalized, the steps are scaled in the shader
+        glEnableVertexAttribArray(quantized_position_location);
+        glVertexAttribPointer(quantized_position_location, 3, GL_UNSIGNED_SHORT, GL_FALSE, stride, nullptr);
+        if (lighting)
+        {
+            glEnableVertexAttribArray(quantized_normal_location);
+            glVertexAttribPointer(quantized_normal_location, 2, oct16 ? GL_SHORT : GL_BYTE, GL_FALSE, stride,
+                                  reinterpret_cast<const void*>(oct16 ? 8 : 6));
+        }
+    }
+
+    void mesh_renderer::unbind_quantized() const
+    {
+        glDisableVertexAttribArray(quantized_normal_location);
+        glDisableVertexAttribArray(quantized_position_location);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glUseProgram(0);
+    }
+
+    unsigned mesh_renderer::draw_triangles(std::size_t lod, const vv_scene::frustum* f) const
+    {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_tri_ibo);
+        if (!f || lod != 0 || !m_meshlet_culling || m_meshlets.size() < 2)
+        {
+            const void* first = reinterpret_cast<const void*>(m_lods[lod].m_first_index * sizeof(uint32_t));
+            glDrawElements(GL_TRIANGLES, m_lods[lod].m_index_count, GL_UNSIGNED_INT, first);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+            return m_lods[lod].m_index_count / 3;
+        }
+
+        // meshlets are consecutive in the index buffer, visible neighbours make one range
+        m_run_counts.clear();
+        m_run_offsets.clear();
+        unsigned triangles = 0;
+        uint32_t run_end = 0;
+        for (std::size_t i = 0; i < m_meshlets.size(); i++)
+        {
+            if (!f->intersects(m_meshlet_bounds[i]))
+                continue;
+            const vv_mesh::meshlet& ml = m_meshlets[i];
+            triangles += ml.m_index_count / 3;
+            if (!m_run_counts.empty() && run_end == ml.m_first_index)
+                m_run_counts.back() += ml.m_index_count;
+            else
+            {
+                m_run_counts.push_back(ml.m_index_count);
+                m_run_offsets.push_back(reinterpret_cast<const GLvoid*>(ml.m_first_index * sizeof(uint32_t)));
+            }
+            run_end = ml.m_first_index + ml.m_index_count;
+        }
+        if (!m_run_counts.empty())
+            glMultiDrawElements(GL_TRIANGLES, m_run_counts.data(), GL_UNSIGNED_INT, m_run_offsets.data(),
+                                static_cast<GLsizei>(m_run_counts.size()));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        return triangles;
+    }
+
+    unsigned mesh_renderer::draw_shaded(std::size_t lod, const vv_scene::frustum* f, bool textured) const
+    {
+        if (!m_vbo || lod >= m_lods.size())
+            return 0;
+        if (m_uploaded_format != vertex_format::float32)
+        {
+            bind_quantized(true, textured);
+            const unsigned triangles = draw_triangles(lod, f);
+            unbind_quantized();
+            return triangles;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 6 * sizeof(float), nullptr);
+        glNormalPointer(GL_FLOAT, 6 * sizeof(float), reinterpret_cast<const void*>(3 * sizeof(float)));
+        const unsigned triangles = draw_triangles(lod, f);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return triangles;
+    }
+
+    void mesh_renderer::draw_edges() const
+    {
+        if (!m_vbo)
+            return;
+        if (m_uploaded_format != vertex_format::float32)
+        {
+            // the current color, no lighting
+            bind_quantized(false, false);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_edge_ibo);
+            glDrawElements(GL_LINES, m_edge_index_count, GL_UNSIGNED_INT, nullptr);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+            unbind_quantized();
+            return;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_edge_ibo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 6 * sizeof(float), nullptr);
+        glDrawElements(GL_LINES, m_edge_index_count, GL_UNSIGNED_INT, nullptr);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    GLuint mesh_renderer::get_program(const char* vertex, const char* fragment,
+                                      const std::vector<attribute_binding>& attributes, std::string& log)
+    {
+        if (!m_cache)
+            return build_program(vertex, fragment, attributes, log);
+        program_source source;
+        source.m_vertex = vertex;
+        source.m_fragment = fragment;
+        source.m_attributes = attributes;
+        return m_cache->get(source, log);
+    }
+
+    bool mesh_renderer::prepare_quantized()
+    {
+        if (m_quantized_program)
+            return true;
+        std::string log;
+        m_quantized_program = get_program(quantized_vs, quantized_fs,
+                                          {{quantized_position_location, "a_position"},
+                                           {quantized_normal_location, "a_normal"}}, log);
+        if (!m_quantized_program)
+        {
+            std::cout << "quantized vertex shader: " << log << std::endl;
+            return false;
+        }
+        m_offset_location = glGetUniformLocation(m_quantized_program, "u_offset");
+        m_scale_location = glGetUniformLocation(m_quantized_program, "u_scale");
+        m_normal_scale_location = glGetUniformLocation(m_quantized_program, "u_normal_scale");
+        m_lighting_location = glGetUniformLocation(m_quantized_program, "u_lighting");
+        m_textured_location = glGetUniformLocation(m_quantized_program, "u_textured");
+        return true;
+    }
+
+    bool mesh_renderer::prepare_wireframe()
+    {
+        if (m_program || m_program_failed)
+            return m_program != 0;
+
+        std::string log;
+        m_program = get_program(wireframe_vs, wireframe_fs, {{barycentric_location, "a_barycentric"}}, log);
+        if (!m_program)
+        {
+            std::cout << "wireframe shader: " << log << std::endl;
+            m_program_failed = true;
+            return false;
+        }
+        m_width_location = glGetUniformLocation(m_program, "u_width");
+        m_color_location = glGetUniformLocation(m_program, "u_color");
+
+        if (m_file && m_mesh.m_indices.empty())
+            m_mesh = m_file->to_mesh();
+        const std::vector<float> unrolled = vv_mesh::unroll_with_barycentrics(m_mesh, m_crease_cos);
+        glGenBuffers(1, &m_unrolled_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_unrolled_vbo);
+        glBufferData(GL_ARRAY_BUFFER, unrolled.size() * sizeof(float), unrolled.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_unrolled_count = static_cast<GLsizei>(unrolled.size() / 9);
+        return true;
+    }
+
+    bool mesh_renderer::draw_shaded_wireframe(float width, const GLfloat color[4])
+    {
+        if (!m_vbo || !prepare_wireframe())
+            return false;
+
+        const GLsizei stride = 9 * sizeof(float);
+        glUseProgram(m_program);
+        glUniform1f(m_width_location, width);
+        glUniform4fv(m_color_location, 1, color);
+        glBindBuffer(GL_ARRAY_BUFFER, m_unrolled_vbo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glEnableVertexAttribArray(barycentric_location);
+        glVertexPointer(3, GL_FLOAT, stride, nullptr);
+        glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const void*>(3 * sizeof(float)));
+        glVertexAttribPointer(barycentric_location, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(6 * sizeof(float)));
+        glDrawArrays(GL_TRIANGLES, 0, m_unrolled_count);
+        glDisableVertexAttribArray(barycentric_location);
+        glDisableClientState(GL_NORMAL_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glUseProgram(0);
+        return true;
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef vv_mesh_renderer_h
+#define vv_mesh_renderer_h
+#include <allegro5/allegro_opengl.h>
+#include <vector>
+#include "vv_mesh.h"
+#include "vv_mesh_file.h"
+#include "vv_mesh_optimize.h"
+#include "vv_program_cache.h"
+#include "vv_scene.h"
+
+namespace vv_gl
+{
+    // GPU copy of a vv_mesh::mesh with three ways to draw it:
+    // shaded triangles, unique edges as GL_LINES (each shared edge once), and
+    // shaded triangles with their edges in a single pass. The last one shades the
+    // edges from barycentric distances in a GLSL 1.20 program, so the mesh is
+    // drawn once and no polygon offset is needed. Its unindexed vertex copy is
+    // built on first use.
+    // A mesh file uploads its blocks straight from the mapping and brings its
+    // LODs along; an in-memory mesh has LOD 0 only.
+    // Vertices can be stored quantized: positions as 16-bit steps across the
+    // mesh bounds, normals octahedral in two bytes or two shorts, decoded by a
+    // GLSL 1.20 program. The single-pass wireframe copy stays in floats.
+    // LOD 0 is split into meshlets at upload; given a frustum in mesh space
+    // the ones outside are skipped and the rest go out in one multi draw.
+    class mesh_renderer
+    {
+    public:
+        enum class vertex_format
+        {
+            float32,          // 24 bytes per vertex, fixed function
+            quantized_oct8,   // 8 bytes
+            quantized_oct16   // 12 bytes
+        };
+
+        struct statistics
+        {
+            unsigned m_triangles       = 0;
+            unsigned m_edges           = 0;  // unique, after hiding coplanar diagonals
+            unsigned m_face_loop_lines = 0;  // what drawing every triangle outline would cost
+            std::size_t m_vertex_bytes = 0;  // vertex buffer size on the GPU
+            double   m_upload_ms       = 0;  // vertex conversion and upload
+            float    m_position_error  = 0;  // largest distance a vertex moved, mesh units
+            float    m_normal_error    = 0;  // largest normal deviation, degrees
+            float    m_acmr            = 0;  // LOD 0 vertex cache misses per triangle, FIFO of 16
+            unsigned m_meshlets        = 0;
+        };
+
+        // GL objects must be released with release_gl() while the context is alive
+        // crease_cos filters the wireframe edges, see vv_mesh::extract_edges(); false when an
+        // index addresses no vertex
+        bool upload(const vv_mesh::mesh& m, float crease_cos = vv_mesh::all_edges);
+        // the file must stay open while the renderer uses it, the wireframe copy is built from it
+        bool upload(const vv_mesh::mesh_file& file);
+        void release_gl();
+        bool is_uploaded() const {return m_vbo != 0;}
+        // programs come from the cache when set, it owns them then
+        void set_program_cache(program_cache* cache) {m_cache = cache;}
+        // takes effect with the next upload; float32 when the decoding program doesn't build
+        void set_vertex_format(vertex_format format) {m_format = format;}
+        vertex_format get_vertex_format() const {return m_uploaded_format;}
+        void set_meshlet_culling(bool enabled) {m_meshlet_culling = enabled;}
+        bool get_meshlet_culling() const {return m_meshlet_culling;}
+
+        std::size_t lod_count() const {return m_lods.size();}
+        unsigned lod_triangles(std::size_t lod) const {return lod < m_lods.size() ? m_lods[lod].m_index_count / 3 : 0;}
+        // coarsest LOD whose error stays under max_pixels, pixels_per_unit at the object
+        std::size_t select_lod(float pixels_per_unit, float max_pixels = 1) const;
+        const vv_mesh::lod_record& lod(std::size_t lod) const {return m_lods[lod];}
+
+        // for drawing the buffers elsewhere, as vv_gl::indirect_renderer does
+        GLuint vertex_buffer() const {return m_vbo;}
+        GLuint triangle_buffer() const {return m_tri_ibo;}
+
+        // returns the triangles drawn; f is in mesh space and culls LOD 0 by meshlets.
+        // textured: the caller bound a texture to unit 0 with object linear texgen on S and T
+        unsigned draw_shaded(std::size_t lod = 0, const vv_scene::frustum* f = nullptr, bool textured = false) const;
+        void draw_edges() const;
+        // width in pixels; false when the program isn't available, draw two passes then
+        bool draw_shaded_wireframe(float width, const GLfloat color[4]);
+
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        bool prepare_wireframe();
+        bool prepare_quantized();
+        GLuint get_program(const char* vertex, const char* fragment, const std::vector<attribute_binding>& attributes,
+                           std::string& log);
+        void bind_quantized(bool lighting, bool textured) const;
+        void unbind_quantized() const;
+        unsigned draw_triangles(std::size_t lod, const vv_scene::frustum* f) const;
+
+        bool create_buffers(const void* vertices, std::size_t vertex_count, const uint32_t* indices,
+                            std::size_t index_count, const uint32_t* edges, std::size_t edge_index_count);
+
+        vv_mesh::mesh m_mesh;           // kept for the unindexed copy
+        const vv_mesh::mesh_file* m_file = nullptr;  // source of m_mesh when uploaded from a file
+        float      m_crease_cos = vv_mesh::all_edges;  // of the edge buffer, the unindexed copy matches it
+        std::vector<vv_mesh::lod_record> m_lods;
+        std::vector<vv_mesh::meshlet>    m_meshlets;        // LOD 0
+        std::vector<vv_scene::aabb>      m_meshlet_bounds;
+        bool       m_meshlet_culling = true;
+        mutable std::vector<GLsizei>       m_run_counts;   // multi draw arguments, sized at upload
+        mutable std::vector<const GLvoid*> m_run_offsets;
+        GLuint     m_vbo      = 0;      // position + normal, m_uploaded_format
+        GLuint     m_tri_ibo  = 0;
+        GLuint     m_edge_ibo = 0;
+        GLsizei    m_edge_index_count = 0;
+
+        GLuint     m_unrolled_vbo   = 0; // position + normal + barycentric
+        GLsizei    m_unrolled_count = 0;
+        GLuint     m_program        = 0;
+        GLint      m_width_location = -1;
+        GLint      m_color_location = -1;
+        bool       m_program_failed = false;
+        program_cache* m_cache      = nullptr;
+
+        vertex_format m_format          = vertex_format::float32;
+        vertex_format m_uploaded_format = vertex_format::float32;
+        GLuint     m_quantized_program = 0;
+        GLint      m_offset_location   = -1;
+        GLint      m_scale_location    = -1;
+        GLint      m_normal_scale_location = -1;
+        GLint      m_lighting_location = -1;
+        GLint      m_textured_location = -1;
+        float      m_position_offset[3] = {0, 0, 0};  // decoded = offset + q * scale
+        float      m_position_scale[3]  = {0, 0, 0};
+
+        statistics m_stats;
+    };
+}
+#endif
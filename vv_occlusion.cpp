@@ -0,0 +1,115 @@
+#include "vv_occlusion.h"
+#include "vv_gl_ext.h"
+
+#ifndef GL_ANY_SAMPLES_PASSED
+#define GL_ANY_SAMPLES_PASSED 0x8C2F
+#endif
+
+namespace vv_gl
+{
+    void occlusion_culler::release_gl()
+    {
+        for (GLuint q : m_queries)
+            if (q)
+                glDeleteQueries(1, &q);
+        if (m_box_vbo)
+            glDeleteBuffers(1, &m_box_vbo);
+        if (m_box_ibo)
+            glDeleteBuffers(1, &m_box_ibo);
+        m_box_vbo = 0;
+        m_box_ibo = 0;
+        m_queries.clear();
+        m_visible.clear();
+        m_in_flight.clear();
+        m_pending.clear();
+    }
+
+    void occlusion_culler::begin_frame(std::size_t object_count)
+    {
+        if (!m_target)
+            m_target = get_extensions().version_at_least(3, 3) ? GL_ANY_SAMPLES_PASSED : GL_SAMPLES_PASSED;
+
+        if (m_queries.size() != object_count)
+        {
+            // scene changed: drop everything, new objects start as visible
+            release_gl();
+            m_queries.assign(object_count, 0);
+            m_visible.assign(object_count, 1);
+            m_in_flight.assign(object_count, 0);
+        }
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < m_pending.size(); i++)
+        {
+            const uint32_t id = m_pending[i];
+            GLuint available = 0;
+            glGetQueryObjectuiv(m_queries[id], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+            {
+                m_pending[kept++] = id;
+                continue;
+            }
+            GLuint samples = 0;
+            glGetQueryObjectuiv(m_queries[id], GL_QUERY_RESULT, &samples);
+            m_visible[id] = samples != 0;
+            m_in_flight[id] = 0;
+        }
+        m_pending.resize(kept);
+        m_stats = statistics();
+    }
+
+    bool occlusion_culler::begin_query(uint32_t id)
+    {
+        if (m_in_flight[id])
+            return false;
+        if (!m_queries[id])
+            glGenQueries(1, &m_queries[id]);
+        glBeginQuery(m_target, m_queries[id]);
+        m_in_flight[id] = 1;
+        m_pending.push_back(id);
+        m_stats.m_queries++;
+        return true;
+    }
+
+    void occlusion_culler::end_query()
+    {
+        glEndQuery(m_target);
+    }
+
+    void occlusion_culler::draw_bounds(const vv_scene::aabb& box)
+    {
+        if (!m_box_vbo)
+        {
+            const GLfloat corners[8][3] =
+            {
+                {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+                {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}
+            };
+            const GLubyte triangles[36] =
+            {
+                0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,
+                0, 1, 5, 0, 5, 4,  3, 6, 2, 3, 7, 6,
+                0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5
+            };
+            glGenBuffers(1, &m_box_vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, m_box_vbo);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+            glGenBuffers(1, &m_box_ibo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_box_ibo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangles), triangles, GL_STATIC_DRAW);
+        }
+
+        glPushMatrix();
+        glTranslatef(box.m_min[0], box.m_min[1], box.m_min[2]);
+        glScalef(box.m_max[0] - box.m_min[0], box.m_max[1] - box.m_min[1], box.m_max[2] - box.m_min[2]);
+        glBindBuffer(GL_ARRAY_BUFFER, m_box_vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_box_ibo);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, nullptr);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, nullptr);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glPopMatrix();
+    }
+}
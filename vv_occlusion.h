@@ -0,0 +1,57 @@
+#ifndef vv_occlusion_h
+#define vv_occlusion_h
+#include <allegro5/allegro_opengl.h>
+#include <cstdint>
+#include <vector>
+#include "vv_scene.h"
+
+namespace vv_gl
+{
+    // Hardware occlusion queries for the scene objects of one view.
+    // Results are read back a frame or more later, only when already available,
+    // so the CPU never waits for the GPU. Objects without a fresh result keep
+    // the last known visibility.
+    class occlusion_culler
+    {
+    public:
+        struct statistics
+        {
+            unsigned m_occluders       = 0;
+            unsigned m_queries         = 0;
+            unsigned m_occluded        = 0;
+            unsigned m_saved_triangles = 0;
+        };
+
+        occlusion_culler() = default;
+        // query objects are bound to one view, a copy starts from scratch
+        occlusion_culler(const occlusion_culler&) {}
+        occlusion_culler& operator=(const occlusion_culler&) {return *this;}
+
+        void release_gl();
+
+        // collects finished queries, call before using the results in a frame
+        void begin_frame(std::size_t object_count);
+        bool was_visible(uint32_t id) const {return m_visible[id] != 0;}
+
+        // false when the previous query of the object is still in flight
+        bool begin_query(uint32_t id);
+        void end_query();
+
+        // depth-only bounding box for testing hidden objects
+        void draw_bounds(const vv_scene::aabb& box);
+
+        statistics& stats() {return m_stats;}
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        std::vector<GLuint>   m_queries;
+        std::vector<uint8_t>  m_visible;
+        std::vector<uint8_t>  m_in_flight;
+        std::vector<uint32_t> m_pending;
+        GLenum                m_target = 0;
+        GLuint                m_box_vbo = 0;
+        GLuint                m_box_ibo = 0;
+        statistics            m_stats;
+    };
+}
+#endif
@@ -0,0 +1,152 @@
+#include "vv_overdraw.h"
+#include <algorithm>
+#include <iostream>
+
+namespace vv_gl
+{
+    static const char* ramp_vs =
+        "#version 120\n"
+        "void main()\n"
+        "{\n"
+        "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+        "    gl_Position = gl_Vertex;\n"
+        "}\n";
+
+    static const char* ramp_fs =
+        "#version 120\n"
+        "uniform sampler2D u_counts;\n"
+        "void main()\n"
+        "{\n"
+        "    // 8 / 255 per layer, see count_step()\n"
+        "    float n = floor(texture2D(u_counts, gl_TexCoord[0].st).r * 255.0 / 8.0 + 0.5);\n"
+        "    // one layer blue, through cyan, green and yellow to red at eight\n"
+        "    float t = clamp((n - 1.0) / 7.0, 0.0, 1.0);\n"
+        "    vec3 c = clamp(vec3(1.5) - abs(4.0 * t - vec3(3.0, 2.0, 1.0)), 0.0, 1.0);\n"
+        "    gl_FragColor = vec4(n < 0.5 ? vec3(0.0) : c, 1.0);\n"
+        "}\n";
+
+    void overdraw_heatmap::release_gl()
+    {
+        if (m_texture)
+            glDeleteTextures(1, &m_texture);
+        if (m_program && !m_cache)
+            glDeleteProgram(m_program);
+        m_texture = 0;
+        m_texture_w = m_texture_h = 0;
+        m_program = 0;
+        m_program_failed = false;
+    }
+
+    void overdraw_heatmap::begin(bool depth_test)
+    {
+        static const GLfloat black[4] = {0, 0, 0, 1};
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_LIGHTING_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        if (!depth_test)
+            glDisable(GL_DEPTH_TEST);
+        // only the material ambient times light 0 may reach the color
+        glLightModelfv(GL_LIGHT_MODEL_AMBIENT, black);
+    }
+
+    void overdraw_heatmap::end()
+    {
+        glPopAttrib();
+    }
+
+    bool overdraw_heatmap::prepare_program()
+    {
+        if (m_program)
+            return true;
+        if (m_program_failed)
+            return false;
+        std::string log;
+        if (m_cache)
+        {
+            program_source source;
+            source.m_vertex = ramp_vs;
+            source.m_fragment = ramp_fs;
+            m_program = m_cache->get(source, log);
+        }
+        else
+            m_program = build_program(ramp_vs, ramp_fs, {}, log);
+        if (!m_program)
+        {
+            std::cout << "overdraw ramp shader: " << log << std::endl;
+            m_program_failed = true;
+            return false;
+        }
+        m_counts_location = glGetUniformLocation(m_program, "u_counts");
+        return true;
+    }
+
+    void overdraw_heatmap::resolve(int w, int h)
+    {
+        if (w <= 0 || h <= 0)
+            return;
+        // the counters come back to the CPU for the statistics and go up again as a texture,
+        // which also avoids copying from a multisampled framebuffer
+        m_pixels.resize(std::size_t(w) * h);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, w, h, GL_RED, GL_UNSIGNED_BYTE, m_pixels.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+        uint64_t sum = 0;
+        std::size_t covered = 0;
+        unsigned top = 0;
+        for (GLubyte p : m_pixels)
+        {
+            const unsigned n = (p + 4) / 8;
+            sum += n;
+            covered += n > 0;
+            top = std::max(top, n);
+        }
+        m_stats.m_average = covered ? float(sum) / covered : 0;
+        m_stats.m_max = top;
+        m_stats.m_covered = float(covered) / m_pixels.size();
+
+        if (!prepare_program())
+            return;  // the dim grey counts stay on screen
+        if (!m_texture)
+            glGenTextures(1, &m_texture);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (m_texture_w != w || m_texture_h != h)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, m_pixels.data());
+            m_texture_w = w;
+            m_texture_h = h;
+        }
+        else
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_LUMINANCE, GL_UNSIGNED_BYTE, m_pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        static const GLfloat quad[] =
+        {
+            -1, -1, 0, 0,   1, -1, 1, 0,   1, 1, 1, 1,   -1, 1, 0, 1
+        };
+        glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_ALPHA_TEST);
+        glDisable(GL_BLEND);
+        glDisable(GL_SCISSOR_TEST);
+        glDisable(GL_CULL_FACE);
+        glUseProgram(m_program);
+        glUniform1i(m_counts_location, 0);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), quad);
+        glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(GLfloat), quad + 2);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glUseProgram(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPopAttrib();
+    }
+}
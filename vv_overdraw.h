@@ -0,0 +1,59 @@
+#ifndef vv_overdraw_h
+#define vv_overdraw_h
+#include <allegro5/allegro_opengl.h>
+#include <vector>
+#include "vv_program_cache.h"
+
+namespace vv_gl
+{
+    // Overdraw heatmap. The scene is drawn with additive blending and one
+    // count step as its only color, so every fragment adds one to the color
+    // buffer, which becomes the counter target. resolve() reads the counts
+    // back for the statistics and maps them onto a color ramp in a GLSL 1.20
+    // pass: black for nothing, blue for one layer, up to red at eight and more.
+    // The read back waits for the GPU, this is a debug mode.
+    class overdraw_heatmap
+    {
+    public:
+        static const int max_count = 31;  // 8-bit counters saturate above
+
+        struct statistics
+        {
+            float    m_average = 0;  // fragments per covered pixel
+            unsigned m_max     = 0;
+            float    m_covered = 0;  // part of the window
+        };
+
+        // GL objects must be released with release_gl() while the context is alive
+        void release_gl();
+        // the ramp program comes from the cache when set, it owns it then
+        void set_program_cache(program_cache* cache) {m_cache = cache;}
+
+        // color of one count for lighting off, or the material ambient with a white light
+        static GLfloat count_step() {return 8.f / 255;}
+
+        // state for the counting pass after the color buffer is cleared to black;
+        // depth_test false counts the hidden fragments too
+        void begin(bool depth_test);
+        void end();
+
+        // maps the counts in the lower left w x h of the framebuffer to colors
+        void resolve(int w, int h);
+
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        bool prepare_program();
+
+        GLuint         m_texture = 0;
+        int            m_texture_w = 0;
+        int            m_texture_h = 0;
+        GLuint         m_program = 0;
+        bool           m_program_failed = false;
+        GLint          m_counts_location = -1;
+        program_cache* m_cache = nullptr;
+        std::vector<GLubyte> m_pixels;
+        statistics     m_stats;
+    };
+}
+#endif
@@ -0,0 +1,138 @@
+#include "vv_overlay.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+namespace vv_ui
+{
+    void overlay::begin(int w, int h)
+    {
+        m_w = w;
+        m_h = h;
+        m_vertices.clear();
+        m_labels.clear();
+        m_chars.clear();
+    }
+
+    void overlay::vertex(float x, float y, ALLEGRO_COLOR color)
+    {
+        ALLEGRO_VERTEX v;
+        v.x = x;
+        v.y = y;
+        v.z = 0;
+        v.u = 0;
+        v.v = 0;
+        v.color = color;
+        m_vertices.push_back(v);
+    }
+
+    void overlay::line(float x1, float y1, float x2, float y2, ALLEGRO_COLOR color, float thickness)
+    {
+        // a quad around the segment, so every width fits in the triangle list
+        const float dx = x2 - x1;
+        const float dy = y2 - y1;
+        const float len = std::sqrt(dx * dx + dy * dy);
+        if (len <= 0)
+            return;
+        const float nx = -dy / len * thickness / 2;
+        const float ny = dx / len * thickness / 2;
+        vertex(x1 + nx, y1 + ny, color);
+        vertex(x2 + nx, y2 + ny, color);
+        vertex(x2 - nx, y2 - ny, color);
+        vertex(x1 + nx, y1 + ny, color);
+        vertex(x2 - nx, y2 - ny, color);
+        vertex(x1 - nx, y1 - ny, color);
+    }
+
+    void overlay::filled_rect(float x1, float y1, float x2, float y2, ALLEGRO_COLOR color)
+    {
+        vertex(x1, y1, color);
+        vertex(x2, y1, color);
+        vertex(x2, y2, color);
+        vertex(x1, y1, color);
+        vertex(x2, y2, color);
+        vertex(x1, y2, color);
+    }
+
+    void overlay::text(const ALLEGRO_FONT* font, ALLEGRO_COLOR color, float x, float y, int flags, const char* str)
+    {
+        if (!font)
+            return;
+        label l = {font, color, x, y, flags, m_chars.size()};
+        m_chars.insert(m_chars.end(), str, str + std::strlen(str) + 1);
+        m_labels.push_back(l);
+    }
+
+    void overlay::textf(const ALLEGRO_FONT* font, ALLEGRO_COLOR color, float x, float y, int flags, const char* format, ...)
+    {
+        if (!font)
+            return;
+        // formatted straight into the shared character buffer
+        const std::size_t offset = m_chars.size();
+        va_list args;
+        va_start(args, format);
+        va_list again;
+        va_copy(again, args);
+        const int length = std::vsnprintf(nullptr, 0, format, args);
+        va_end(args);
+        if (length >= 0)
+        {
+            m_chars.resize(offset + length + 1);
+            std::vsnprintf(&m_chars[offset], length + 1, format, again);
+            label l = {font, color, x, y, flags, offset};
+            m_labels.push_back(l);
+        }
+        va_end(again);
+    }
+
+    void overlay::add_widget(overlay_widget* widget)
+    {
+        if (std::find(m_widgets.begin(), m_widgets.end(), widget) == m_widgets.end())
+            m_widgets.push_back(widget);
+    }
+
+    void overlay::remove_widget(overlay_widget* widget)
+    {
+        m_widgets.erase(std::remove(m_widgets.begin(), m_widgets.end(), widget), m_widgets.end());
+    }
+
+    void overlay::build_widgets()
+    {
+        for (overlay_widget* widget : m_widgets)
+            widget->build(*this, m_w, m_h);
+    }
+
+    void overlay::flush()
+    {
+        m_stats.m_vertices = static_cast<unsigned>(m_vertices.size());
+        m_stats.m_labels = static_cast<unsigned>(m_labels.size());
+        m_stats.m_widgets = static_cast<unsigned>(m_widgets.size());
+        m_stats.m_al_draw_calls = static_cast<unsigned>(m_labels.size()) + (m_vertices.empty() ? 0 : 1);
+        if (m_vertices.empty() && m_labels.empty())
+            return;
+
+        ALLEGRO_TRANSFORM old_projection, old_view, projection, view;
+        al_copy_transform(&old_projection, al_get_current_projection_transform());
+        al_copy_transform(&old_view, al_get_current_transform());
+        al_identity_transform(&projection);
+        al_orthographic_transform(&projection, 0, 0, -1, m_w, m_h, 1);
+        al_identity_transform(&view);
+        al_use_projection_transform(&projection);
+        al_use_transform(&view);
+
+        if (!m_vertices.empty())
+            al_draw_prim(m_vertices.data(), nullptr, nullptr, 0, static_cast<int>(m_vertices.size()),
+                         ALLEGRO_PRIM_TRIANGLE_LIST);
+
+        // glyphs of the same font page share one texture, held drawing batches them
+        al_hold_bitmap_drawing(true);
+        for (const label& l : m_labels)
+            al_draw_text(l.m_font, l.m_color, l.m_x, l.m_y, l.m_flags, &m_chars[l.m_offset]);
+        al_hold_bitmap_drawing(false);
+
+        al_use_projection_transform(&old_projection);
+        al_use_transform(&old_view);
+    }
+}
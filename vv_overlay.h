@@ -0,0 +1,72 @@
+#ifndef vv_overlay_h
+#define vv_overlay_h
+#include <allegro5/allegro5.h>
+#include <allegro5/allegro_font.h>
+#include <allegro5/allegro_primitives.h>
+#include <vector>
+
+namespace vv_ui
+{
+    class overlay;
+
+    // user HUD element, asked every frame to add its geometry and text
+    class overlay_widget
+    {
+    public:
+        virtual ~overlay_widget() {}
+        virtual void build(overlay& o, int w, int h) = 0;
+    };
+
+    // Collects the 2D HUD of a frame: lines and rectangles go into one triangle
+    // list, labels into one text list. flush() draws the triangles with a single
+    // al_draw_prim call and the labels inside one held bitmap drawing batch, all
+    // under one pixel projection (origin top left, y down).
+    // The buffers keep their capacity, a steady HUD doesn't allocate.
+    class overlay
+    {
+    public:
+        struct statistics
+        {
+            unsigned m_vertices = 0;
+            unsigned m_labels   = 0;
+            unsigned m_widgets  = 0;
+            unsigned m_al_draw_calls = 0;  // made by the last flush()
+        };
+
+        void begin(int w, int h);
+        void line(float x1, float y1, float x2, float y2, ALLEGRO_COLOR color, float thickness = 1);
+        void filled_rect(float x1, float y1, float x2, float y2, ALLEGRO_COLOR color);
+        void text(const ALLEGRO_FONT* font, ALLEGRO_COLOR color, float x, float y, int flags, const char* str);
+        void textf(const ALLEGRO_FONT* font, ALLEGRO_COLOR color, float x, float y, int flags, const char* format, ...);
+        void flush();
+
+        // widgets are not owned, they get built right before flush()
+        void add_widget(overlay_widget* widget);
+        void remove_widget(overlay_widget* widget);
+        void build_widgets();
+
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        struct label
+        {
+            const ALLEGRO_FONT* m_font;
+            ALLEGRO_COLOR       m_color;
+            float               m_x;
+            float               m_y;
+            int                 m_flags;
+            std::size_t         m_offset;  // into m_chars, zero terminated
+        };
+
+        void vertex(float x, float y, ALLEGRO_COLOR color);
+
+        std::vector<ALLEGRO_VERTEX>  m_vertices;
+        std::vector<label>           m_labels;
+        std::vector<char>            m_chars;
+        std::vector<overlay_widget*> m_widgets;
+        int                          m_w = 0;
+        int                          m_h = 0;
+        statistics                   m_stats;
+    };
+}
+#endif
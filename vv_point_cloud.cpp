@@ -0,0 +1,282 @@
+#include "vv_point_cloud.h"
+#include "vv_trace.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace vv_cloud
+{
+    bool point_cloud_renderer::open(const std::string& path)
+    {
+        VV_TRACE_SCOPE("load", "point cloud open");
+        close();
+        if (!m_file.open(path))
+            return false;
+        m_header = validate_point_cloud(m_file.data(), m_file.size());
+        if (!m_header)
+        {
+            m_file.close();
+            return false;
+        }
+
+        const char* base = static_cast<const char*>(m_file.data());
+        m_nodes  = reinterpret_cast<const node_record*>(base + m_header->m_nodes_offset);
+        m_points = reinterpret_cast<const point_record*>(base + m_header->m_points_offset);
+
+        m_node_slot.assign(m_header->m_node_count, -1);
+        return true;
+    }
+
+    void point_cloud_renderer::close()
+    {
+        release_gl();
+        m_file.close();
+        m_header = nullptr;
+        m_nodes = nullptr;
+        m_points = nullptr;
+        m_node_slot.clear();
+    }
+
+    void point_cloud_renderer::set_budget(std::size_t memory_bytes, unsigned upload_points_per_frame)
+    {
+        // a smaller budget takes effect as nodes get evicted
+        m_memory_budget = memory_bytes;
+        m_upload_budget = upload_points_per_frame;
+    }
+
+    void point_cloud_renderer::release_gl()
+    {
+        for (slot& s : m_slots)
+            if (s.m_vbo)
+                glDeleteBuffers(1, &s.m_vbo);
+        m_slots.clear();
+        m_gpu_bytes = 0;
+        std::fill(m_node_slot.begin(), m_node_slot.end(), -1);
+    }
+
+    void point_cloud_renderer::evict(slot& s)
+    {
+        if (s.m_node < 0)
+            return;
+        m_node_slot[s.m_node] = -1;
+        s.m_node = -1;
+        s.m_count = 0;
+        m_stats.m_evicted_nodes++;
+        m_stats.m_resident_nodes--;
+    }
+
+    void point_cloud_renderer::free_slot(slot& s)
+    {
+        evict(s);
+        glDeleteBuffers(1, &s.m_vbo);
+        m_gpu_bytes -= s.m_capacity * sizeof(point_record);
+        s = slot();
+    }
+
+    int point_cloud_renderer::find_slot(uint32_t count)
+    {
+        const std::size_t bytes = count * sizeof(point_record);
+        if (bytes > m_memory_budget)
+            return -1;
+
+        // an empty buffer that fits, the tightest one
+        int best = -1;
+        for (std::size_t i = 0; i < m_slots.size(); i++)
+        {
+            const slot& s = m_slots[i];
+            if (s.m_vbo && s.m_node < 0 && s.m_capacity >= count &&
+                (best < 0 || s.m_capacity < m_slots[best].m_capacity))
+                best = static_cast<int>(i);
+        }
+        if (best >= 0)
+            return best;
+
+        // under the budget: a new buffer sized to the node
+        if (m_gpu_bytes + bytes > m_memory_budget)
+        {
+            // the least recently used node whose buffer fits gives it up
+            for (std::size_t i = 0; i < m_slots.size(); i++)
+            {
+                const slot& s = m_slots[i];
+                if (s.m_vbo && s.m_last_used != m_frame && s.m_capacity >= count &&
+                    (best < 0 || s.m_last_used < m_slots[best].m_last_used))
+                    best = static_cast<int>(i);
+            }
+            if (best >= 0)
+            {
+                evict(m_slots[best]);
+                return best;
+            }
+
+            // none does: free empty buffers, then old nodes, until the new one fits
+            std::vector<std::pair<unsigned, std::size_t>> order;
+            for (std::size_t i = 0; i < m_slots.size(); i++)
+            {
+                const slot& s = m_slots[i];
+                if (s.m_vbo && (s.m_node < 0 || s.m_last_used != m_frame))
+                    order.push_back(std::make_pair(s.m_node < 0 ? 0u : s.m_last_used + 1, i));
+            }
+            std::sort(order.begin(), order.end());
+            std::size_t freeable = 0;
+            for (const auto& o : order)
+                freeable += m_slots[o.second].m_capacity * sizeof(point_record);
+            if (m_gpu_bytes - freeable + bytes > m_memory_budget)
+                return -1;  // the whole budget is in use by this frame
+            for (const auto& o : order)
+            {
+                if (m_gpu_bytes + bytes <= m_memory_budget)
+                    break;
+                free_slot(m_slots[o.second]);
+            }
+        }
+
+        for (std::size_t i = 0; i < m_slots.size() && best < 0; i++)
+            if (!m_slots[i].m_vbo)
+                best = static_cast<int>(i);
+        if (best < 0)
+        {
+            best = static_cast<int>(m_slots.size());
+            m_slots.push_back(slot());
+        }
+        slot& s = m_slots[best];
+        glGenBuffers(1, &s.m_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, s.m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        s.m_capacity = count;
+        m_gpu_bytes += bytes;
+        return best;
+    }
+
+    void point_cloud_renderer::begin_frame()
+    {
+        m_frame++;
+        m_uploaded = 0;
+        m_stats = statistics();
+        for (const slot& s : m_slots)
+            if (s.m_node >= 0)
+                m_stats.m_resident_nodes++;
+        m_stats.m_gpu_bytes = m_gpu_bytes;
+    }
+
+    void point_cloud_renderer::select(const vv_scene::frustum& f, const double vp[16], double model_scale,
+                                      double pixel_scale, std::vector<uint32_t>& nodes)
+    {
+        nodes.clear();
+        if (!is_open())
+            return;
+
+        m_stack.clear();
+        m_candidates.clear();
+        m_stack.push_back(0);
+        while (!m_stack.empty())
+        {
+            const uint32_t n = m_stack.back();
+            m_stack.pop_back();
+            const node_record& node = m_nodes[n];
+
+            vv_scene::aabb box;
+            std::copy(node.m_min, node.m_min + 3, box.m_min);
+            std::copy(node.m_max, node.m_max + 3, box.m_max);
+            if (!f.intersects(box))
+                continue;
+
+            double c[3];
+            double radius = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                c[k] = (node.m_min[k] + node.m_max[k]) / 2;
+                radius += (node.m_max[k] - c[k]) * (node.m_max[k] - c[k]);
+            }
+            // clip w is the distance along the view direction in world units, the node sizes follow it
+            radius = std::sqrt(radius) * model_scale;
+            const double w = vp[3] * c[0] + vp[7] * c[1] + vp[11] * c[2] + vp[15];
+            const double nearest = std::max(w - radius, 1e-3);
+            const double spacing_px = node.m_spacing * model_scale * pixel_scale / nearest;
+
+            if (node.m_point_count > 0)
+                m_candidates.push_back(std::make_pair(static_cast<float>(radius * pixel_scale / std::max(w, 1e-3)), n));
+            if (spacing_px > m_pixel_spacing)
+                for (int i = 0; i < 8; i++)
+                    if (node.m_children[i] >= 0)
+                        m_stack.push_back(static_cast<uint32_t>(node.m_children[i]));
+        }
+
+        // biggest on screen first
+        std::sort(m_candidates.begin(), m_candidates.end(), std::greater<std::pair<float, uint32_t>>());
+        m_stats.m_selected_nodes += m_candidates.size();
+
+        // keep what is already resident before evicting anything
+        for (const auto& c : m_candidates)
+        {
+            const int32_t s = m_node_slot[c.second];
+            if (s >= 0)
+                m_slots[s].m_last_used = m_frame;
+        }
+        for (const auto& c : m_candidates)
+        {
+            if (m_node_slot[c.second] >= 0 || upload(c.second))
+                nodes.push_back(c.second);
+            else
+                m_stats.m_missing_nodes++;
+        }
+    }
+
+    bool point_cloud_renderer::upload(uint32_t n)
+    {
+        const uint32_t count = m_nodes[n].m_point_count;
+        if (m_uploaded > 0 && m_uploaded + count > m_upload_budget)
+            return false;
+
+        const int best = find_slot(count);
+        if (best < 0)
+            return false;
+        slot& s = m_slots[best];
+        m_stats.m_resident_nodes++;
+
+        // straight from the mapping, the OS pages the node in on demand
+        VV_TRACE_SCOPE("load", "point cloud node upload");
+        glBindBuffer(GL_ARRAY_BUFFER, s.m_vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(point_record), m_points + m_nodes[n].m_first_point);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        s.m_node = static_cast<int32_t>(n);
+        s.m_count = count;
+        s.m_last_used = m_frame;
+        m_node_slot[n] = best;
+        m_uploaded += count;
+        m_stats.m_uploaded_nodes++;
+        m_stats.m_uploaded_bytes += count * sizeof(point_record);
+        m_stats.m_gpu_bytes = m_gpu_bytes;
+        return true;
+    }
+
+    void point_cloud_renderer::draw(const std::vector<uint32_t>& nodes)
+    {
+        if (nodes.empty())
+            return;
+
+        glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT);
+        glDisable(GL_LIGHTING);
+        glPointSize(m_point_size);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        for (uint32_t n : nodes)
+        {
+            const int32_t index = m_node_slot[n];
+            if (index < 0)
+                continue;
+            const slot& s = m_slots[index];
+            glBindBuffer(GL_ARRAY_BUFFER, s.m_vbo);
+            glVertexPointer(3, GL_FLOAT, sizeof(point_record), reinterpret_cast<const void*>(0));
+            glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(point_record), reinterpret_cast<const void*>(12));
+            glDrawArrays(GL_POINTS, 0, s.m_count);
+            m_stats.m_drawn_points += s.m_count;
+            m_stats.m_draw_calls++;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glPopAttrib();
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef vv_point_cloud_h
+#define vv_point_cloud_h
+#include <allegro5/allegro_opengl.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "vv_mapped_file.h"
+#include "vv_point_cloud_file.h"
+#include "vv_scene.h"
+
+namespace vv_cloud
+{
+    // Streams octree nodes of a memory mapped point cloud into vertex buffers
+    // under a GPU memory budget. Nodes are requested by projected point density
+    // and uploaded within a per-frame budget. Each buffer is created when first
+    // needed, sized to its node, and taken over by a later node that fits;
+    // over the budget the least recently used nodes are evicted first.
+    class point_cloud_renderer
+    {
+    public:
+        struct statistics
+        {
+            unsigned m_resident_nodes  = 0;
+            unsigned m_selected_nodes  = 0;
+            unsigned m_missing_nodes   = 0; // selected but not uploaded yet
+            unsigned m_uploaded_nodes  = 0;
+            unsigned m_uploaded_bytes  = 0;
+            unsigned m_evicted_nodes   = 0;
+            unsigned m_drawn_points    = 0;
+            unsigned m_draw_calls      = 0;
+            std::size_t m_gpu_bytes    = 0; // vertex buffers, resident or kept for reuse
+        };
+
+        // GL objects must be released with release_gl() while the context is alive
+        bool open(const std::string& path);
+        void close();
+        bool is_open() const {return m_header != nullptr;}
+        const file_header* header() const {return m_header;}
+
+        // vertex buffer memory and upload budget in points per frame
+        void set_budget(std::size_t memory_bytes, unsigned upload_points_per_frame);
+        // refine nodes until their points are at most this many pixels apart
+        void set_pixel_spacing(float pixels) {m_pixel_spacing = pixels;}
+        float get_pixel_spacing() const      {return m_pixel_spacing;}
+        void set_point_size(float size)      {m_point_size = size;}
+
+        void begin_frame();
+        // picks the nodes to draw for one view and uploads missing ones; view_projection
+        // maps cloud space to clip space, model_scale cloud units to world units
+        void select(const vv_scene::frustum& f, const double view_projection[16], double model_scale,
+                    double pixel_scale, std::vector<uint32_t>& nodes);
+        void draw(const std::vector<uint32_t>& nodes);
+        void release_gl();
+
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        struct slot
+        {
+            GLuint   m_vbo       = 0;   // 0 for an unused entry
+            uint32_t m_capacity  = 0;   // points
+            int32_t  m_node      = -1;
+            uint32_t m_count     = 0;
+            unsigned m_last_used = 0;
+        };
+
+        bool upload(uint32_t node);
+        // a slot holding at least count points, -1 when the budget can't make room this frame
+        int find_slot(uint32_t count);
+        void evict(slot& s);
+        void free_slot(slot& s);
+
+        vv_mem::mapped_file  m_file;
+        const file_header*   m_header = nullptr;
+        const node_record*   m_nodes  = nullptr;
+        const point_record*  m_points = nullptr;
+
+        std::vector<slot>    m_slots;
+        std::vector<int32_t> m_node_slot;         // node -> slot or -1
+        std::vector<uint32_t> m_stack;
+        std::vector<std::pair<float, uint32_t>> m_candidates;
+
+        std::size_t m_memory_budget = std::size_t(128) << 20;
+        std::size_t m_gpu_bytes     = 0;
+        unsigned   m_upload_budget = 1 << 20;
+        unsigned   m_uploaded      = 0;
+        unsigned   m_frame         = 0;
+        float      m_pixel_spacing = 2.f;
+        float      m_point_size    = 2.f;
+        statistics m_stats;
+    };
+}
+#endif
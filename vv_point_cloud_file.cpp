@@ -0,0 +1,201 @@
+#include "vv_point_cloud_file.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+
+namespace vv_cloud
+{
+    namespace
+    {
+        struct octree_builder
+        {
+            static const uint32_t max_level = 24;
+
+            std::vector<point_record>&   m_points;
+            std::vector<node_record>     m_nodes;
+            uint32_t                     m_capacity;
+            std::unordered_set<uint64_t> m_cells;
+
+            octree_builder(std::vector<point_record>& points, uint32_t capacity)
+                : m_points(points), m_capacity(capacity) {}
+
+            // moves a spatially uniform subsample of at most m_capacity points
+            // to the front of the range, returns the end of the subsample
+            std::size_t select_subsample(std::size_t begin, std::size_t end, const float mn[3], const float mx[3])
+            {
+                const uint32_t g = std::max<uint32_t>(1, static_cast<uint32_t>(std::sqrt(double(m_capacity))));
+                float scale[3];
+                for (int k = 0; k < 3; k++)
+                    scale[k] = mx[k] > mn[k] ? g / (mx[k] - mn[k]) : 0.f;
+
+                m_cells.clear();
+                std::size_t keep = begin;
+                for (std::size_t i = begin; i < end && keep - begin < m_capacity; i++)
+                {
+                    uint64_t key = 0;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        uint32_t c = static_cast<uint32_t>((m_points[i].m_pos[k] - mn[k]) * scale[k]);
+                        key = key * g + std::min(c, g - 1);
+                    }
+                    if (m_cells.insert(key).second)
+                        std::swap(m_points[keep++], m_points[i]);
+                }
+                return keep;
+            }
+
+            int32_t build(std::size_t begin, std::size_t end, const float mn[3], const float mx[3], uint32_t level)
+            {
+                const int32_t index = static_cast<int32_t>(m_nodes.size());
+                m_nodes.push_back(node_record());
+                {
+                    node_record& node = m_nodes.back();
+                    std::memcpy(node.m_min, mn, sizeof(node.m_min));
+                    std::memcpy(node.m_max, mx, sizeof(node.m_max));
+                    node.m_level = level;
+                    node.m_reserved = 0;
+                    std::fill(node.m_children, node.m_children + 8, -1);
+                }
+
+                // leaves deeper than max_level keep everything, the renderer clamps them
+                std::size_t own_end = end;
+                if (end - begin > m_capacity && level < max_level)
+                    own_end = select_subsample(begin, end, mn, mx);
+
+                const std::size_t own = own_end - begin;
+                const float extent = std::max(mx[0] - mn[0], std::max(mx[1] - mn[1], mx[2] - mn[2]));
+                m_nodes[index].m_first_point = begin;
+                m_nodes[index].m_point_count = static_cast<uint32_t>(own);
+                m_nodes[index].m_spacing = extent / static_cast<float>(std::sqrt(double(std::max<std::size_t>(own, 1))));
+
+                if (own_end == end)
+                    return index;
+
+                // split the remaining points into octants: bit 0 - x, bit 1 - y, bit 2 - z
+                float mid[3];
+                for (int k = 0; k < 3; k++)
+                    mid[k] = (mn[k] + mx[k]) / 2;
+
+                std::size_t bounds[9];
+                bounds[0] = own_end;
+                bounds[8] = end;
+                auto split = [this, &mid](std::size_t b, std::size_t e, int axis)
+                {
+                    return static_cast<std::size_t>(std::partition(m_points.begin() + b, m_points.begin() + e,
+                        [&mid, axis](const point_record& p) {return p.m_pos[axis] < mid[axis];}) - m_points.begin());
+                };
+                bounds[4] = split(bounds[0], bounds[8], 2);
+                bounds[2] = split(bounds[0], bounds[4], 1);
+                bounds[6] = split(bounds[4], bounds[8], 1);
+                for (int q = 0; q < 8; q += 2)
+                    bounds[q + 1] = split(bounds[q], bounds[q + 2], 0);
+
+                for (int octant = 0; octant < 8; octant++)
+                {
+                    if (bounds[octant] == bounds[octant + 1])
+                        continue;
+                    float cmn[3], cmx[3];
+                    for (int k = 0; k < 3; k++)
+                    {
+                        const bool upper = (octant >> k) & 1;
+                        cmn[k] = upper ? mid[k] : mn[k];
+                        cmx[k] = upper ? mx[k] : mid[k];
+                    }
+                    int32_t child = build(bounds[octant], bounds[octant + 1], cmn, cmx, level + 1);
+                    m_nodes[index].m_children[octant] = child;
+                }
+                return index;
+            }
+        };
+    }
+
+    bool write_point_cloud(const std::string& path, std::vector<point_record>& points,
+                           uint32_t node_capacity, std::string& error)
+    {
+        if (points.empty())
+        {
+            error = "no points to write";
+            return false;
+        }
+        if (node_capacity == 0)
+        {
+            error = "node capacity must be positive";
+            return false;
+        }
+
+        float mn[3], mx[3];
+        for (int k = 0; k < 3; k++)
+            mn[k] = mx[k] = points[0].m_pos[k];
+        for (const point_record& p : points)
+            for (int k = 0; k < 3; k++)
+            {
+                mn[k] = std::min(mn[k], p.m_pos[k]);
+                mx[k] = std::max(mx[k], p.m_pos[k]);
+            }
+
+        // cubic root node keeps octant cells cubic
+        const float extent = std::max(mx[0] - mn[0], std::max(mx[1] - mn[1], mx[2] - mn[2]));
+        float cube_max[3];
+        for (int k = 0; k < 3; k++)
+            cube_max[k] = mn[k] + extent;
+
+        octree_builder builder(points, node_capacity);
+        builder.build(0, points.size(), mn, cube_max, 0);
+
+        file_header header;
+        std::memcpy(header.m_magic, file_magic, sizeof(header.m_magic));
+        header.m_version = file_version;
+        header.m_node_count = static_cast<uint32_t>(builder.m_nodes.size());
+        header.m_point_count = points.size();
+        header.m_nodes_offset = sizeof(file_header);
+        header.m_points_offset = header.m_nodes_offset + builder.m_nodes.size() * sizeof(node_record);
+        std::memcpy(header.m_min, mn, sizeof(mn));
+        std::memcpy(header.m_max, mx, sizeof(mx));
+
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f)
+        {
+            error = "couldn't open " + path + " for writing";
+            return false;
+        }
+        bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+        ok = ok && std::fwrite(builder.m_nodes.data(), sizeof(node_record), builder.m_nodes.size(), f) == builder.m_nodes.size();
+        ok = ok && std::fwrite(points.data(), sizeof(point_record), points.size(), f) == points.size();
+        ok = (std::fclose(f) == 0) && ok;
+        if (!ok)
+            error = "write error in " + path;
+        return ok;
+    }
+
+    const file_header* validate_point_cloud(const void* data, std::size_t size)
+    {
+        if (!data || size < sizeof(file_header))
+            return nullptr;
+        const file_header* header = static_cast<const file_header*>(data);
+        if (std::memcmp(header->m_magic, file_magic, sizeof(file_magic)) != 0 ||
+                header->m_version != file_version)
+            return nullptr;
+        if (header->m_nodes_offset % alignof(node_record) != 0 ||
+                header->m_points_offset % alignof(point_record) != 0)
+            return nullptr;
+        if (header->m_node_count == 0 ||
+                header->m_nodes_offset + uint64_t(header->m_node_count) * sizeof(node_record) > size ||
+                header->m_points_offset + header->m_point_count * sizeof(point_record) > size)
+            return nullptr;
+
+        const node_record* nodes = reinterpret_cast<const node_record*>(
+            static_cast<const char*>(data) + header->m_nodes_offset);
+        for (uint32_t i = 0; i < header->m_node_count; i++)
+        {
+            if (nodes[i].m_first_point + nodes[i].m_point_count > header->m_point_count)
+                return nullptr;
+            for (int c = 0; c < 8; c++)
+                if (nodes[i].m_children[c] >= static_cast<int32_t>(header->m_node_count) ||
+                        (nodes[i].m_children[c] >= 0 && nodes[i].m_children[c] <= static_cast<int32_t>(i)))
+                    return nullptr;
+        }
+        return header;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef vv_point_cloud_file_h
+#define vv_point_cloud_file_h
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk point cloud: octree nodes in depth-first order, the points of every
+// node stored contiguously. Inner nodes hold a spatially uniform subsample, so
+// drawing a node and its loaded descendants refines the cloud additively.
+//
+// layout: file_header | node_record[node_count] | point_record[point_count]
+namespace vv_cloud
+{
+    const char     file_magic[8] = {'V', 'V', 'P', 'C', 'L', 'O', 'U', 'D'};
+    const uint32_t file_version  = 1;
+
+    struct file_header
+    {
+        char     m_magic[8];
+        uint32_t m_version;
+        uint32_t m_node_count;
+        uint64_t m_point_count;
+        uint64_t m_nodes_offset;
+        uint64_t m_points_offset;
+        float    m_min[3];
+        float    m_max[3];
+    };
+
+    struct node_record
+    {
+        float    m_min[3];
+        float    m_max[3];
+        float    m_spacing;      // typical distance between the node points
+        uint32_t m_level;
+        int32_t  m_children[8];  // -1 when absent
+        uint64_t m_first_point;
+        uint32_t m_point_count;
+        uint32_t m_reserved;
+    };
+
+    struct point_record
+    {
+        float   m_pos[3];
+        uint8_t m_rgba[4];
+    };
+
+    static_assert(sizeof(file_header) == 64, "unexpected file_header layout");
+    static_assert(sizeof(node_record) == 80, "unexpected node_record layout");
+    static_assert(sizeof(point_record) == 16, "unexpected point_record layout");
+
+    // Builds the octree in memory and writes it out. points are reordered.
+    bool write_point_cloud(const std::string& path, std::vector<point_record>& points,
+                           uint32_t node_capacity, std::string& error);
+
+    // Checks a mapped file, returns nullptr if it is not a valid point cloud
+    const file_header* validate_point_cloud(const void* data, std::size_t size);
+}
+#endif
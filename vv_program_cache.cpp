@@ -0,0 +1,249 @@
+#include "vv_program_cache.h"
+#include "vv_gl_ext.h"
+#include <allegro5/allegro5.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace vv_gl
+{
+    namespace
+    {
+        const char     file_magic[4] = {'V', 'V', 'P', 'B'};
+        const uint32_t file_version  = 1;
+
+        // followed by the driver string and the binary
+        struct file_header
+        {
+            char     m_magic[4];
+            uint32_t m_version;
+            uint64_t m_key;
+            uint32_t m_format;
+            uint32_t m_driver_length;
+            uint32_t m_binary_length;
+            float    m_compile_ms;  // what loading this binary saves
+        };
+
+        uint64_t fnv1a(uint64_t hash, const void* data, std::size_t size)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (std::size_t i = 0; i < size; i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return hash;
+        }
+
+        uint64_t fnv1a(uint64_t hash, const char* str)
+        {
+            // the terminator keeps "ab" + "c" apart from "a" + "bc"
+            return fnv1a(hash, str ? str : "", str ? std::strlen(str) + 1 : 1);
+        }
+
+        std::string gl_string(GLenum name)
+        {
+            const GLubyte* s = glGetString(name);
+            return s ? reinterpret_cast<const char*>(s) : "";
+        }
+
+        // defines have to come after #version, which must stay the first line
+        std::string with_defines(const char* source, const std::string& defines)
+        {
+            std::string s = source;
+            if (defines.empty())
+                return s;
+            std::size_t at = 0;
+            if (s.compare(0, 8, "#version") == 0)
+            {
+                at = s.find('\n');
+                at = at == std::string::npos ? s.size() : at + 1;
+            }
+            std::string d = defines;
+            if (d.back() != '\n')
+                d += '\n';
+            s.insert(at, d);
+            return s;
+        }
+    }
+
+    void program_cache::open(const std::string& directory)
+    {
+        m_directory = directory;
+        m_driver = gl_string(GL_VENDOR) + "\n" + gl_string(GL_RENDERER) + "\n" + gl_string(GL_VERSION);
+
+        GLint formats = 0;
+        const extensions& ext = get_extensions();
+        if (ext.m_get_program_binary && ext.m_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        m_binaries = formats > 0 && !directory.empty() && al_make_directory(directory.c_str());
+    }
+
+    void program_cache::release_gl()
+    {
+        for (const auto& p : m_programs)
+            glDeleteProgram(p.second);
+        m_programs.clear();
+    }
+
+    uint64_t program_cache::key(const program_source& source) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        hash = fnv1a(hash, source.m_vertex);
+        hash = fnv1a(hash, source.m_fragment);
+        hash = fnv1a(hash, source.m_compute);
+        hash = fnv1a(hash, source.m_defines.c_str());
+        for (const attribute_binding& a : source.m_attributes)
+        {
+            hash = fnv1a(hash, &a.m_location, sizeof(a.m_location));
+            hash = fnv1a(hash, a.m_name);
+        }
+        return fnv1a(hash, m_driver.c_str());
+    }
+
+    std::string program_cache::path(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.bin", static_cast<unsigned long long>(key));
+        return m_directory + name;
+    }
+
+    GLuint program_cache::get(const program_source& source, std::string& log)
+    {
+        log.clear();
+        const uint64_t k = key(source);
+        auto it = m_programs.find(k);
+        if (it != m_programs.end())
+            return it->second;
+
+        if (m_binaries)
+        {
+            const double start = al_get_time();
+            double compile_ms = 0;
+            const GLuint program = load(k, compile_ms);
+            if (program)
+            {
+                const double load_ms = (al_get_time() - start) * 1000;
+                m_stats.m_hits++;
+                m_stats.m_load_ms += load_ms;
+                m_stats.m_saved_ms += std::max(0.0, compile_ms - load_ms);
+                m_programs[k] = program;
+                return program;
+            }
+        }
+
+        const double start = al_get_time();
+        GLuint program = 0;
+        if (source.m_compute)
+        {
+            const std::string compute = with_defines(source.m_compute, source.m_defines);
+            program = build_compute_program(compute.c_str(), log, m_binaries);
+        }
+        else
+        {
+            const std::string vertex = with_defines(source.m_vertex, source.m_defines);
+            const std::string fragment = with_defines(source.m_fragment, source.m_defines);
+            program = build_program(vertex.c_str(), fragment.c_str(), source.m_attributes, log, m_binaries);
+        }
+        const double compile_ms = (al_get_time() - start) * 1000;
+        if (!program)
+        {
+            m_stats.m_failures++;
+            return 0;
+        }
+        m_stats.m_misses++;
+        m_stats.m_compile_ms += compile_ms;
+        if (m_binaries)
+            store(k, program, compile_ms);
+        m_programs[k] = program;
+        return program;
+    }
+
+    GLuint program_cache::load(uint64_t key, double& compile_ms)
+    {
+        const std::string file_path = path(key);
+        FILE* f = std::fopen(file_path.c_str(), "rb");
+        if (!f)
+            return 0;
+
+        // the lengths in the header are only trusted when they add up to the file size
+        long file_size = -1;
+        if (std::fseek(f, 0, SEEK_END) == 0)
+            file_size = std::ftell(f);
+        file_header h;
+        std::string driver;
+        std::vector<char> binary;
+        bool valid = file_size > 0 && std::fseek(f, 0, SEEK_SET) == 0 &&
+                     std::fread(&h, sizeof(h), 1, f) == 1 &&
+                     std::memcmp(h.m_magic, file_magic, sizeof(file_magic)) == 0 &&
+                     h.m_version == file_version && h.m_key == key &&
+                     h.m_driver_length == m_driver.size() &&
+                     uint64_t(file_size) == sizeof(h) + uint64_t(h.m_driver_length) + h.m_binary_length;
+        if (valid)
+        {
+            driver.resize(h.m_driver_length);
+            binary.resize(h.m_binary_length);
+            valid = (driver.empty() || std::fread(&driver[0], driver.size(), 1, f) == 1) &&
+                    driver == m_driver && !binary.empty() &&
+                    std::fread(binary.data(), binary.size(), 1, f) == 1;
+        }
+        std::fclose(f);
+
+        GLuint program = 0;
+        if (valid)
+        {
+            program = glCreateProgram();
+            get_extensions().m_program_binary(program, h.m_format, binary.data(), static_cast<GLsizei>(binary.size()));
+            GLint ok = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &ok);
+            if (!ok)
+            {
+                glDeleteProgram(program);
+                program = 0;
+            }
+        }
+        if (!program)
+        {
+            // driver update or a broken file, compile and write it again
+            m_stats.m_rejected++;
+            std::remove(file_path.c_str());
+            return 0;
+        }
+        compile_ms = h.m_compile_ms;
+        return program;
+    }
+
+    void program_cache::store(uint64_t key, GLuint program, double compile_ms)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        get_extensions().m_get_program_binary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return;
+
+        file_header h;
+        std::memcpy(h.m_magic, file_magic, sizeof(file_magic));
+        h.m_version = file_version;
+        h.m_key = key;
+        h.m_format = format;
+        h.m_driver_length = static_cast<uint32_t>(m_driver.size());
+        h.m_binary_length = static_cast<uint32_t>(written);
+        h.m_compile_ms = static_cast<float>(compile_ms);
+
+        // a half written file must never be picked up, write aside and rename
+        const std::string file_path = path(key);
+        const std::string temp_path = file_path + ".tmp";
+        FILE* f = std::fopen(temp_path.c_str(), "wb");
+        if (!f)
+            return;
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+                  std::fwrite(m_driver.data(), m_driver.size(), 1, f) == 1 &&
+                  std::fwrite(binary.data(), written, 1, f) == 1;
+        ok = std::fclose(f) == 0 && ok;
+        std::remove(file_path.c_str());
+        if (!ok || std::rename(temp_path.c_str(), file_path.c_str()) != 0)
+            std::remove(temp_path.c_str());
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef vv_program_cache_h
+#define vv_program_cache_h
+#include <allegro5/allegro_opengl.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vv_shader.h"
+
+namespace vv_gl
+{
+    // everything a linked program depends on, besides the driver
+    struct program_source
+    {
+        const char*                    m_vertex   = nullptr;
+        const char*                    m_fragment = nullptr;
+        const char*                    m_compute  = nullptr;  // a compute program instead of the two above
+        std::string                    m_defines;  // "#define NAME VALUE" lines, go after #version
+        std::vector<attribute_binding> m_attributes;
+    };
+
+    // Linked GLSL programs, kept as driver binaries on disk between launches
+    // (ARB_get_program_binary). A program is keyed by a hash of its sources,
+    // defines, attribute bindings and the GL vendor, renderer and version
+    // strings, one file per key in the cache directory. A binary the driver
+    // rejects, or one written for another driver, is deleted and the program
+    // compiled again, so a stale cache only costs the compile time.
+    // Programs belong to the cache and live until release_gl().
+    class program_cache
+    {
+    public:
+        struct statistics
+        {
+            unsigned m_hits     = 0;  // loaded from a binary
+            unsigned m_misses   = 0;  // compiled, binary stored when possible
+            unsigned m_rejected = 0;  // binaries that didn't load, counted as misses too
+            unsigned m_failures = 0;  // didn't compile
+            double   m_load_ms    = 0;
+            double   m_compile_ms = 0;
+            double   m_saved_ms   = 0;  // stored compile time of the hits minus their load time
+        };
+
+        // needs a current GL context, an empty directory keeps the cache in memory only
+        void open(const std::string& directory);
+        // GL objects must be released with release_gl() while the context is alive
+        void release_gl();
+        bool binaries_supported() const {return m_binaries;}
+
+        // 0 and the compiler output in log when the sources don't build
+        GLuint get(const program_source& source, std::string& log);
+
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        uint64_t key(const program_source& source) const;
+        std::string path(uint64_t key) const;
+        GLuint load(uint64_t key, double& compile_ms);
+        void store(uint64_t key, GLuint program, double compile_ms);
+
+        std::string                          m_directory;
+        std::string                          m_driver;  // vendor, renderer and version
+        bool                                 m_binaries = false;
+        std::unordered_map<uint64_t, GLuint> m_programs;
+        statistics                           m_stats;
+    };
+}
+#endif
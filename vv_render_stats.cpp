@@ -0,0 +1,108 @@
+#include "vv_render_stats.h"
+#include <algorithm>
+
+namespace vv_gl
+{
+    pass_stats& pass_stats::operator+=(const pass_stats& other)
+    {
+        m_objects       += other.m_objects;
+        m_draw_calls    += other.m_draw_calls;
+        m_triangles     += other.m_triangles;
+        m_vertices      += other.m_vertices;
+        m_lines         += other.m_lines;
+        m_state_changes += other.m_state_changes;
+        m_texture_binds += other.m_texture_binds;
+        m_al_draw_calls += other.m_al_draw_calls;
+        m_buffer_bytes  += other.m_buffer_bytes;
+        return *this;
+    }
+
+    pass_stats render_stats::frame::total() const
+    {
+        pass_stats sum;
+        for (const pass_stats& p : m_passes)
+            sum += p;
+        return sum;
+    }
+
+    render_stats::render_stats(std::size_t history_frames)
+        : m_history(std::max<std::size_t>(1, history_frames))
+    {
+    }
+
+    const char* render_stats::name(pass_id p)
+    {
+        static const char* names[pass_count + 1] = {"scene", "HUD", "ImGui", "total"};
+        return names[std::min<int>(p, pass_count)];
+    }
+
+    const char* render_stats::name(counter c)
+    {
+        static const char* names[counter_count] =
+        {
+            "objects", "draw calls", "triangles", "vertices", "lines", "state changes", "texture binds",
+            "al_draw calls", "buffer bytes"
+        };
+        return c < counter_count ? names[c] : "";
+    }
+
+    double render_stats::value(const pass_stats& s, counter c)
+    {
+        switch (c)
+        {
+        case objects:       return s.m_objects;
+        case draw_calls:    return s.m_draw_calls;
+        case triangles:     return s.m_triangles;
+        case vertices:      return s.m_vertices;
+        case lines:         return s.m_lines;
+        case state_changes: return s.m_state_changes;
+        case texture_binds: return s.m_texture_binds;
+        case al_draw_calls: return s.m_al_draw_calls;
+        case buffer_bytes:  return static_cast<double>(s.m_buffer_bytes);
+        default:            return 0;
+        }
+    }
+
+    void render_stats::begin_frame()
+    {
+        m_current = frame();
+    }
+
+    void render_stats::end_frame()
+    {
+        m_history[m_next] = m_current;
+        m_next = (m_next + 1) % m_history.size();
+        m_count = std::min(m_count + 1, m_history.size());
+    }
+
+    const render_stats::frame& render_stats::history(std::size_t frames_ago) const
+    {
+        static const frame empty;
+        if (frames_ago >= m_count)
+            return empty;
+        return m_history[(m_next + m_history.size() - 1 - frames_ago) % m_history.size()];
+    }
+
+    render_stats::summary render_stats::summarize(counter c, pass_id p, std::size_t frames) const
+    {
+        summary s;
+        const std::size_t n = frames ? std::min(frames, m_count) : m_count;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            const frame& f = history(i);
+            const double v = value(p < pass_count ? f.m_passes[p] : f.total(), c);
+            s.m_min = i ? std::min(s.m_min, v) : v;
+            s.m_max = i ? std::max(s.m_max, v) : v;
+            s.m_mean += v;
+        }
+        if (n)
+            s.m_mean /= n;
+        return s;
+    }
+
+    void render_stats::clear_history()
+    {
+        m_next = 0;
+        m_count = 0;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef vv_render_stats_h
+#define vv_render_stats_h
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vv_gl
+{
+    // what one pass of a frame submitted, filled in by the code that submits it
+    struct pass_stats
+    {
+        unsigned    m_objects       = 0;  // scene objects
+        unsigned    m_draw_calls    = 0;  // GL draws, a multi draw counts once
+        unsigned    m_triangles     = 0;
+        unsigned    m_vertices      = 0;  // as submitted, an index counts as a vertex
+        unsigned    m_lines         = 0;
+        unsigned    m_state_changes = 0;  // materials, programs, blend, depth, lighting and line state
+        unsigned    m_texture_binds = 0;
+        unsigned    m_al_draw_calls = 0;  // al_draw_* and its relatives
+        std::size_t m_buffer_bytes  = 0;  // vertex and index data sent to the GPU
+
+        pass_stats& operator+=(const pass_stats& other);
+    };
+
+    // Per-frame rendering counters, split by pass, with a rolling history.
+    // The render path adds to pass(), begin_frame() and end_frame() bracket
+    // a frame; the history is allocated once, counting never touches the heap.
+    class render_stats
+    {
+    public:
+        enum pass_id {scene, hud, imgui, pass_count};
+        enum counter
+        {
+            objects, draw_calls, triangles, vertices, lines, state_changes, texture_binds, al_draw_calls,
+            buffer_bytes, counter_count
+        };
+
+        struct frame
+        {
+            pass_stats m_passes[pass_count];
+            pass_stats total() const;
+        };
+
+        struct summary
+        {
+            double m_min  = 0;
+            double m_mean = 0;
+            double m_max  = 0;
+        };
+
+        explicit render_stats(std::size_t history_frames = 240);
+
+        static const char* name(pass_id p);
+        static const char* name(counter c);
+        static double value(const pass_stats& s, counter c);
+
+        void begin_frame();
+        void end_frame();
+        pass_stats& pass(pass_id p) {return m_current.m_passes[p];}
+        const frame& current() const {return m_current;}
+
+        // the last finished frame, zeros before the first one
+        const frame& last() const {return history(0);}
+        // finished frames kept, up to history_capacity()
+        std::size_t history_size() const {return m_count;}
+        std::size_t history_capacity() const {return m_history.size();}
+        // 0 is the last finished frame, older ones follow
+        const frame& history(std::size_t frames_ago) const;
+        // over the last frames of the history, all of it when frames is 0; p == pass_count is the total
+        summary summarize(counter c, pass_id p = pass_count, std::size_t frames = 0) const;
+        void clear_history();
+
+    protected:
+        frame              m_current;
+        std::vector<frame> m_history;
+        std::size_t        m_next  = 0;  // where end_frame() writes
+        std::size_t        m_count = 0;
+    };
+}
+#endif
@@ -0,0 +1,128 @@
+#include "vv_scene.h"
+#include <cmath>
+
+namespace vv_scene
+{
+    void frustum::from_matrix(const double m[16])
+    {
+        // row i of a column-major matrix is (m[i], m[4 + i], m[8 + i], m[12 + i])
+        for (int i = 0; i < 3; i++)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                m_planes[2 * i][k]     = m[4 * k + 3] + m[4 * k + i];
+                m_planes[2 * i + 1][k] = m[4 * k + 3] - m[4 * k + i];
+            }
+        }
+
+        for (int i = 0; i < 6; i++)
+        {
+            double len = std::sqrt(m_planes[i][0] * m_planes[i][0] +
+                                   m_planes[i][1] * m_planes[i][1] +
+                                   m_planes[i][2] * m_planes[i][2]);
+            if (len > 0)
+                for (int k = 0; k < 4; k++)
+                    m_planes[i][k] /= len;
+        }
+    }
+
+    bool frustum::intersects(const aabb& box) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            const double* p = m_planes[i];
+            // corner of the box farthest along the plane normal
+            double x = p[0] > 0 ? box.m_max[0] : box.m_min[0];
+            double y = p[1] > 0 ? box.m_max[1] : box.m_min[1];
+            double z = p[2] > 0 ? box.m_max[2] : box.m_min[2];
+            if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0)
+                return false;
+        }
+        return true;
+    }
+
+    std::size_t scene::add_box(float x, float y, float z, float half_size)
+    {
+        m_x.push_back(x);
+        m_y.push_back(y);
+        m_z.push_back(z);
+        m_half_size.push_back(half_size);
+        m_vx.push_back(0);
+        m_vy.push_back(0);
+        m_vz.push_back(0);
+        m_bounds.push_back(aabb());
+        m_texture.push_back(0);
+        update_bounds(size() - 1, size());
+        m_revision++;
+        return size() - 1;
+    }
+
+    void scene::clear()
+    {
+        m_x.clear();
+        m_y.clear();
+        m_z.clear();
+        m_half_size.clear();
+        m_vx.clear();
+        m_vy.clear();
+        m_vz.clear();
+        m_bounds.clear();
+        m_texture.clear();
+        m_moving = 0;
+        m_revision++;
+    }
+
+    void scene::set_velocity(std::size_t id, float vx, float vy, float vz)
+    {
+        const bool was_moving = m_vx[id] != 0 || m_vy[id] != 0 || m_vz[id] != 0;
+        const bool moving = vx != 0 || vy != 0 || vz != 0;
+        if (moving && !was_moving)
+            m_moving++;
+        else if (!moving && was_moving)
+            m_moving--;
+        m_vx[id] = vx;
+        m_vy[id] = vy;
+        m_vz[id] = vz;
+    }
+
+    void scene::integrate(std::size_t begin, std::size_t end, float dt, float limit)
+    {
+        // one pass per component, the arrays stream through independently
+        float* const positions[3] = {m_x.data(), m_y.data(), m_z.data()};
+        float* const velocities[3] = {m_vx.data(), m_vy.data(), m_vz.data()};
+        for (int k = 0; k < 3; k++)
+        {
+            float* p = positions[k];
+            float* v = velocities[k];
+            for (std::size_t i = begin; i < end; i++)
+            {
+                p[i] += v[i] * dt;
+                if ((p[i] > limit && v[i] > 0) || (p[i] < -limit && v[i] < 0))
+                    v[i] = -v[i];
+            }
+        }
+    }
+
+    void scene::update_bounds(std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; i++)
+        {
+            const float s = m_half_size[i];
+            aabb& b = m_bounds[i];
+            b.m_min[0] = m_x[i] - s;
+            b.m_min[1] = m_y[i] - s;
+            b.m_min[2] = m_z[i] - s;
+            b.m_max[0] = m_x[i] + s;
+            b.m_max[1] = m_y[i] + s;
+            b.m_max[2] = m_z[i] + s;
+        }
+    }
+
+    void scene::cull(const frustum& f, std::vector<uint32_t>& visible) const
+    {
+        visible.clear();
+        for (std::size_t i = 0; i < m_bounds.size(); i++)
+            if (f.intersects(m_bounds[i]))
+                visible.push_back(static_cast<uint32_t>(i));
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef vv_scene_h
+#define vv_scene_h
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vv_scene
+{
+    struct aabb
+    {
+        float m_min[3];
+        float m_max[3];
+    };
+
+    // View frustum planes (ax + by + cz + d >= 0 inside), extracted from
+    // a column-major view-projection matrix as used by OpenGL
+    struct frustum
+    {
+        double m_planes[6][4];
+
+        void from_matrix(const double m[16]);
+        bool intersects(const aabb& box) const;
+    };
+
+    // Scene objects stored as structure of arrays, object id is the index
+    class scene
+    {
+    public:
+        std::size_t add_box(float x, float y, float z, float half_size);
+        void clear();
+        std::size_t size() const {return m_x.size();}
+
+        // objects with a velocity move every frame, the others stay put
+        void set_velocity(std::size_t id, float vx, float vy, float vz);
+        // a texture handle of the renderer, 0 for none
+        void set_texture(std::size_t id, uint32_t texture) {m_texture[id] = texture;}
+        bool has_motion() const {return m_moving > 0;}
+        // changes when objects are added or removed; touch() after writing the arrays directly.
+        // integrate() leaves it alone, has_motion() tells about that
+        uint64_t revision() const {return m_revision;}
+        void touch() {m_revision++;}
+        // moves [begin, end) by dt, bouncing off the walls of the cube |x|,|y|,|z| <= limit
+        void integrate(std::size_t begin, std::size_t end, float dt, float limit);
+        void update_bounds(std::size_t begin, std::size_t end);
+        void cull(const frustum& f, std::vector<uint32_t>& visible) const;
+
+        std::vector<float> m_x;
+        std::vector<float> m_y;
+        std::vector<float> m_z;
+        std::vector<float> m_half_size;
+        std::vector<float> m_vx;
+        std::vector<float> m_vy;
+        std::vector<float> m_vz;
+        std::vector<aabb>  m_bounds;
+        std::vector<uint32_t> m_texture;
+
+    protected:
+        std::size_t m_moving = 0;
+        uint64_t    m_revision = 0;
+    };
+}
+#endif
@@ -0,0 +1,94 @@
+#include "vv_shader.h"
+#include "vv_gl_ext.h"
+
+namespace vv_gl
+{
+    static GLuint compile_shader(GLenum type, const char* source, std::string& log)
+    {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+
+        GLint ok = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (ok)
+            return shader;
+
+        GLint length = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::string info(length > 0 ? length : 1, '\0');
+        glGetShaderInfoLog(shader, static_cast<GLsizei>(info.size()), nullptr, &info[0]);
+        log += type == GL_VERTEX_SHADER ? "vertex shader: " : type == GL_FRAGMENT_SHADER ? "fragment shader: "
+                                                                                     : "compute shader: ";
+        log += info.c_str();
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    // the program after glLinkProgram, or 0 and the linker output in log
+    static GLuint link_status(GLuint program, std::string& log)
+    {
+        GLint ok = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (ok)
+            return program;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::string info(length > 0 ? length : 1, '\0');
+        glGetProgramInfoLog(program, static_cast<GLsizei>(info.size()), nullptr, &info[0]);
+        log += "link: ";
+        log += info.c_str();
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    GLuint build_program(const char* vertex_source, const char* fragment_source,
+                         const std::vector<attribute_binding>& attributes, std::string& log,
+                         bool retrievable)
+    {
+        log.clear();
+        GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_source, log);
+        GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_source, log);
+        if (!vs || !fs)
+        {
+            if (vs)
+                glDeleteShader(vs);
+            if (fs)
+                glDeleteShader(fs);
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vs);
+        glAttachShader(program, fs);
+        for (const attribute_binding& a : attributes)
+            glBindAttribLocation(program, a.m_location, a.m_name);
+        if (retrievable && get_extensions().m_program_parameteri)
+            get_extensions().m_program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        // the program keeps the compiled code, the shader objects can go
+        glDetachShader(program, vs);
+        glDetachShader(program, fs);
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return link_status(program, log);
+    }
+
+    GLuint build_compute_program(const char* source, std::string& log, bool retrievable)
+    {
+        log.clear();
+        GLuint cs = compile_shader(GL_COMPUTE_SHADER, source, log);
+        if (!cs)
+            return 0;
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, cs);
+        if (retrievable && get_extensions().m_program_parameteri)
+            get_extensions().m_program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        glDetachShader(program, cs);
+        glDeleteShader(cs);
+        return link_status(program, log);
+    }
+}
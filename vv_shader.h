@@ -0,0 +1,25 @@
+#ifndef vv_shader_h
+#define vv_shader_h
+#include <allegro5/allegro_opengl.h>
+#include <string>
+#include <vector>
+
+namespace vv_gl
+{
+    // generic vertex attribute bound to a fixed location before linking
+    struct attribute_binding
+    {
+        GLuint      m_location;
+        const char* m_name;
+    };
+
+    // Compiles and links a GLSL program, needs a current GL context.
+    // Returns 0 and the compiler or linker output in log on failure.
+    // retrievable asks the driver to keep the binary for glGetProgramBinary.
+    GLuint build_program(const char* vertex_source, const char* fragment_source,
+                         const std::vector<attribute_binding>& attributes, std::string& log,
+                         bool retrievable = false);
+    // the same for a compute shader alone, needs GL 4.3 or ARB_compute_shader
+    GLuint build_compute_program(const char* compute_source, std::string& log, bool retrievable = false);
+}
+#endif
@@ -0,0 +1,156 @@
+#include "vv_stream_buffer.h"
+#include "vv_gl_ext.h"
+#include <allegro5/allegro5.h>
+#include <cstring>
+
+namespace vv_gl
+{
+    bool stream_buffer::create(std::size_t size)
+    {
+        release_gl();
+
+        const extensions& ext = get_extensions();
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        if (ext.m_buffer_storage)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            ext.m_buffer_storage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            m_mapping = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+            if (!m_mapping)
+            {
+                // immutable storage can't be respecified, start over with a plain buffer
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                glDeleteBuffers(1, &m_buffer);
+                glGenBuffers(1, &m_buffer);
+                glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+            }
+        }
+        if (!m_mapping)
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        m_size = size;
+        m_head = 0;
+        m_frame_begin = 0;
+        m_frame_bytes = 0;
+        m_stats = statistics();
+        return m_buffer != 0;
+    }
+
+    void stream_buffer::release_gl()
+    {
+        while (m_fence_count > 0)
+        {
+            glDeleteSync(m_fences[m_fence_first].m_fence);
+            m_fence_first = (m_fence_first + 1) % max_fences;
+            m_fence_count--;
+        }
+        if (m_mapping)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            m_mapping = nullptr;
+        }
+        if (m_buffer)
+            glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        m_size = 0;
+    }
+
+    std::size_t stream_buffer::push(const void* data, std::size_t size, std::size_t align)
+    {
+        if (!m_buffer || size == 0 || size > m_size)
+            return npos;
+
+        std::size_t offset = (m_head + align - 1) / align * align;
+        if (offset + size > m_size)
+        {
+            // wrap around, the unfenced part of this frame gets its own fence
+            fence_current_range();
+            m_frame_begin = 0;
+            offset = 0;
+            m_stats.m_wraps++;
+        }
+
+        // fences signal in order, so retire the oldest until nothing overlaps
+        bool overlap = true;
+        while (overlap && m_fence_count > 0)
+        {
+            overlap = false;
+            for (int i = 0; i < m_fence_count && !overlap; i++)
+            {
+                const fenced_range& r = m_fences[(m_fence_first + i) % max_fences];
+                overlap = r.m_begin < offset + size && offset < r.m_end;
+            }
+            if (overlap)
+                wait_oldest();
+        }
+
+        if (m_mapping)
+        {
+            std::memcpy(m_mapping + offset, data, size);
+        }
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+            void* dst = glMapBufferRange(GL_ARRAY_BUFFER, offset, size,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (dst)
+            {
+                std::memcpy(dst, data, size);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            if (!dst)
+                return npos;
+        }
+
+        m_head = offset + size;
+        m_frame_bytes += size;
+        return offset;
+    }
+
+    void stream_buffer::end_frame()
+    {
+        fence_current_range();
+        m_stats.m_frame_bytes = m_frame_bytes;
+        m_frame_bytes = 0;
+    }
+
+    void stream_buffer::fence_current_range()
+    {
+        if (m_head == m_frame_begin || !m_buffer)
+            return;
+        if (m_fence_count == max_fences)
+            wait_oldest();
+
+        fenced_range& r = m_fences[(m_fence_first + m_fence_count) % max_fences];
+        r.m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        r.m_begin = m_frame_begin;
+        r.m_end = m_head;
+        m_fence_count++;
+        m_frame_begin = m_head;
+    }
+
+    void stream_buffer::wait_oldest()
+    {
+        fenced_range& r = m_fences[m_fence_first];
+        GLenum res = glClientWaitSync(r.m_fence, 0, 0);
+        if (res == GL_TIMEOUT_EXPIRED)
+        {
+            // the ring caught up with the GPU
+            m_stats.m_stalls++;
+            const double start = al_get_time();
+            do
+                res = glClientWaitSync(r.m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(100000000));
+            while (res == GL_TIMEOUT_EXPIRED);
+            m_stats.m_stall_seconds += al_get_time() - start;
+        }
+        glDeleteSync(r.m_fence);
+        r.m_fence = nullptr;
+        m_fence_first = (m_fence_first + 1) % max_fences;
+        m_fence_count--;
+    }
+}
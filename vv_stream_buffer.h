@@ -0,0 +1,65 @@
+#ifndef vv_stream_buffer_h
+#define vv_stream_buffer_h
+#include <allegro5/allegro_opengl.h>
+#include <cstddef>
+
+namespace vv_gl
+{
+    // Ring buffer for vertex and index data regenerated every frame.
+    // With ARB_buffer_storage the buffer is mapped once, persistently and coherently;
+    // otherwise every push maps its range unsynchronized. Ranges written by a frame
+    // are fenced in end_frame(); a push that would overwrite a range the GPU may
+    // still read waits on its fence, which is counted as a stall.
+    class stream_buffer
+    {
+    public:
+        static const std::size_t npos = static_cast<std::size_t>(-1);
+        static const int max_fences = 16;
+
+        struct statistics
+        {
+            unsigned    m_stalls        = 0;  // waits on unsignaled fences, total
+            double      m_stall_seconds = 0;
+            unsigned    m_wraps         = 0;
+            std::size_t m_frame_bytes   = 0;  // pushed during the last finished frame
+        };
+
+        // GL objects must be released with release_gl() while the context is alive
+        bool create(std::size_t size);
+        void release_gl();
+        bool is_created() const  {return m_buffer != 0;}
+        bool persistent() const  {return m_mapping != nullptr;}
+        GLuint buffer() const    {return m_buffer;}
+        std::size_t size() const {return m_size;}
+
+        // copies data into the ring, returns its byte offset in buffer() or npos
+        std::size_t push(const void* data, std::size_t size, std::size_t align = 16);
+        void end_frame();
+
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        struct fenced_range
+        {
+            GLsync      m_fence = nullptr;
+            std::size_t m_begin = 0;
+            std::size_t m_end   = 0;
+        };
+
+        void fence_current_range();
+        void wait_oldest();
+
+        GLuint       m_buffer  = 0;
+        std::size_t  m_size    = 0;
+        char*        m_mapping = nullptr;
+        std::size_t  m_head    = 0;
+        std::size_t  m_frame_begin = 0;  // start of the range not fenced yet
+        std::size_t  m_frame_bytes = 0;
+
+        fenced_range m_fences[max_fences];
+        int          m_fence_first = 0;
+        int          m_fence_count = 0;
+        statistics   m_stats;
+    };
+}
+#endif
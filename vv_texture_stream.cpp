@@ -0,0 +1,443 @@
+#include "vv_texture_stream.h"
+#include "vv_trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace vv_gl
+{
+    texture_streamer::texture_streamer(unsigned decoders)
+        : m_max_in_flight(2 * std::max(1u, decoders))
+    {
+        for (unsigned i = 0; i < std::max(1u, decoders); i++)
+            m_decoders.emplace_back(&texture_streamer::decoder_proc, this);
+    }
+
+    texture_streamer::~texture_streamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_cv.notify_all();
+        for (std::thread& t : m_decoders)
+            t.join();
+    }
+
+    void texture_streamer::release_gl()
+    {
+        for (texture& t : m_textures)
+        {
+            if (t.m_gl)
+                glDeleteTextures(1, &t.m_gl);
+            t.m_gl = 0;
+            t.m_resident = t.m_levels;
+            t.m_uploading = -1;
+            t.m_rows_done = 0;
+        }
+        m_stats.m_gpu_bytes = 0;
+    }
+
+    texture_streamer::handle texture_streamer::load(const std::string& path)
+    {
+        m_textures.push_back(texture());
+        m_textures.back().m_path = path;
+        return static_cast<handle>(m_textures.size());
+    }
+
+    void texture_streamer::request(handle h, float pixels)
+    {
+        if (!h || h > m_textures.size())
+            return;
+        texture& t = m_textures[h - 1];
+        if (t.m_used != m_frame)
+        {
+            t.m_used = m_frame;
+            t.m_pixels = pixels;
+        }
+        else
+            t.m_pixels = std::max(t.m_pixels, pixels);
+    }
+
+    bool texture_streamer::bind(handle h) const
+    {
+        const texture* t = h && h <= m_textures.size() ? &m_textures[h - 1] : nullptr;
+        const bool resident = t && t->m_gl && t->m_resident < t->m_levels;
+        glBindTexture(GL_TEXTURE_2D, resident ? t->m_gl : 0);
+        return resident;
+    }
+
+    std::unique_ptr<texture_streamer::mip_chain> texture_streamer::decode(const std::string& path)
+    {
+        // memory bitmaps are safe to use from a non-display thread, the flags are per thread
+        al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+        ALLEGRO_BITMAP* bmp = al_load_bitmap(path.c_str());
+        if (!bmp)
+            return nullptr;
+        std::unique_ptr<mip_chain> chain(new mip_chain());
+        mip_chain& c = *chain;
+        int w = al_get_bitmap_width(bmp), h = al_get_bitmap_height(bmp);
+        std::size_t size = 0;
+        // as GL sizes the levels: halved and rounded down, down to 1 x 1
+        while (c.m_levels < max_levels)
+        {
+            c.m_w[c.m_levels] = w;
+            c.m_h[c.m_levels] = h;
+            c.m_offset[c.m_levels] = size;
+            size += std::size_t(w) * h * 4;
+            c.m_levels++;
+            if (w == 1 && h == 1)
+                break;
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        c.m_pixels.resize(size);
+
+        ALLEGRO_LOCKED_REGION* region = al_lock_bitmap(bmp, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+        if (!region)
+        {
+            al_destroy_bitmap(bmp);
+            return nullptr;
+        }
+        const std::size_t row = std::size_t(c.m_w[0]) * 4;
+        for (int y = 0; y < c.m_h[0]; y++)
+        {
+            // GL rows are bottom-up
+            const unsigned char* src = static_cast<const unsigned char*>(region->data) + y * region->pitch;
+            std::memcpy(c.m_pixels.data() + (c.m_h[0] - 1 - y) * row, src, row);
+        }
+        al_unlock_bitmap(bmp);
+        al_destroy_bitmap(bmp);
+
+        // 2 x 2 box filter, the last column and row of odd sizes are folded into their neighbours
+        for (int l = 1; l < c.m_levels; l++)
+        {
+            const int sw = c.m_w[l - 1], sh = c.m_h[l - 1];
+            const unsigned char* src = c.m_pixels.data() + c.m_offset[l - 1];
+            unsigned char* dst = c.m_pixels.data() + c.m_offset[l];
+            for (int y = 0; y < c.m_h[l]; y++)
+            {
+                const unsigned char* r0 = src + std::size_t(std::min(2 * y, sh - 1)) * sw * 4;
+                const unsigned char* r1 = src + std::size_t(std::min(2 * y + 1, sh - 1)) * sw * 4;
+                for (int x = 0; x < c.m_w[l]; x++, dst += 4)
+                {
+                    const int x0 = std::min(2 * x, sw - 1) * 4, x1 = std::min(2 * x + 1, sw - 1) * 4;
+                    for (int k = 0; k < 4; k++)
+                        dst[k] = static_cast<unsigned char>((r0[x0 + k] + r0[x1 + k] + r1[x0 + k] + r1[x1 + k] + 2) / 4);
+                }
+            }
+        }
+        return chain;
+    }
+
+    std::size_t texture_streamer::level_bytes(const texture& t, int level)
+    {
+        return std::size_t(std::max(1, t.m_w >> level)) * std::max(1, t.m_h >> level) * 4;
+    }
+
+    void texture_streamer::decoder_proc()
+    {
+        vv_trace::set_thread_name("texture decoder");
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cv.wait(lock, [this] {return m_quit || !m_queue.empty();});
+            if (m_quit)
+                break;
+            decode_job j = std::move(m_queue.front());
+            m_queue.pop_front();
+            lock.unlock();
+
+            decode_result r;
+            r.m_handle = j.m_handle;
+            {
+                VV_TRACE_SCOPE("job", "texture decode");
+                r.m_chain = decode(j.m_path);
+            }
+
+            lock.lock();
+            m_results.push_back(std::move(r));
+        }
+    }
+
+    int texture_streamer::wanted_level(const texture& t) const
+    {
+        // a texel per pixel across the drawing
+        const float texels = static_cast<float>(std::max(t.m_w, t.m_h));
+        const int level = static_cast<int>(std::floor(std::log2(texels / std::max(t.m_pixels, 1.f))));
+        return std::max(0, std::min(level, t.m_tail));
+    }
+
+    void texture_streamer::take_results()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_taken.swap(m_results);
+        }
+        for (decode_result& r : m_taken)
+        {
+            texture& t = m_textures[r.m_handle - 1];
+            t.m_decoding = false;
+            m_in_flight--;
+            if (!r.m_chain)
+            {
+                std::cout << "couldn't read texture " << t.m_path << std::endl;
+                t.m_failed = true;
+                continue;
+            }
+            const mip_chain& c = *r.m_chain;
+            if (!t.m_levels)
+            {
+                t.m_w = c.m_w[0];
+                t.m_h = c.m_h[0];
+                t.m_levels = c.m_levels;
+                t.m_tail = c.m_levels - 1;
+                while (t.m_tail > 0 && std::max(c.m_w[t.m_tail - 1], c.m_h[t.m_tail - 1]) <= tail_size)
+                    t.m_tail--;
+                t.m_resident = t.m_levels;
+            }
+            else if (c.m_levels != t.m_levels || c.m_w[0] != t.m_w || c.m_h[0] != t.m_h)
+            {
+                std::cout << "texture " << t.m_path << " changed its size, keeping the old levels" << std::endl;
+                continue;
+            }
+            m_stats.m_cpu_bytes += c.m_pixels.size();
+            t.m_chain = std::move(r.m_chain);
+        }
+        m_taken.clear();
+    }
+
+    void texture_streamer::evict_level(texture& t)
+    {
+        // the level being filled is the finest one, then the finest complete one
+        const int level = t.m_uploading >= 0 ? t.m_uploading : t.m_resident;
+        glBindTexture(GL_TEXTURE_2D, t.m_gl);
+        if (t.m_uploading >= 0)
+        {
+            t.m_uploading = -1;
+            t.m_rows_done = 0;
+        }
+        else
+        {
+            t.m_resident++;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, t.m_resident);
+        }
+        // an empty image frees the level, it lies outside base..max and doesn't affect completeness
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        m_stats.m_gpu_bytes -= level_bytes(t, level);
+        m_stats.m_evicted_levels++;
+    }
+
+    void texture_streamer::evict(std::size_t target, uint64_t last_frame)
+    {
+        if (m_stats.m_gpu_bytes <= target)
+            return;
+        // what nobody looked at for the longest time goes first
+        auto want = [this, last_frame](const texture& t) {return t.m_used == last_frame ? wanted_level(t) : t.m_tail;};
+        auto excess = [&want](const texture& t)
+        {
+            const int w = want(t);
+            return t.m_gl && ((t.m_uploading >= 0 && t.m_uploading < w) || t.m_resident < w);
+        };
+        m_evict_order.clear();
+        for (uint32_t i = 0; i < m_textures.size(); i++)
+            if (excess(m_textures[i]))
+                m_evict_order.push_back(i);
+        std::sort(m_evict_order.begin(), m_evict_order.end(),
+                  [this](uint32_t a, uint32_t b) {return m_textures[a].m_used < m_textures[b].m_used;});
+        for (uint32_t i : m_evict_order)
+        {
+            texture& t = m_textures[i];
+            while (m_stats.m_gpu_bytes > target && excess(t))
+                evict_level(t);
+            if (m_stats.m_gpu_bytes <= target)
+                break;
+        }
+    }
+
+    void texture_streamer::upload_tail(texture& t)
+    {
+        const mip_chain& c = *t.m_chain;
+        if (!t.m_gl)
+            glGenTextures(1, &t.m_gl);
+        glBindTexture(GL_TEXTURE_2D, t.m_gl);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, t.m_levels - 1);
+        for (int l = t.m_tail; l < t.m_levels; l++)
+        {
+            glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8, c.m_w[l], c.m_h[l], 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                         c.m_pixels.data() + c.m_offset[l]);
+            m_stats.m_gpu_bytes += level_bytes(t, l);
+            m_stats.m_uploaded_bytes += level_bytes(t, l);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, t.m_tail);
+        t.m_resident = t.m_tail;
+        m_stats.m_uploaded_levels += t.m_levels - t.m_tail;
+    }
+
+    std::size_t texture_streamer::upload_rows(texture& t, std::size_t budget)
+    {
+        const mip_chain& c = *t.m_chain;
+        glBindTexture(GL_TEXTURE_2D, t.m_gl);
+        if (t.m_uploading < 0)
+        {
+            // allocated whole, filled over the next frames
+            t.m_uploading = t.m_resident - 1;
+            t.m_rows_done = 0;
+            glTexImage2D(GL_TEXTURE_2D, t.m_uploading, GL_RGBA8, c.m_w[t.m_uploading], c.m_h[t.m_uploading], 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            m_stats.m_gpu_bytes += level_bytes(t, t.m_uploading);
+        }
+        const int level = t.m_uploading;
+        const std::size_t row = std::size_t(c.m_w[level]) * 4;
+        const int rows = static_cast<int>(std::min<std::size_t>(std::max<std::size_t>(1, budget / row),
+                                                                c.m_h[level] - t.m_rows_done));
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, t.m_rows_done, c.m_w[level], rows, GL_RGBA, GL_UNSIGNED_BYTE,
+                        c.m_pixels.data() + c.m_offset[level] + t.m_rows_done * row);
+        t.m_rows_done += rows;
+        if (t.m_rows_done == c.m_h[level])
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+            t.m_resident = level;
+            t.m_uploading = -1;
+            t.m_rows_done = 0;
+            m_stats.m_uploaded_levels++;
+        }
+        return rows * row;
+    }
+
+    void texture_streamer::upload(uint64_t last_frame)
+    {
+        auto deficit = [this](const texture& t) {return t.m_uploading >= 0 ? t.m_levels : t.m_resident - wanted_level(t);};
+        m_order.clear();
+        for (uint32_t i = 0; i < m_textures.size(); i++)
+        {
+            const texture& t = m_textures[i];
+            if (t.m_used == last_frame && t.m_chain && deficit(t) > 0)
+                m_order.push_back(i);
+        }
+        // half done levels first, then the blurriest, then the largest on screen
+        std::sort(m_order.begin(), m_order.end(), [this, &deficit](uint32_t a, uint32_t b)
+        {
+            const int da = deficit(m_textures[a]), db = deficit(m_textures[b]);
+            return da != db ? da > db : m_textures[a].m_pixels > m_textures[b].m_pixels;
+        });
+        std::size_t spent = 0;
+        for (uint32_t i : m_order)
+        {
+            texture& t = m_textures[i];
+            // the tails are small and shown at once, the budget only holds back the finer levels
+            if (t.m_resident == t.m_levels)
+                upload_tail(t);
+            while (spent < m_upload_budget && (t.m_uploading >= 0 || t.m_resident > wanted_level(t)))
+            {
+                if (t.m_uploading < 0)
+                {
+                    // room from what nobody needs; when the memory is full of what is on screen, this one stays blurrier
+                    const std::size_t bytes = level_bytes(t, t.m_resident - 1);
+                    if (bytes > m_memory_limit)
+                        break;
+                    evict(m_memory_limit - bytes, last_frame);
+                    if (m_stats.m_gpu_bytes + bytes > m_memory_limit)
+                        break;
+                }
+                spent += upload_rows(t, m_upload_budget - spent);
+            }
+        }
+        m_stats.m_uploaded_bytes += spent;
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void texture_streamer::trim_chains(uint64_t last_frame)
+    {
+        if (m_stats.m_cpu_bytes <= m_cpu_limit)
+            return;
+        // chains out of view or with their levels up where they are wanted, least recently drawn first
+        m_order.clear();
+        for (uint32_t i = 0; i < m_textures.size(); i++)
+        {
+            const texture& t = m_textures[i];
+            if (t.m_chain && t.m_uploading < 0 &&
+                (t.m_used != last_frame || (t.m_resident < t.m_levels && t.m_resident <= wanted_level(t))))
+                m_order.push_back(i);
+        }
+        std::sort(m_order.begin(), m_order.end(),
+                  [this](uint32_t a, uint32_t b) {return m_textures[a].m_used < m_textures[b].m_used;});
+        for (uint32_t i : m_order)
+        {
+            if (m_stats.m_cpu_bytes <= m_cpu_limit)
+                break;
+            texture& t = m_textures[i];
+            m_stats.m_cpu_bytes -= t.m_chain->m_pixels.size();
+            t.m_chain.reset();
+        }
+    }
+
+    void texture_streamer::queue_decodes(uint64_t last_frame)
+    {
+        m_order.clear();
+        for (uint32_t i = 0; i < m_textures.size(); i++)
+        {
+            const texture& t = m_textures[i];
+            if (t.m_used == last_frame && !t.m_chain && !t.m_decoding && !t.m_failed &&
+                (!t.m_levels || t.m_resident > wanted_level(t)))
+                m_order.push_back(i);
+        }
+        if (m_order.empty() || m_in_flight >= m_max_in_flight)
+            return;
+        // the largest on screen first; few in flight, so the order follows the camera
+        std::sort(m_order.begin(), m_order.end(),
+                  [this](uint32_t a, uint32_t b) {return m_textures[a].m_pixels > m_textures[b].m_pixels;});
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (uint32_t i : m_order)
+            {
+                if (m_in_flight >= m_max_in_flight)
+                    break;
+                texture& t = m_textures[i];
+                // over the limit only what isn't shown at all gets decoded
+                if (m_stats.m_cpu_bytes >= m_cpu_limit && t.m_resident < t.m_levels)
+                    continue;
+                m_queue.push_back({i + 1, t.m_path});
+                t.m_decoding = true;
+                m_in_flight++;
+            }
+        }
+        m_cv.notify_all();
+    }
+
+    void texture_streamer::update()
+    {
+        const uint64_t start = vv_trace::now_ns();
+        // the requests came from the frame before this one
+        const uint64_t last_frame = m_frame++;
+        m_stats.m_uploaded_bytes = 0;
+        m_stats.m_uploaded_levels = 0;
+        m_stats.m_evicted_levels = 0;
+
+        take_results();
+        evict(m_memory_limit, last_frame);
+        upload(last_frame);
+        trim_chains(last_frame);
+        queue_decodes(last_frame);
+
+        m_stats.m_textures = static_cast<unsigned>(m_textures.size());
+        m_stats.m_resident = m_stats.m_sharp = m_stats.m_in_view = m_stats.m_failed = 0;
+        for (const texture& t : m_textures)
+        {
+            const bool resident = t.m_gl && t.m_resident < t.m_levels;
+            m_stats.m_resident += resident;
+            m_stats.m_failed += t.m_failed;
+            if (t.m_used != last_frame)
+                continue;
+            m_stats.m_in_view++;
+            m_stats.m_sharp += resident && t.m_resident <= wanted_level(t);
+        }
+        m_stats.m_decoding = m_in_flight;
+        m_stats.m_update_ms = (vv_trace::now_ns() - start) / 1e6;
+    }
+}
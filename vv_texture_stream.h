@@ -0,0 +1,155 @@
+#ifndef vv_texture_stream_h
+#define vv_texture_stream_h
+#include <allegro5/allegro_opengl.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vv_gl
+{
+    // Mipmapped RGBA8 textures streamed in from image files. load() only
+    // registers the file. Decoder threads read the image into a memory bitmap
+    // and box-filter the whole mip chain once it is asked for. update() then
+    // uploads it coarse to fine: the small tail levels first, then one finer
+    // level at a time in bands of rows until the frame's upload budget is
+    // spent. A level is shown through GL_TEXTURE_BASE_LEVEL only when complete.
+    // request() passes the screen size of the drawing, which decides the finest
+    // level worth having. Over the memory limit, levels finer than that go
+    // first, least recently drawn textures first; the tail stays, so a shown
+    // texture never goes blank. Decoded chains are kept in system memory under
+    // their own limit and read from the file again when they were dropped.
+    class texture_streamer
+    {
+    public:
+        typedef uint32_t handle;  // 0 is no texture
+        static const int max_levels = 16;
+        static const int tail_size  = 64;  // levels this size and smaller go up together and stay
+
+        struct statistics
+        {
+            unsigned    m_textures        = 0;
+            unsigned    m_resident        = 0;  // with something on the GPU
+            unsigned    m_sharp           = 0;  // drawn last frame at the level they asked for
+            unsigned    m_in_view         = 0;  // drawn last frame
+            unsigned    m_decoding        = 0;  // queued or in a decoder
+            unsigned    m_failed          = 0;
+            std::size_t m_gpu_bytes       = 0;
+            std::size_t m_cpu_bytes       = 0;  // decoded chains
+            // of the last update()
+            std::size_t m_uploaded_bytes  = 0;
+            unsigned    m_uploaded_levels = 0;  // completed
+            unsigned    m_evicted_levels  = 0;
+            double      m_update_ms       = 0;
+        };
+
+        explicit texture_streamer(unsigned decoders = 2);
+        ~texture_streamer();
+        texture_streamer(const texture_streamer&) = delete;
+        texture_streamer& operator=(const texture_streamer&) = delete;
+
+        // GL objects must be released with release_gl() while the context is alive;
+        // the textures start over from their tails when drawn again
+        void release_gl();
+
+        handle load(const std::string& path);
+        std::size_t size() const {return m_textures.size();}
+
+        void set_memory_limit(std::size_t bytes) {m_memory_limit = bytes;}
+        std::size_t get_memory_limit() const {return m_memory_limit;}
+        void set_upload_budget(std::size_t bytes_per_frame) {m_upload_budget = bytes_per_frame;}
+        std::size_t get_upload_budget() const {return m_upload_budget;}
+        void set_cpu_limit(std::size_t bytes) {m_cpu_limit = bytes;}
+        std::size_t get_cpu_limit() const {return m_cpu_limit;}
+
+        // h is drawn this frame with its width covering about pixels on screen,
+        // the largest request of the frame counts
+        void request(handle h, float pixels);
+        // to GL_TEXTURE_2D; false with nothing bound while no level is resident
+        bool bind(handle h) const;
+        // once per frame before drawing: takes the decoded chains, evicts, uploads
+        void update();
+
+        const statistics& stats() const {return m_stats;}
+
+    protected:
+        // every level of an image in one block, level 0 first, rows bottom-up as GL wants them
+        struct mip_chain
+        {
+            int         m_levels = 0;
+            int         m_w[max_levels];
+            int         m_h[max_levels];
+            std::size_t m_offset[max_levels];
+            std::vector<unsigned char> m_pixels;
+        };
+
+        struct texture
+        {
+            std::string m_path;
+            GLuint      m_gl       = 0;
+            int         m_w        = 0;  // level 0, known after the first decode
+            int         m_h        = 0;
+            int         m_levels   = 0;
+            int         m_tail     = 0;  // first level of the tail
+            int         m_resident = 0;  // finest level on the GPU, m_levels when none
+            int         m_uploading = -1; // level allocated and being filled
+            int         m_rows_done = 0;
+            bool        m_decoding = false;
+            bool        m_failed   = false;
+            uint64_t    m_used     = 0;  // frame of the last request
+            float       m_pixels   = 0;  // largest request of that frame
+            std::unique_ptr<mip_chain> m_chain;
+        };
+
+        struct decode_job
+        {
+            handle      m_handle;
+            std::string m_path;
+        };
+
+        struct decode_result
+        {
+            handle m_handle;
+            std::unique_ptr<mip_chain> m_chain;  // null when the file couldn't be read
+        };
+
+        static std::unique_ptr<mip_chain> decode(const std::string& path);
+        static std::size_t level_bytes(const texture& t, int level);
+        void decoder_proc();
+        int wanted_level(const texture& t) const;
+        void take_results();
+        void evict_level(texture& t);
+        // levels nobody wants at their size, until the GPU copies fit in target
+        void evict(std::size_t target, uint64_t last_frame);
+        void upload_tail(texture& t);
+        std::size_t upload_rows(texture& t, std::size_t budget);
+        void upload(uint64_t last_frame);
+        void trim_chains(uint64_t last_frame);
+        void queue_decodes(uint64_t last_frame);
+
+        std::vector<texture> m_textures;  // handle - 1
+        uint64_t    m_frame = 1;
+        std::size_t m_memory_limit  = std::size_t(256) << 20;
+        std::size_t m_upload_budget = std::size_t(2) << 20;
+        std::size_t m_cpu_limit     = std::size_t(256) << 20;
+        unsigned    m_max_in_flight;
+        unsigned    m_in_flight = 0;
+        statistics  m_stats;
+        std::vector<uint32_t> m_order;        // scratch for the upload, trim and decode order
+        std::vector<uint32_t> m_evict_order;  // evict() runs inside the upload loop
+
+        // decoder thread state
+        std::vector<std::thread>   m_decoders;
+        std::mutex                 m_mutex;
+        std::condition_variable    m_cv;
+        std::deque<decode_job>     m_queue;
+        std::vector<decode_result> m_results;
+        std::vector<decode_result> m_taken;  // swapped with m_results, both keep their capacity
+        bool                       m_quit = false;
+    };
+}
+#endif
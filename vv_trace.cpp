@@ -0,0 +1,127 @@
+#include "vv_trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+namespace vv_trace
+{
+    std::atomic<bool> g_enabled{true};
+#ifdef VV_TRACK_ALLOCATIONS
+    thread_local const char* t_zone = nullptr;
+#endif
+
+    namespace
+    {
+        std::atomic<thread_buffer*> g_buffers{nullptr};
+        std::atomic<uint32_t>       g_next_tid{1};
+
+        const std::chrono::steady_clock::time_point g_start = std::chrono::steady_clock::now();
+
+        thread_buffer* acquire_buffer()
+        {
+            // reuse the buffer of an exited thread, short-lived workers would leak otherwise
+            for (thread_buffer* b = g_buffers.load(std::memory_order_acquire); b; b = b->m_next)
+            {
+                bool owned = false;
+                if (b->m_owned.compare_exchange_strong(owned, true, std::memory_order_acq_rel))
+                    return b;
+            }
+            thread_buffer* b = new thread_buffer;
+            b->m_tid = g_next_tid.fetch_add(1, std::memory_order_relaxed);
+            b->m_next = g_buffers.load(std::memory_order_relaxed);
+            while (!g_buffers.compare_exchange_weak(b->m_next, b, std::memory_order_release, std::memory_order_relaxed))
+                ;
+            return b;
+        }
+
+        // hands the buffer back when its thread exits, the events stay dumpable
+        struct buffer_owner
+        {
+            thread_buffer* m_buffer = nullptr;
+            ~buffer_owner()
+            {
+                if (m_buffer)
+                    m_buffer->m_owned.store(false, std::memory_order_release);
+            }
+        };
+        thread_local buffer_owner t_owner;
+
+        void write_escaped(FILE* f, const char* s)
+        {
+            for (; s && *s; s++)
+            {
+                if (*s == '"' || *s == '\\')
+                    std::fputc('\\', f);
+                if (static_cast<unsigned char>(*s) >= 0x20)
+                    std::fputc(*s, f);
+            }
+        }
+    }
+
+    uint64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_start).count();
+    }
+
+    thread_buffer& this_thread_buffer()
+    {
+        if (!t_owner.m_buffer)
+            t_owner.m_buffer = acquire_buffer();
+        return *t_owner.m_buffer;
+    }
+
+    void set_thread_name(const char* name)
+    {
+        this_thread_buffer().m_name.store(name, std::memory_order_relaxed);
+    }
+
+    bool write_chrome_trace(const std::string& path)
+    {
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f)
+            return false;
+
+        std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        std::vector<event> events;
+        for (thread_buffer* b = g_buffers.load(std::memory_order_acquire); b; b = b->m_next)
+        {
+            const uint64_t head = b->m_head.load(std::memory_order_acquire);
+            const uint64_t begin = head > thread_buffer::capacity ? head - thread_buffer::capacity : 0;
+            events.clear();
+            for (uint64_t i = begin; i < head; i++)
+                events.push_back(b->m_events[i % thread_buffer::capacity]);
+
+            // the owner kept writing meanwhile: drop what it may have overwritten,
+            // including the slot it could be in the middle of
+            const uint64_t now_head = b->m_head.load(std::memory_order_acquire);
+            std::size_t skip = 0;
+            if (now_head + 1 > thread_buffer::capacity + begin)
+                skip = static_cast<std::size_t>(std::min<uint64_t>(now_head + 1 - thread_buffer::capacity - begin, events.size()));
+
+            const char* name = b->m_name.load(std::memory_order_relaxed);
+            std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                         first ? "" : ",\n", b->m_tid);
+            if (name)
+                write_escaped(f, name);
+            else
+                std::fprintf(f, "thread %u", b->m_tid);
+            std::fprintf(f, "\"}}");
+            first = false;
+
+            for (std::size_t i = skip; i < events.size(); i++)
+            {
+                const event& e = events[i];
+                std::fprintf(f, ",\n{\"name\":\"");
+                write_escaped(f, e.m_name);
+                std::fprintf(f, "\",\"cat\":\"");
+                write_escaped(f, e.m_category);
+                std::fprintf(f, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                             b->m_tid, e.m_begin_ns / 1000.0, (e.m_end_ns - e.m_begin_ns) / 1000.0);
+            }
+        }
+        std::fprintf(f, "\n]}\n");
+        return std::fclose(f) == 0;
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef vv_trace_h
+#define vv_trace_h
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace vv_trace
+{
+    // Begin/end timeline of the viewer, exported as Chrome trace_event JSON
+    // (chrome://tracing, ui.perfetto.dev).
+    // Every thread writes into its own ring of the last events, no locks and
+    // no allocations after the first event of a thread. Names and categories
+    // are kept by pointer, so they must be string literals.
+    struct event
+    {
+        const char* m_name     = nullptr;
+        const char* m_category = nullptr;
+        uint64_t    m_begin_ns = 0;
+        uint64_t    m_end_ns   = 0;
+    };
+
+    class thread_buffer
+    {
+    public:
+        static const std::size_t capacity = 1 << 14;
+
+        void push(const event& e)
+        {
+            const uint64_t head = m_head.load(std::memory_order_relaxed);
+            m_events[head % capacity] = e;
+            m_head.store(head + 1, std::memory_order_release);
+        }
+
+        event                    m_events[capacity];
+        std::atomic<uint64_t>    m_head{0};
+        std::atomic<const char*> m_name{nullptr};
+        std::atomic<bool>        m_owned{true};    // reused by a new thread once its owner exits
+        uint32_t                 m_tid  = 0;
+        thread_buffer*           m_next = nullptr;
+    };
+
+    extern std::atomic<bool> g_enabled;
+#ifdef VV_TRACK_ALLOCATIONS
+    extern thread_local const char* t_zone;
+#endif
+
+    // innermost scope of the calling thread, kept only for the allocation statistics
+    inline const char* current_zone()
+    {
+#ifdef VV_TRACK_ALLOCATIONS
+        return t_zone;
+#else
+        return nullptr;
+#endif
+    }
+
+    inline bool enabled() {return g_enabled.load(std::memory_order_relaxed);}
+    inline void set_enabled(bool on) {g_enabled.store(on, std::memory_order_relaxed);}
+
+    // nanoseconds since the first call
+    uint64_t now_ns();
+
+    // buffer of the calling thread, taken on first use
+    thread_buffer& this_thread_buffer();
+    void set_thread_name(const char* name);
+
+    inline void record(const char* category, const char* name, uint64_t begin_ns, uint64_t end_ns)
+    {
+        event e;
+        e.m_name = name;
+        e.m_category = category;
+        e.m_begin_ns = begin_ns;
+        e.m_end_ns = end_ns;
+        this_thread_buffer().push(e);
+    }
+
+    // dumps the events of all threads, safe to call while they keep tracing
+    bool write_chrome_trace(const std::string& path);
+
+    class scope
+    {
+    public:
+        scope(const char* category, const char* name) :
+            m_category(category), m_name(name), m_active(enabled())
+        {
+#ifdef VV_TRACK_ALLOCATIONS
+            m_parent_zone = t_zone;
+            t_zone = name;
+#endif
+            if (m_active)
+                m_begin_ns = now_ns();
+        }
+        ~scope()
+        {
+            if (m_active)
+                record(m_category, m_name, m_begin_ns, now_ns());
+#ifdef VV_TRACK_ALLOCATIONS
+            t_zone = m_parent_zone;
+#endif
+        }
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+    private:
+        const char* m_category;
+        const char* m_name;
+        uint64_t    m_begin_ns = 0;
+        bool        m_active;
+#ifdef VV_TRACK_ALLOCATIONS
+        const char* m_parent_zone;
+#endif
+    };
+}
+
+#define VV_TRACE_CONCAT_(a, b) a##b
+#define VV_TRACE_CONCAT(a, b) VV_TRACE_CONCAT_(a, b)
+
+// VV_TRACE_DISABLE compiles the scopes out, otherwise they cost two clock reads when on
+#ifndef VV_TRACE_DISABLE
+#define VV_TRACE_SCOPE(category, name) vv_trace::scope VV_TRACE_CONCAT(vv_trace_scope_, __LINE__)(category, name)
+#else
+#define VV_TRACE_SCOPE(category, name) do {} while (0)
+#endif
+
+#endif